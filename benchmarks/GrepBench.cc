@@ -0,0 +1,83 @@
+#include "ParallelSearch.h"
+#include "PieceTable.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+// :vimgrep over a generated tree of small source files and :%s//gn over
+// one big buffer, on pools of 1, 2, 4... threads up to one per core.
+// Usage: GrepBench [files] [bufferMB]   (default: 50000 256)
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::string sample(size_t bytes, unsigned seed) {
+    static const char* words[] = {"int", "return", "value", "size_t", "for", "(", ")", "{", "}",
+                                  ";", "i", "++", "buffer", "std::string", "0", "42", "=", "<"};
+    std::string text;
+    while (text.size() < bytes) {
+        seed = seed * 1103515245 + 12345;
+        text += words[(seed >> 16) % (sizeof(words) / sizeof(words[0]))];
+        text += (seed >> 8) % 9 ? " " : "\n";
+    }
+    return text;
+}
+
+int main(int argc, char** argv) {
+    size_t fileCount = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 50000;
+    size_t megabytes = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 256;
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+    namespace fs = std::filesystem;
+    fs::path root = fs::temp_directory_path() / "grep_bench";
+    fs::remove_all(root);
+    std::vector<std::string> files;
+    size_t bytes = 0;
+    for (size_t i = 0; i < fileCount; i++) {
+        fs::path dir = root / std::to_string(i % 100) / std::to_string(i / 100 % 50);
+        fs::create_directories(dir);
+        std::string path = (dir / (std::to_string(i) + ".cc")).string();
+        std::string text = sample(2048 + i % 7 * 1024, i);
+        std::ofstream(path) << text;
+        bytes += text.size();
+    }
+    std::vector<std::string> globs{root.string() + "/**/*.cc"};
+    std::string error;
+    auto start = std::chrono::steady_clock::now();
+    if (!expandGlobs(globs, files, error)) {
+        printf("%s\n", error.c_str());
+        return 1;
+    }
+    printf("%zu files, %.1f MB; expanding **/*.cc took %.0f ms\n", files.size(), bytes / 1e6,
+           seconds(start) * 1e3);
+
+    Regex pattern;
+    pattern.compile("value\\s*=\\s*42", error);
+    PieceTable buffer;
+    buffer.insertAt(0, sample(megabytes << 20, 3));
+    auto snapshot = buffer.snapshot();
+
+    for (unsigned threads = 1;; threads = std::min(threads * 2, cores)) {
+        ThreadPool pool(threads);
+        std::vector<GrepHit> hits;
+        start = std::chrono::steady_clock::now();
+        grepFiles(pattern, files, true, pool, hits);
+        double grep = seconds(start);
+        start = std::chrono::steady_clock::now();
+        MatchTally tally = countMatches(pattern, *snapshot, 0, snapshot->length(), true, pool);
+        double count = seconds(start);
+        printf("  %2u threads: vimgrep %7.0f ms (%zu hits)   %%s//gn %7.0f ms, %6.0f MB/s (%zu matches)\n",
+               threads, grep * 1e3, hits.size(), count * 1e3, snapshot->length() / count / 1e6,
+               tally.matches);
+        if (threads == cores) {
+            break;
+        }
+    }
+    fs::remove_all(root);
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include "GrammarRegistry.h"
+#include "HighlightCache.h"
+#include "LineRenderer.h"
+#include "PieceTable.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Counts heap allocations made while highlighting and laying out lines:
+// the lexer alone over a whole file, then a screen re-lexed and redrawn
+// after each of a run of edits the way the editor does it. Last, the
+// file is repeated to 400k lines, lexed to the end, and every 10th line
+// deleted the way :g/pat/d does.
+// Usage: HighlightBench [file.cc] [edits]   (default: ../src/Editor.cc 2000)
+
+static std::atomic<long> allocations{0};
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+static constexpr int Rows = 50;
+static constexpr int Cols = 160;
+
+static void report(const char* name, long allocated, long lines, double elapsed) {
+    printf("  %-24s %8.3f allocations/line  %8.1f ns/line\n", name,
+           static_cast<double>(allocated) / lines, elapsed / lines * 1e9);
+}
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Lexes every line into the same token array, as the worker does
+static void lexAll(const Grammar* grammar, const std::vector<std::string>& lines, const char* name) {
+    Lexer lexer(grammar);
+    LexerState state;
+    std::vector<Token> tokens;
+    long before = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for (const std::string& line : lines) {
+        lexer.tokenize(line, state, tokens);
+    }
+    report(name, allocations.load() - before, lines.size(), seconds(start));
+}
+
+int main(int argc, char** argv) {
+    std::string path = argc > 1 ? argv[1] : "../src/Editor.cc";
+    int edits = argc > 2 ? std::atoi(argv[2]) : 2000;
+
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Could not open " << path << "\n";
+        return 1;
+    }
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(in, line)) {
+        lines.push_back(line);
+    }
+    if (static_cast<int>(lines.size()) < Rows) {
+        std::cerr << path << " is shorter than a screen\n";
+        return 1;
+    }
+    printf("%zu lines of %s, %d edits\n", lines.size(), path.c_str(), edits);
+
+    GrammarRegistry grammars;
+    const Grammar* grammar = grammars.forFile(path, lines[0]);
+    lexAll(grammar, lines, "lexer, first pass");
+    lexAll(grammar, lines, "lexer, again");
+
+    PieceTable buffer;
+    buffer.assign(lines);
+    HighlightCache cache(buffer);
+    cache.setGrammar(grammar);
+    buffer.addListener(&cache);
+    LineRenderer renderer;
+    std::string text;
+    int from, to;
+    auto frame = [&](int first) {
+        cache.update(first, first + Rows - 1, from, to);
+        for (int y = first; y < first + Rows; y++) {
+            buffer.line(y, text);
+            std::string_view view = text;
+            renderer.begin(Cols);
+            for (const Token& token : cache.tokens(y)) {
+                renderer.add(view.substr(token.position, token.length), tokenAttributes(token.type));
+            }
+            renderer.fill(COLOR_PAIR(5));
+        }
+    };
+    int first = 0;
+    frame(first);
+    while (cache.busy()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        frame(first);
+    }
+
+    // Typing into the middle of the screen: the edit itself is not counted
+    long allocated = 0;
+    double elapsed = 0;
+    int y = first + Rows / 2;
+    for (int i = 0; i < edits; i++) {
+        buffer.replaceLine(y, i % 2 ? lines[y] : lines[y] + " ");
+        long before = allocations.load();
+        auto start = std::chrono::steady_clock::now();
+        frame(first);
+        elapsed += seconds(start);
+        allocated += allocations.load() - before;
+    }
+    report("edit, relex and lay out", allocated, static_cast<long>(edits) * Rows, elapsed);
+
+    std::vector<std::string> many;
+    while (many.size() < 400000) {
+        many.insert(many.end(), lines.begin(), lines.end());
+    }
+    buffer.assign(many);
+    cache.clear();
+    first = static_cast<int>(many.size()) - Rows;
+    frame(first);
+    while (cache.busy()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        frame(first);
+    }
+    std::vector<int> doomed;
+    for (int y = 0; y < static_cast<int>(many.size()); y += 10) {
+        doomed.push_back(y);
+    }
+    auto start = std::chrono::steady_clock::now();
+    buffer.eraseLines(doomed);
+    frame(0);
+    printf("  %-24s %8.3f s for %zu lines\n", "delete every 10th line", seconds(start), doomed.size());
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include "GrammarRegistry.h"
+#include "Lexer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Lexer throughput over a corpus of real code, one line at a time into a
+// reused token array the way the highlight cache calls it, with each
+// scan kernel, then each of the run scanners by itself. Files are lexed
+// with the grammar the editor would pick for them.
+// Usage: LexerBench [file...]   (default: the sources in ../src and ../include)
+
+static constexpr int Rounds = 5;
+static constexpr size_t MinBytes = 64 << 20;
+static constexpr size_t RunBytes = 4096;
+static constexpr int RunRepeats = 16384;
+
+// Best rate of a few rounds, in MB/s
+template <typename Work>
+static double best(double bytes, Work work) {
+    double rate = 0;
+    for (int round = 0; round < Rounds; round++) {
+        auto start = std::chrono::steady_clock::now();
+        work();
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        rate = std::max(rate, bytes / elapsed / 1e6);
+    }
+    return rate;
+}
+
+struct Source {
+    const Grammar* grammar;
+    std::vector<std::string> lines;
+};
+
+static bool readLines(const std::string& path, std::vector<std::string>& lines, size_t& bytes) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Could not open " << path << "\n";
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        bytes += line.size() + 1;
+        lines.push_back(line);
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> paths(argv + 1, argv + argc);
+    if (paths.empty()) {
+        for (const char* dir : {"../src", "../include"}) {
+            for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+                std::string ext = entry.path().extension().string();
+                if (ext == ".cc" || ext == ".h") {
+                    paths.push_back(entry.path().string());
+                }
+            }
+        }
+        std::sort(paths.begin(), paths.end());
+    }
+    GrammarRegistry grammars;
+    std::vector<Source> sources;
+    size_t bytes = 0;
+    size_t lineCount = 0;
+    for (const std::string& path : paths) {
+        Source& source = sources.emplace_back();
+        if (!readLines(path, source.lines, bytes)) {
+            return 1;
+        }
+        source.grammar = grammars.forFile(path, source.lines.empty() ? "" : source.lines[0]);
+        lineCount += source.lines.size();
+    }
+    if (bytes == 0) {
+        std::cerr << "Nothing to lex\n";
+        return 1;
+    }
+    int passes = std::max<size_t>(1, MinBytes / bytes);
+    printf("%zu files, %zu lines, %.2f MB, %d passes per round\n", paths.size(), lineCount,
+           bytes / 1e6, passes);
+
+    for (ScanKernel kernel : {ScanKernel::Scalar, ScanKernel::Sse2, ScanKernel::Avx2}) {
+        if (kernel > bestScanKernel()) {
+            continue;
+        }
+        Lexer lexer(nullptr, kernel);
+        std::vector<Token> tokens;
+        size_t tokenCount = 0;
+        double rate = best(bytes * passes, [&] {
+            for (int pass = 0; pass < passes; pass++) {
+                for (const Source& source : sources) {
+                    lexer.setGrammar(source.grammar);
+                    LexerState state;
+                    for (const std::string& line : source.lines) {
+                        lexer.tokenize(line, state, tokens);
+                        tokenCount += tokens.size();
+                    }
+                }
+            }
+        });
+        printf("  tokenize %-8s %8.1f MB/s  (%zu tokens per pass)\n", scanKernelName(kernel), rate,
+               tokenCount / (Rounds * static_cast<size_t>(passes)));
+    }
+
+    // Each scanner on its own, over runs long enough that it never stops early
+    std::string literal(RunBytes, 's');
+    literal += '"';
+    std::string identifier(RunBytes, 'i');
+    std::string blanks(RunBytes, ' ');
+    std::vector<std::pair<const char*, std::function<size_t(ScanKernel)>>> scanners = {
+        {"string", [&](ScanKernel k) { return findStringStop(k, literal, 0, '"'); }},
+        {"identifier", [&](ScanKernel k) { return skipIdentifier(k, identifier, 0); }},
+        {"blanks", [&](ScanKernel k) { return skipBlanks(k, blanks, 0); }},
+    };
+    printf("scanners over %zu byte runs\n", RunBytes);
+    for (const auto& [name, scan] : scanners) {
+        printf("  %-10s", name);
+        for (ScanKernel kernel : {ScanKernel::Scalar, ScanKernel::Sse2, ScanKernel::Avx2}) {
+            if (kernel > bestScanKernel()) {
+                continue;
+            }
+            size_t sum = 0;
+            double rate = best(RunBytes * RunRepeats, [&] {
+                for (int i = 0; i < RunRepeats; i++) {
+                    sum += scan(kernel);
+                }
+            });
+            if (sum % RunBytes != 0) {
+                std::cerr << name << " scanner stopped early\n";
+                return 1;
+            }
+            printf("  %s %8.1f MB/s", scanKernelName(kernel), rate);
+        }
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include "LineIndex.h"
+#include "MappedFile.h"
+#include "NewlineScanner.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Compares line indexing strategies on generated files.
+// Usage: NewlineBench [sizeInMB...]   (default: 100 1024 4096)
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void report(const char* name, size_t bytes, double elapsed, size_t lines) {
+    printf("  %-22s %8.2f GB/s  %10zu lines\n", name, bytes / elapsed / 1e9, lines);
+}
+
+static bool writeSample(const std::string& path, size_t bytes) {
+    std::ofstream out(path, std::ios::binary);
+    std::string block;
+    unsigned seed = 7;
+    while (block.size() < (1 << 20)) {
+        seed = seed * 1103515245 + 12345;
+        size_t width = 10 + (seed >> 16) % 110;
+        block.append(width, 'a' + (seed >> 8) % 26);
+        block += '\n';
+    }
+    for (size_t written = 0; written < bytes && out; written += block.size()) {
+        out.write(block.data(), std::min(block.size(), bytes - written));
+    }
+    return static_cast<bool>(out);
+}
+
+int main(int argc, char** argv) {
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; i++) {
+        sizes.push_back(std::strtoull(argv[i], nullptr, 10));
+    }
+    if (sizes.empty()) {
+        sizes = {100, 1024, 4096};
+    }
+
+    NewlineKernel best = bestNewlineKernel();
+    const std::string path = "newline_bench.txt";
+    for (size_t megabytes : sizes) {
+        size_t bytes = megabytes * 1024 * 1024;
+        if (!writeSample(path, bytes)) {
+            std::cerr << "Could not write " << megabytes << " MB sample\n";
+            std::remove(path.c_str());
+            return 1;
+        }
+        printf("%zu MB (best kernel: %s)\n", megabytes, newlineKernelName(best));
+
+        // The old loader: one std::string per line
+        {
+            auto start = std::chrono::steady_clock::now();
+            std::ifstream in(path);
+            std::vector<std::string> lines;
+            std::string line;
+            while (std::getline(in, line)) {
+                lines.push_back(line);
+            }
+            report("getline", bytes, seconds(start), lines.size());
+        }
+
+        MappedFile mapped;
+        if (!mapped.open(path)) {
+            std::cerr << "Could not map sample\n";
+            std::remove(path.c_str());
+            return 1;
+        }
+        for (NewlineKernel kernel : {NewlineKernel::Scalar, NewlineKernel::Sse2, NewlineKernel::Avx2}) {
+            if (kernel > best) {
+                continue;
+            }
+            std::vector<size_t> offsets;
+            auto start = std::chrono::steady_clock::now();
+            scanNewlinesWith(kernel, mapped.data(), mapped.size(), 0, offsets);
+            report(newlineKernelName(kernel), bytes, seconds(start), offsets.size());
+        }
+        for (unsigned workers : {1u, 0u}) {
+            LineIndex index;
+            auto start = std::chrono::steady_clock::now();
+            index.build(mapped.data(), mapped.size(), workers);
+            std::vector<size_t> offsets = index.take();
+            report(workers == 1 ? "LineIndex 1 thread" : "LineIndex parallel", bytes, seconds(start),
+                   offsets.size());
+        }
+    }
+    std::remove(path.c_str());
+    return 0;
+}
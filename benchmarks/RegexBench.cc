@@ -0,0 +1,76 @@
+#include "Regex.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// Whole-text scans for patterns that are never found, on the lazy DFA and
+// on the NFA it falls back to, over generated code-like text; then the
+// patterns that make backtracking engines blow up, and a backward search
+// whose every match runs to the end of the text.
+// Usage: RegexBench [sizeInMB]   (default: 64)
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::string sample(size_t bytes) {
+    static const char* words[] = {"int", "return", "value", "size_t", "for", "(", ")", "{", "}",
+                                  ";", "i", "++", "buffer", "std::string", "0", "42", "=", "<"};
+    std::string text;
+    unsigned seed = 11;
+    while (text.size() < bytes) {
+        seed = seed * 1103515245 + 12345;
+        text += words[(seed >> 16) % (sizeof(words) / sizeof(words[0]))];
+        text += (seed >> 8) % 9 ? " " : "\n";
+    }
+    text.resize(bytes);
+    return text;
+}
+
+static void scan(const std::string& pattern, const std::string& text, size_t nfaBytes) {
+    Regex regex;
+    std::string error;
+    if (!regex.compile(pattern, error)) {
+        printf("  %-28s %s\n", pattern.c_str(), error.c_str());
+        return;
+    }
+    RegexMatch match;
+    auto start = std::chrono::steady_clock::now();
+    bool found = regex.search(text, 0, text.size(), false, match);
+    double dfa = text.size() / seconds(start) / 1e6;
+    std::string_view head(text.data(), std::min(nfaBytes, text.size()));
+    start = std::chrono::steady_clock::now();
+    found |= regex.searchNfa(head, 0, head.size(), match);
+    double nfa = head.size() / seconds(start) / 1e6;
+    printf("  %-28s DFA %8.0f MB/s   NFA %6.1f MB/s%s\n", pattern.c_str(), dfa, nfa,
+           found ? "  (found?)" : "");
+}
+
+int main(int argc, char** argv) {
+    size_t megabytes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 64;
+    std::string text = sample(megabytes << 20);
+    printf("%zu MB of code-like text\n", megabytes);
+    size_t nfaBytes = 4 << 20;
+    for (const char* pattern : {"missingWord", "\\<missing\\>", "[0-9]\\+x", "value\\s*==\\s*7",
+                                "^\\s*return 7", "foo\\|bar\\|missing", "\\cSTD::STRINGS",
+                                "\\w\\+(\\d\\{3}"}) {
+        scan(pattern, text, nfaBytes);
+    }
+
+    printf("pathological patterns over a's with no b\n");
+    std::string as(megabytes << 20, 'a');
+    for (const char* pattern : {"\\(a*\\)*b", "\\(a\\|aa\\)*b", "\\(a\\|a\\)\\{1,50}c", "a*a*a*a*a*b"}) {
+        scan(pattern, as, nfaBytes);
+    }
+
+    RegexMatch match;
+    std::string error;
+    Regex regex;
+    regex.compile("a\\_.*", error);
+    auto start = std::chrono::steady_clock::now();
+    bool found = regex.search(text, 0, 4096, true, match);
+    printf("backward a\\_.* from 4 KB into the text: %.1f ms%s\n", seconds(start) * 1e3,
+           found ? "" : "  (not found?)");
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include "GrammarRegistry.h"
+#include "LineRenderer.h"
+#include "SyntaxHighlighter.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Draws a full screen of highlighted C++ into an off-screen terminal,
+// once cell by cell the way render() used to and once as attribute runs.
+// Usage: RenderBench [file.cc] [frames]   (default: ../src/Editor.cc 500)
+
+static constexpr int Rows = 50;
+static constexpr int Cols = 160;
+
+using Tokens = std::vector<std::pair<TokenType, std::string>>;
+
+struct Selection {
+    int startY, startX, endY, endX;
+};
+
+static bool selected(const Selection* sel, int y, int x) {
+    return sel && (y > sel->startY || (y == sel->startY && x >= sel->startX)) &&
+           (y < sel->endY || (y == sel->endY && x <= sel->endX));
+}
+
+// One attribute on/add/off triple per cell
+static long drawCells(WINDOW* win, const std::vector<Tokens>& screen, const Selection* sel) {
+    long calls = 0;
+    for (int y = 0; y < static_cast<int>(screen.size()); y++) {
+        int x = 0;
+        for (const auto& [type, text] : screen[y]) {
+            attr_t attr = tokenAttributes(type);
+            for (size_t i = 0; i < text.size() && x < Cols; i++, x++) {
+                attr_t cell = selected(sel, y, x) ? A_REVERSE : attr;
+                wattron(win, cell);
+                mvwaddch(win, y, x, text[i]);
+                wattroff(win, cell);
+                calls += 3;
+            }
+        }
+        for (; x < Cols; x++) {
+            wattron(win, COLOR_PAIR(5));
+            mvwaddch(win, y, x, ' ');
+            wattroff(win, COLOR_PAIR(5));
+            calls += 3;
+        }
+    }
+    return calls;
+}
+
+static long drawRuns(WINDOW* win, LineRenderer& renderer, const std::vector<Tokens>& screen,
+                     const Selection* sel) {
+    long calls = 0;
+    for (int y = 0; y < static_cast<int>(screen.size()); y++) {
+        renderer.begin(Cols);
+        for (const auto& [type, text] : screen[y]) {
+            renderer.add(text, tokenAttributes(type));
+        }
+        int lineLen = renderer.text().size();
+        renderer.fill(COLOR_PAIR(5));
+        if (sel && y >= sel->startY && y <= sel->endY) {
+            int from = y == sel->startY ? sel->startX : 0;
+            int to = y == sel->endY ? sel->endX + 1 : lineLen;
+            renderer.overlay(from, std::min(to, lineLen), A_REVERSE);
+        }
+        calls += renderer.draw(win, y);
+    }
+    return calls;
+}
+
+template <typename Draw>
+static void measure(const char* name, WINDOW* win, int frames, Draw draw) {
+    long calls = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) {
+        calls = draw();
+        wnoutrefresh(win);
+        doupdate();
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("  %-10s %8ld ncurses calls/frame  %8.1f us/frame\n", name, calls, elapsed / frames * 1e6);
+}
+
+int main(int argc, char** argv) {
+    std::string path = argc > 1 ? argv[1] : "../src/Editor.cc";
+    int frames = argc > 2 ? std::atoi(argv[2]) : 500;
+
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Could not open " << path << "\n";
+        return 1;
+    }
+    GrammarRegistry grammars;
+    SyntaxHighlighter highlighter;
+    highlighter.setGrammar(grammars.forFile(path, ""));
+    std::vector<Tokens> screen;
+    LexerState state;
+    std::vector<Token> tokens;
+    std::string line;
+    while (static_cast<int>(screen.size()) < Rows && std::getline(in, line)) {
+        highlighter.highlight(line, state, tokens);
+        Tokens& row = screen.emplace_back();
+        for (const Token& token : tokens) {
+            row.emplace_back(token.type, line.substr(token.position, token.length));
+        }
+    }
+
+    // Output goes nowhere so only the drawing and diffing are timed
+    FILE* sink = fopen("/dev/null", "w");
+    setenv("LINES", std::to_string(Rows + 1).c_str(), 1);
+    setenv("COLUMNS", std::to_string(Cols).c_str(), 1);
+    const char* term = getenv("TERM");
+    SCREEN* terminal = newterm(term && *term ? term : "xterm-256color", sink, stdin);
+    if (!terminal) {
+        std::cerr << "Could not start a terminal\n";
+        fclose(sink);
+        return 1;
+    }
+    start_color();
+    WINDOW* win = newwin(Rows, Cols, 0, 0);
+
+    Selection sel = {Rows / 4, 8, Rows * 3 / 4, 40};
+    LineRenderer renderer;
+    printf("%d x %d screen of %s, %d frames\n", Rows, Cols, path.c_str(), frames);
+    measure("cells", win, frames, [&] { return drawCells(win, screen, nullptr); });
+    measure("runs", win, frames, [&] { return drawRuns(win, renderer, screen, nullptr); });
+    printf("with a selection over half the screen\n");
+    measure("cells", win, frames, [&] { return drawCells(win, screen, &sel); });
+    measure("runs", win, frames, [&] { return drawRuns(win, renderer, screen, &sel); });
+
+    delwin(win);
+    endwin();
+    delscreen(terminal);
+    fclose(sink);
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include "MappedFile.h"
+#include "PieceTable.h"
+#include "SubstringSearch.h"
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+
+// Repeats `n` over a generated file with one match per megabyte, first
+// the old way (a copy of each line and std::string::find) and then with
+// SubstringSearch over the piece table; then the raw scan rate of each
+// kernel for a needle that is never found.
+// Usage: SearchBench [sizeInMB] [repeats]   (default: 1024 10000)
+
+static const std::string Needle = "searchBenchTarget";
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool writeSample(const std::string& path, size_t bytes) {
+    std::ofstream out(path, std::ios::binary);
+    std::string block;
+    unsigned seed = 7;
+    while (block.size() < (1 << 20)) {
+        seed = seed * 1103515245 + 12345;
+        size_t words = 1 + (seed >> 16) % 12;
+        for (size_t i = 0; i < words; i++) {
+            seed = seed * 1103515245 + 12345;
+            // Words that share the needle's first and last bytes
+            block += (seed >> 20) % 4 ? "sear" : "set";
+            block.append(1 + (seed >> 8) % 6, 'a' + (seed >> 12) % 26);
+            block += " ";
+        }
+        block += '\n';
+    }
+    block.insert(block.size() / 2, Needle);
+    for (size_t written = 0; written < bytes && out; written += block.size()) {
+        out.write(block.data(), std::min(block.size(), bytes - written));
+    }
+    return static_cast<bool>(out);
+}
+
+// What SearchCommand used to do: each line copied out and searched, from
+// the cursor on and then from the top
+static bool oldNext(const TextBuffer& buffer, int& cursorY, int& cursorX) {
+    for (int y = cursorY; y < buffer.lineCount(); ++y) {
+        int startX = (y == cursorY) ? cursorX + 1 : 0;
+        size_t pos = buffer.line(y).find(Needle, startX);
+        if (pos != std::string::npos) {
+            cursorY = y;
+            cursorX = static_cast<int>(pos);
+            return true;
+        }
+    }
+    for (int y = 0; y < cursorY; ++y) {
+        size_t pos = buffer.line(y).find(Needle);
+        if (pos != std::string::npos) {
+            cursorY = y;
+            cursorX = static_cast<int>(pos);
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool newNext(const TextBuffer& buffer, const SubstringSearch& search, size_t& offset) {
+    size_t found = search.find(buffer, offset + 1, buffer.length(), false);
+    if (found == SubstringSearch::npos) {
+        found = search.find(buffer, 0, offset, false);
+    }
+    offset = found;
+    return found != SubstringSearch::npos;
+}
+
+int main(int argc, char** argv) {
+    size_t megabytes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1024;
+    int repeats = argc > 2 ? std::atoi(argv[2]) : 10000;
+    size_t bytes = megabytes * 1024 * 1024;
+
+    const std::string path = "search_bench.txt";
+    if (!writeSample(path, bytes)) {
+        std::cerr << "Could not write " << megabytes << " MB sample\n";
+        std::remove(path.c_str());
+        return 1;
+    }
+    auto mapped = std::make_shared<MappedFile>();
+    if (!mapped->open(path)) {
+        std::cerr << "Could not map sample\n";
+        std::remove(path.c_str());
+        return 1;
+    }
+    PieceTable buffer;
+    buffer.reset(mapped);
+    buffer.waitForLines(INT_MAX);
+    // A few edits so the text is spread over several pieces
+    for (int i = 1; i <= 8; i++) {
+        buffer.insertAt(buffer.length() / 9 * i, "edit ");
+    }
+    printf("%zu MB, %d lines, best kernel %s\n", megabytes, buffer.lineCount(),
+           scanKernelName(bestScanKernel()));
+
+    // The old search is slow enough that a tenth of the repeats will do
+    int oldRepeats = std::max(1, repeats / 10);
+    int y = 0, x = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < oldRepeats; i++) {
+        oldNext(buffer, y, x);
+    }
+    double oldEach = seconds(start) / oldRepeats;
+    printf("  n, line by line       %10.1f us each  (%d repeats)\n", oldEach * 1e6, oldRepeats);
+
+    SubstringSearch search(Needle);
+    size_t offset = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; i++) {
+        newNext(buffer, search, offset);
+    }
+    double newEach = seconds(start) / repeats;
+    printf("  n, SubstringSearch    %10.1f us each  (%d repeats, %.0fx)\n", newEach * 1e6, repeats,
+           oldEach / newEach);
+
+    // Whole-buffer scans for needles that never match but whose first
+    // and last bytes are common, which is hard on memchr-based searches
+    printf("scans of the whole file\n");
+    std::string_view text(mapped->data(), mapped->size());
+    for (size_t m : {1, 2, 4, 8, 16, 32, 64}) {
+        std::string missing(m, '#');
+        if (m > 1) {
+            missing.front() = 's';
+            missing.back() = 'a';
+        }
+        start = std::chrono::steady_clock::now();
+        size_t found = text.find(missing);
+        printf("  %2zu bytes  string_view %6.2f GB/s", m, bytes / seconds(start) / 1e9);
+        for (ScanKernel kernel : {ScanKernel::Scalar, ScanKernel::Sse2, ScanKernel::Avx2}) {
+            if (kernel > bestScanKernel()) {
+                continue;
+            }
+            SubstringSearch scan(missing, kernel);
+            start = std::chrono::steady_clock::now();
+            found |= scan.find(text);
+            printf("  %s %6.2f GB/s", scanKernelName(kernel), bytes / seconds(start) / 1e9);
+        }
+        printf("%s\n", found == SubstringSearch::npos ? "" : "  (found?)");
+    }
+    std::remove(path.c_str());
+    return 0;
+}
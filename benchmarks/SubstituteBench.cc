@@ -0,0 +1,74 @@
+#include "DamageTracker.h"
+#include "MatchCache.h"
+#include "ParallelSearch.h"
+#include "PieceTable.h"
+#include "Substitute.h"
+#include "UndoJournal.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// :%s/needle/replacement/g over a generated file where one line in ten
+// holds the needle, with the undo journal and the other listeners the
+// editor keeps on its buffer; then the undo of it all, and :g/needle/d.
+// Usage: SubstituteBench [lines]   (default: 1000000)
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    int lines = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    std::string text;
+    unsigned seed = 21;
+    for (int i = 0; i < lines; i++) {
+        seed = seed * 1103515245 + 12345;
+        text += "    value = compute(index, ";
+        text += i % 10 == 0 ? "oldName" : "newName";
+        text += ") + ";
+        text += std::to_string(seed >> 20);
+        text += ";\n";
+    }
+
+    PieceTable buffer;
+    buffer.insertAt(0, text);
+    UndoJournal journal;
+    DamageTracker damage(buffer);
+    MatchCache matches(buffer);
+    buffer.addListener(&journal);
+    buffer.addListener(&damage);
+    buffer.addListener(&matches);
+
+    Regex pattern;
+    std::string error;
+    pattern.compile("oldName", error);
+    Replacement replacement;
+    replacement.parse("renamed(&)", "", error);
+    printf("%d lines, %.1f MB\n", buffer.lineCount(), buffer.length() / 1e6);
+
+    journal.beginStep(0, 0);
+    auto start = std::chrono::steady_clock::now();
+    SubstituteResult result = substituteLines(buffer, pattern, replacement, 0, buffer.lineCount() - 1, true);
+    journal.commit(0, 0);
+    printf("  :%%s      %7.0f ms  (%zu substitutions on %zu lines)\n", seconds(start) * 1e3,
+           result.substitutions, result.lines);
+
+    start = std::chrono::steady_clock::now();
+    int y = 0;
+    int x = 0;
+    journal.undo(buffer, y, x);
+    printf("  undo     %7.0f ms  (%s)\n", seconds(start) * 1e3,
+           buffer.substr(0, buffer.length()) == text ? "restored" : "MISMATCH");
+
+    journal.beginStep(0, 0);
+    start = std::chrono::steady_clock::now();
+    std::vector<int> marked = markLines(pattern, *buffer.snapshot(), 0, buffer.length(), 0, false,
+                                        ThreadPool::shared());
+    double marking = seconds(start);
+    buffer.eraseLines(marked);
+    journal.commit(0, 0);
+    printf("  :g/d     %7.0f ms  (%zu lines, %.0f ms marking them)\n", seconds(start) * 1e3, marked.size(),
+           marking * 1e3);
+    return 0;
+}
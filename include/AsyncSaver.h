@@ -0,0 +1,62 @@
+#ifndef ASYNCSAVER_H
+#define ASYNCSAVER_H
+
+#include "FileManager.h"
+#include "TextBuffer.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes buffer snapshots to disk on a background thread. Saves run one
+// at a time in the order they were asked for, and a save still waiting
+// in the queue is replaced by a newer one of the same file.
+class AsyncSaver {
+public:
+    struct Result {
+        std::string filename;
+        unsigned long tag; // passed through from save()
+        bool ok;
+    };
+
+    explicit AsyncSaver(std::shared_ptr<FileManager> fileManager);
+    // Finishes every queued save before returning
+    ~AsyncSaver();
+
+    void save(const std::string& filename, std::shared_ptr<const TextSnapshot> snapshot, unsigned long tag);
+    bool busy() const;
+    // Blocks until nothing is queued or being written
+    void wait();
+    // Saves finished since the last call, oldest first
+    std::vector<Result> takeResults();
+    // The save being written and how far along it is
+    bool progress(std::string& filename, size_t& written, size_t& total) const;
+
+private:
+    struct Job {
+        std::string filename;
+        std::shared_ptr<const TextSnapshot> snapshot;
+        unsigned long tag;
+    };
+
+    std::shared_ptr<FileManager> fileManager;
+    std::deque<Job> queue;
+    std::vector<Result> results;
+    std::string currentFilename;
+    size_t currentTotal;
+    std::atomic<size_t> currentWritten;
+    bool writing;
+    bool stopping;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::thread writer;
+
+    void run();
+};
+
+#endif
@@ -3,6 +3,7 @@
 
 #include "Editor.h"
 #include <string>
+#include <vector>
 
 class ColonCommands {
 public:
@@ -11,8 +12,16 @@ public:
 
 private:
     Editor& editor;
-    bool isNumber(const std::string& commandStr);
-    void saveFile(const std::string& filename);
+    bool parseAddress(const std::string& text, size_t& at, int& line, bool& given);
+    bool parseRange(const std::string& text, size_t& at, int& first, int& last, bool& given);
+    int readNumber(const std::string& text, size_t& at);
+    bool parseUndoAmount(const std::string& amount, long& count, long& unit);
+    bool readDelimited(const std::string& text, size_t& at, char delimiter, std::string& out);
+    bool searchPattern(const std::string& text, Regex& pattern);
+    void substitute(int first, int last, const std::string& text, const std::vector<int>* marked = nullptr);
+    void global(int first, int last, bool invert, const std::string& text);
+    bool normalKeys(const std::string& command, std::string& keys);
+    void vimgrep(const std::string& args);
     void quit();
     void quitForced();
     void loadFile(const std::string& filename);
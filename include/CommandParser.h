@@ -28,14 +28,14 @@ private:
     void cMotion();
     void deleteRange(int startY, int startX, int endY, int endX);
     void deleteWord();
-    void dd();
+    void dd(int count = 1);
     void dMotion();
     void findCharOnLine(bool lower, char c, int mult = 0);
     void i();
     void I();
     void J();
     void openLine(bool lower);
-    void paste(bool lower);
+    void paste(bool lower, int count = 1);
     void r(char c, int numOfTimes);
     void R();
     void copyCharacters(Editor &editor, char ch, int count);
@@ -46,7 +46,8 @@ private:
     void percentCommand(int percentage);
     void findMatchingBracket(int startX, int startY, bool dir);
 
-    void colonCommand();
+    // The prompt starts out holding prefix, such as '<,'> from Visual mode
+    void colonCommand(const std::string& prefix = "");
     void callMotionCommand(Editor& editor, char ch, int numOfTimes);
     void callDeleteCommand(Editor& editor, bool type, char ch, int numOfTimes);
     void callSearchCommand(Editor& editor, char direction, int numOfTimes);
@@ -0,0 +1,36 @@
+#ifndef DAMAGETRACKER_H
+#define DAMAGETRACKER_H
+
+#include "TextBuffer.h"
+#include <utility>
+#include <vector>
+
+// Document lines whose on-screen image is stale since the last frame.
+// Buffer edits report themselves; the renderer adds scrolling, selection
+// and highlighting changes through the mark calls.
+class DamageTracker : public TextBufferListener {
+public:
+    explicit DamageTracker(const TextBuffer& textBuffer);
+
+    void onInsert(size_t offset, std::string_view text) override;
+    void onErase(size_t offset, std::string_view removed) override;
+
+    void markLines(int from, int to);
+    // Everything from line y down, for edits that shift the lines below
+    void markFrom(int y);
+    void markAll();
+
+    bool isDirty(int y) const;
+    bool allDirty() const;
+    void clear();
+
+private:
+    static constexpr size_t MaxRanges = 64;
+
+    const TextBuffer& textBuffer;
+    std::vector<std::pair<int, int>> ranges;
+    int dirtyFrom;
+    bool all;
+};
+
+#endif
@@ -1,14 +1,28 @@
 #ifndef EDITOR_H
 #define EDITOR_H
 
+#include "AsyncSaver.h"
+#include "DamageTracker.h"
 #include "Display.h"
 #include "FileManager.h"
+#include "GrammarRegistry.h"
+#include "HighlightCache.h"
+#include "LineRenderer.h"
+#include "MacroRecorder.h"
+#include "MatchCache.h"
+#include "MatchCounter.h"
+#include "ParallelSearch.h"
+#include "Regex.h"
 #include "StatusBar.h"
+#include "TextBuffer.h"
+#include "UndoJournal.h"
+#include <chrono>
+#include <deque>
 #include <memory>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 #include <string>
-#include <stack>
 #include "ICommand.h"
 #include "TokenType.h"
 #include "VisualModeHandler.h"
@@ -48,11 +62,26 @@ public:
     std::string getFilename() const;
 
     bool loadFile(const std::string& filename);
-    bool saveFile(const std::string& filename);
+    // Queues a write of the current contents; the result, failure
+    // included, is reported once collectSaveResults picks it up
+    void saveFile(const std::string& filename);
+    // Waits for queued saves, returning false if any of them failed
+    bool finishSaves();
 
     void setIsRunning(bool running);
 
     void setStatusMessage(const std::string& message, bool isError = false);
+    // While set, the bottom row shows this prompt instead of the status bar
+    void setPrompt(const std::string& text);
+    // Shows message now, followed by "match N of M" for searchPattern
+    // at the cursor once the count is in
+    void showMatchCount(const std::string& message, bool isError);
+    // Highlights every match of searchPattern, until :nohlsearch
+    void highlightSearch(bool on);
+    // Replaces the quickfix list with :vimgrep's hits and goes to the first
+    void setQuickfix(std::vector<GrepHit> hits, bool jump);
+    // :cn and :cp, moving step entries along the quickfix list
+    void stepQuickfix(long step);
 
     bool getIsModified() const;
 
@@ -65,13 +94,21 @@ public:
 
     void moveCursorBackWord();
 
-    std::vector<std::string> textBuffer;
+    std::unique_ptr<TextBuffer> textBuffer;
 
-    std::stack<std::pair<std::vector<std::string>, std::pair<int, int>>> fileHistory;
+    void undo();
+    void redo();
+    // g- and g+ for negative and positive steps
+    void undoChronological(long steps);
+    // :earlier and :later with a duration
+    void undoTime(long seconds);
+    std::string undoList() const;
 
     int cursorY;
     int cursorX;
     int preferredCursorX;
+    int getViewOffsetY() const;
+    void setViewOffsetY(int y);
 
     void render();
 
@@ -89,17 +126,35 @@ public:
     std::vector<char> input;
     std::vector<char> backup; // for repeat last command
     void handleInsertToCommand();
+    // Text typed into Insert mode in one go, as one insert
+    void insertText(std::string_view text);
     int lastMult;
     int backupMult;
     std::string commandSeq;
     std::string savedCommandSeq;
     std::string lastCommand; // for commands that don't require this side effect
+    Regex searchPattern; // last / or ? pattern, compiled once for n and N
+    std::string lastReplacement; // what ~ stands for in the next :s
+    // '< and '>, the first and last lines of the last Visual selection
+    int visualFirstLine;
+    int visualLastLine;
     // Repeat last command that changes the file
     std::string lastChangeKeys; // store last change keys
     bool replaying; // are we currently replaying keystrokes for '.'
 
     void recordLastChangeKeys(const std::string &keys);
     void repeatLastChange();
+    // The next key, from runKeys while it has any left, else typed
+    int readKey();
+    bool runningKeys() const;
+    // Runs keys as Command mode input, like :normal, inside the current
+    // undo step. Whatever they leave unfinished is ended as Esc would.
+    void runKeys(const std::string& keys);
+    // q and @
+    MacroRecorder macros;
+    // @{reg} count times, with nothing drawn until the last run ends; @
+    // for the register last run
+    void playMacro(char reg, int count);
     
     void enterVisualModeChar();   
     void enterVisualModeLine();   
@@ -113,19 +168,73 @@ public:
 
 private:
     VisualModeHandler visualModeHandler;
+    std::deque<int> pendingKeys;
+    bool feedingKeys;
+    bool suppressRender; // while a macro or runKeys runs, drawn once it is done
+    char lastMacro;
+    int macroDepth; // macros running macros
     std::shared_ptr<Display> display;
     std::shared_ptr<FileManager> fileManager;
+    std::unique_ptr<AsyncSaver> saver;
     std::unique_ptr<StatusBar> statusBar;
     Mode mode;
     bool isRunning;
     bool enhanced;
 
     std::string filename;
-    std::vector<std::string> unmodifiedFile;
+    UndoJournal undoJournal;
+    unsigned long savedSeq; // undo state last written to disk
 
     int viewOffsetY; 
 
+    static constexpr int BackgroundPollMs = 100;
+    static constexpr int MaxMacroDepth = 100;
+    // Frames come at most this often, and while keys keep coming without
+    // a break, such as a long paste, once every BurstFrameInterval
+    static constexpr std::chrono::milliseconds FrameInterval{16};
+    static constexpr std::chrono::milliseconds BurstFrameInterval{250};
+    std::chrono::steady_clock::time_point lastFrame;
+
+    // What the last frame showed, to tell what the next one must repaint
+    struct DrawnFrame {
+        int viewOffsetY = -1;
+        int rows = 0;
+        int cols = 0;
+        const Grammar* grammar = nullptr;
+        bool hasSelection = false;
+        VisualType selectionType = VisualType::Character;
+        int selStartY = 0, selStartX = 0, selEndY = 0, selEndX = 0;
+    };
+    DrawnFrame drawn;
+    GrammarRegistry grammars;
+    const Grammar* grammar; // for the current file, null for plain text
+    std::unique_ptr<DamageTracker> damage;
+    std::unique_ptr<HighlightCache> highlights;
+    std::unique_ptr<MatchCache> matches;
+    MatchCounter matchCounter;
+    bool countPending; // a search is waiting for its match count
+    size_t countOffset;
+    std::string countMessage;
+    bool countIsError;
+    std::vector<GrepHit> quickfix;
+    size_t quickfixIndex;
+    LineRenderer lineRenderer;
+    std::string lineText; // reused by drawLine
+    std::string prompt;
+
+    void drawLine(WINDOW* win, int i, int actualLine, int lineCount, int cols);
+    void detectGrammar();
+    void markSelectionDamage();
     void handleInput(int ch, CommandParser& commandParser);
+    // Parses and runs pendingKeys until they run out
+    void parsePendingKeys();
+    // Inserts what run() gathered of a run of typed text and empties it
+    void typeText(std::string& typed);
+    bool collectSaveResults();
+    void collectMatchCount();
+    // Jumps to a quickfix entry, which becomes the current one only if
+    // the jump is made
+    bool showQuickfix(size_t index);
     void ensureCursorInBounds(bool vertical);
 
     CommandParser* commandParserRef;
@@ -1,6 +1,8 @@
 #ifndef FILEMANAGER_H
 #define FILEMANAGER_H
 
+#include "TextBuffer.h"
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -9,8 +11,11 @@ public:
     FileManager();
     ~FileManager();
 
-    bool loadFile(const std::string& filename, std::vector<std::string>& textBuffer);
-    bool saveFile(const std::string& filename, const std::vector<std::string>& textBuffer);
+    bool loadFile(const std::string& filename, TextBuffer& textBuffer);
+    bool saveFile(const std::string& filename, const TextBuffer& textBuffer);
+    // Safe to call from any thread; progress is told the bytes written so far
+    bool saveFile(const std::string& filename, const TextSnapshot& snapshot,
+                  const std::function<void(size_t)>& progress = nullptr);
     bool fileExists(const std::string& filename) const;
 };
 
@@ -0,0 +1,96 @@
+#ifndef GRAMMAR_H
+#define GRAMMAR_H
+
+#include "TokenType.h"
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// One way a token can start, in the order the grammar lists them
+struct GrammarRule {
+    enum class Kind {
+        Line, // start to the end of the line
+        Region, // start to end, possibly across lines
+        Run, // a byte from `first` and then any bytes from `rest`
+        Word, // a run looked up in the grammar's word list first
+        Symbols, // one byte from `first`
+        Pairs, // one of `pairs`
+        Brackets // one of `brackets`, matched against the open ones
+    };
+
+    Kind kind = Kind::Symbols;
+    TokenType type = TokenType::PlainText;
+    std::string start;
+    std::string end;
+    char escape = 0; // inside a region, takes the next byte with it
+    bool multiline = false;
+    bool lineStart = false; // only before anything but blanks
+    std::string before; // must come next, after any blanks
+    std::bitset<256> first;
+    std::bitset<256> rest;
+    bool identifierRest = false; // rest is letters, digits and '_'
+    std::string pairs; // two bytes each
+    std::string brackets; // open and close bytes, alternating
+};
+
+// A language compiled from its grammar text: rules, a table of the rules
+// worth trying for each first byte, and the words of the word rules
+// behind a perfect hash built when the grammar is loaded.
+//
+// Grammar text is one directive per line; ';' starts a comment line.
+//   language <name>
+//   extensions <ext>...          without the dot
+//   filenames <name>...          whole file names such as Makefile
+//   interpreters <name>...       as named by a #! line
+//   <type> words <word>...
+//   <type> line <start>
+//   <type> region <start> <end> [escape <c>] [multiline]
+//   <type> run <first> <rest>
+//   <type> word <first> <rest>
+//   <type> symbols <bytes>
+//   <type> pairs <pair>...
+//   <type> brackets <open><close>...
+// Any rule also takes [linestart] and [before <text>]. Byte sets are
+// written like a-zA-Z_- with any literal - last; "\s" is a space and
+// "\\" a backslash.
+// Types are keyword, type, constant, function, variable, key, number,
+// string, comment, preprocessor, operator, punctuation, identifier and
+// plain.
+class Grammar {
+public:
+    std::string name;
+    std::vector<std::string> extensions;
+    std::vector<std::string> filenames;
+    std::vector<std::string> interpreters;
+    std::vector<GrammarRule> rules;
+
+    // Rules to try for a byte: candidates[firstCandidate[c]] up to
+    // candidates[firstCandidate[c + 1]]
+    std::array<uint16_t, 257> firstCandidate{};
+    std::vector<uint16_t> candidates;
+
+    // Parses and compiles source, replacing this grammar
+    bool compile(std::string_view source, std::string& error);
+
+    // The type of a word listed by a words directive
+    bool lookupWord(std::string_view word, TokenType& type) const;
+
+private:
+    struct Word {
+        std::string text;
+        TokenType type;
+    };
+    std::vector<Word> words;
+    std::vector<uint16_t> slots; // word index + 1, 0 when empty
+    uint64_t seed = 0;
+    int shift = 64;
+    size_t shortestWord = 0;
+    size_t longestWord = 0;
+
+    bool buildWordTable();
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef GRAMMARREGISTRY_H
+#define GRAMMARREGISTRY_H
+
+#include "Grammar.h"
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// The grammar text of every language built into the editor
+std::span<const std::string_view> builtinGrammars();
+
+// Compiles grammars once and finds the one for a file by its extension,
+// its whole name or the interpreter on its #! line, each a single hash
+// lookup. A grammar loaded later takes over the names it shares with
+// an earlier one.
+class GrammarRegistry {
+public:
+    // Starts out with the built-in grammars
+    GrammarRegistry();
+
+    GrammarRegistry(const GrammarRegistry&) = delete;
+    GrammarRegistry& operator=(const GrammarRegistry&) = delete;
+
+    bool load(std::string_view source, std::string& error);
+    // Loads every *.grammar file in dir; a missing dir is not an error
+    bool loadDirectory(const std::string& dir, std::string& error);
+
+    // Null when nothing matches, for plain text
+    const Grammar* forFile(std::string_view filename, std::string_view firstLine) const;
+    const Grammar* byName(std::string_view name) const;
+
+private:
+    std::vector<std::unique_ptr<Grammar>> grammars;
+    std::unordered_map<std::string, const Grammar*> names;
+    std::unordered_map<std::string, const Grammar*> extensions;
+    std::unordered_map<std::string, const Grammar*> filenames;
+    std::unordered_map<std::string, const Grammar*> interpreters;
+
+    static const Grammar* find(const std::unordered_map<std::string, const Grammar*>& map,
+                               std::string_view key);
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef HIGHLIGHTCACHE_H
+#define HIGHLIGHTCACHE_H
+
+#include "HighlightWorker.h"
+#include "Lexer.h"
+#include "TextBuffer.h"
+#include <string>
+#include <vector>
+
+// Tokens of every line lexed so far, with the lexer state each line
+// starts in. An edit marks its line stale, and re-lexing runs on from
+// there only until a line ends in the state the next line was already
+// lexed from. An edit that adds or removes lines cuts the cache after
+// its line, so line numbers never have to be shifted; deleting from the
+// bottom up, as :g/pat/d does, costs the length of the cache in all.
+//
+// Near the viewport that happens on the UI thread. Anything further,
+// such as the lines above a jump to the end of a big file, is left to a
+// background worker; until it catches up, visible lines are lexed from
+// a guessed state so drawing never waits for it.
+class HighlightCache : public TextBufferListener {
+public:
+    explicit HighlightCache(const TextBuffer& textBuffer);
+
+    void onInsert(size_t offset, std::string_view text) override;
+    void onErase(size_t offset, std::string_view removed) override;
+
+    // Makes tokens() usable for lines first to last. Lines whose tokens
+    // changed, edited or not, are reported in [from, to]; returns false
+    // when there are none.
+    bool update(int first, int last, int& from, int& to);
+    // Valid for the lines of the last update
+    const std::vector<Token>& tokens(int y) const;
+    // True while the worker is still lexing
+    bool busy() const;
+
+    // Forgets everything, for when the whole buffer was replaced
+    void clear();
+    // Lexes with grammar from now on, starting over if it is a new one
+    void setGrammar(const Grammar* grammar);
+
+private:
+    // Lines re-lexed on the UI thread per update before the worker is asked
+    static constexpr int InlineLines = 256;
+    // How far past the viewport the worker keeps going
+    static constexpr int Lookahead = 4096;
+
+    struct Line {
+        LexerState start;
+        std::vector<Token> tokens;
+        bool stale = true; // start or text changed since the end state was passed on
+        bool lexed = false; // tokens match start and text
+    };
+
+    const TextBuffer& textBuffer;
+    Lexer lexer;
+    HighlightWorker worker;
+    std::vector<Line> lines; // a prefix of the document
+    int firstStale; // no stale line before this one
+    int jobLast; // last line the worker was asked for, -1 when idle
+    int guessFirst;
+    std::vector<std::vector<Token>> guesses; // visible lines past the prefix
+    std::string text; // the line being lexed, reused
+
+    void markStale(int y);
+    bool needsLexing(int y) const;
+    void lexLine(int y);
+    void adopt(int y, LexerState&& state);
+    void report(int y, bool& restyled, int& from, int& to);
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef HIGHLIGHTWORKER_H
+#define HIGHLIGHTWORKER_H
+
+#include "Lexer.h"
+#include "TextBuffer.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+// Lexes a run of lines of a snapshot on its own thread to find the state
+// each line starts in. Results go through a single-producer
+// single-consumer ring, so the UI thread picks them up without locking.
+class HighlightWorker {
+public:
+    // The state `line` starts in; a line of -1 marks the end of a job
+    struct Result {
+        unsigned generation = 0;
+        int line = 0;
+        LexerState state;
+    };
+
+    HighlightWorker();
+    ~HighlightWorker();
+
+    HighlightWorker(const HighlightWorker&) = delete;
+    HighlightWorker& operator=(const HighlightWorker&) = delete;
+
+    // Drops the running job, if any, and lexes lines `line` to `last`
+    // with grammar, the first of which begins at byte `offset` in `state`
+    void start(const Grammar* grammar, std::shared_ptr<const TextSnapshot> snapshot, size_t offset,
+               int line, const LexerState& state, int last);
+    void cancel();
+    // Takes the next result of the current job
+    bool poll(Result& result);
+
+private:
+    static constexpr size_t Capacity = 1 << 16;
+
+    struct Job {
+        const Grammar* grammar;
+        std::shared_ptr<const TextSnapshot> snapshot;
+        size_t offset;
+        int line;
+        LexerState state;
+        int last;
+    };
+
+    Lexer lexer;
+    std::vector<Result> ring;
+    std::atomic<size_t> head; // next slot the worker fills
+    std::atomic<size_t> tail; // next slot the UI thread reads
+    std::atomic<unsigned> generation;
+    std::optional<Job> pending; // guarded by mutex
+    bool stopping;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread thread;
+
+    void run();
+    void lex(Job& job, unsigned gen);
+    bool publish(unsigned gen, int line, const LexerState& state);
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef INCREMENTALSEARCH_H
+#define INCREMENTALSEARCH_H
+
+#include "Regex.h"
+#include "TextBuffer.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Looks for the first match of a / or ? pattern while it is still being
+// typed, on its own thread so no keystroke waits for a scan. Starting a
+// search drops the one before it, which notices between slices of the
+// buffer.
+//
+// A scan keeps going after its first match to remember more of them. When
+// the next pattern is the last one with more literal text on the end, its
+// matches are among those, so they are checked in place first and only
+// the part of the buffer the last scan did not reach is searched again.
+class IncrementalSearch {
+public:
+    struct Result {
+        unsigned generation = 0;
+        bool found = false;
+        RegexMatch match;
+    };
+
+    IncrementalSearch();
+    ~IncrementalSearch();
+
+    IncrementalSearch(const IncrementalSearch&) = delete;
+    IncrementalSearch& operator=(const IncrementalSearch&) = delete;
+
+    // The first match after origin (before it when backward), wrapping
+    // around the end of the snapshot like / and ? do. Returns the
+    // generation the result will carry.
+    unsigned start(const Regex& pattern, std::shared_ptr<const TextSnapshot> snapshot, size_t origin,
+                   bool backward);
+    void cancel();
+    // The result of the latest start, once, when it is known
+    bool poll(Result& result);
+    bool busy() const;
+
+private:
+    // Bytes searched between checks for a newer search
+    static constexpr size_t SliceBytes = 1 << 20;
+    // Match starts remembered for the next, longer pattern
+    static constexpr size_t MaxHits = 1 << 16;
+
+    struct Job {
+        Regex pattern;
+        std::shared_ptr<const TextSnapshot> snapshot;
+        size_t origin;
+        bool backward;
+    };
+
+    // Where a scan has got to: the first two ranges of the wrapped order
+    // of offsets, and the offset next to search from (forward) or below
+    // (backward) in the current one
+    struct Progress {
+        int range = 0;
+        size_t next = 0;
+        bool done() const { return range == 2; }
+    };
+
+    // What the last scan found, valid for the next one over the same
+    // snapshot, origin and direction
+    struct Scan {
+        std::shared_ptr<const TextSnapshot> snapshot;
+        size_t origin = 0;
+        bool backward = false;
+        std::string literal;
+        std::vector<size_t> hits; // every match start before progress, in scan order
+        Progress progress;
+    };
+
+    std::optional<Job> pending; // guarded by mutex
+    std::optional<Result> ready; // guarded by mutex
+    std::atomic<unsigned> generation;
+    bool running; // guarded by mutex
+    bool stopping;
+    Scan scan; // only touched by the worker
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::thread thread;
+
+    void run();
+    void search(Job& job, unsigned gen);
+    // The match starts from range `range` of the wrapped order, as [first, end)
+    static void bounds(const Job& job, int range, size_t& first, size_t& end);
+    void publish(unsigned gen, bool found, const RegexMatch& match);
+};
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef LEXSCANNER_H
+#define LEXSCANNER_H
+
+#include <cstddef>
+#include <string_view>
+
+// The long runs the lexer skips over, scanned a block at a time. Each
+// returns the index of the first byte at or after `from` that ends the
+// run, or text.size() when the run reaches the end.
+enum class ScanKernel {
+    Scalar,
+    Sse2,
+    Avx2
+};
+
+// The widest kernel this CPU supports, detected once
+ScanKernel bestScanKernel();
+const char* scanKernelName(ScanKernel kernel);
+
+// Each takes a kernel no wider than bestScanKernel()
+// Next `quote` or backslash
+size_t findStringStop(ScanKernel kernel, std::string_view text, size_t from, char quote);
+// First byte that is not a letter, digit or '_'
+size_t skipIdentifier(ScanKernel kernel, std::string_view text, size_t from);
+// First byte that is not a space or tab
+size_t skipBlanks(ScanKernel kernel, std::string_view text, size_t from);
+
+#endif
@@ -1,28 +1,42 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include "Grammar.h"
+#include "LexScanner.h"
 #include "Token.h"
 #include <vector>
 #include <string>
-#include <unordered_set>
-#include <stack>
+#include <string_view>
 
+// Everything the lexer carries from the end of one line to the next
+struct LexerState {
+    uint16_t region = 0; // rule number + 1 of the region left open, if any
+    std::string delimiters; // open brackets, innermost last
+
+    bool operator==(const LexerState& other) const = default;
+};
+
+// Runs a grammar's rules over a line. Without a grammar every line is
+// one plain text token.
 class Lexer {
 public:
     Lexer();
+    explicit Lexer(const Grammar* grammar);
+    Lexer(const Grammar* grammar, ScanKernel kernel);
 
-    std::vector<Token> tokenize(const std::string& line);
+    void setGrammar(const Grammar* grammar);
+    const Grammar* getGrammar() const;
 
-private:
-    std::unordered_set<std::string> keywords;
+    // Lexes one line starting in `state` into `tokens`, reusing its
+    // storage, and leaves the state at the end of the line
+    void tokenize(std::string_view line, LexerState& state, std::vector<Token>& tokens);
 
-    bool isKeyword(const std::string& word);
-    bool isIdentifierChar(char c);
-    bool isOperatorChar(char c);
-    bool isPunctuationChar(char c);
+private:
+    const Grammar* grammar;
+    ScanKernel kernel;
 
-    bool inMultiLineComment;
-    std::stack<char> delimiterStack;
+    int regionEnd(const GrammarRule& rule, std::string_view line, int from) const;
+    int runEnd(const GrammarRule& rule, std::string_view line, int from) const;
 };
 
 #endif
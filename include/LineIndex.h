@@ -0,0 +1,63 @@
+#ifndef LINEINDEX_H
+#define LINEINDEX_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Offsets of every '\n' in a block of text, found in the background.
+// The text is split into fixed-size chunks that worker threads claim in
+// order and publish as soon as every chunk before them is done, so the
+// first lines can be looked up long before the whole block is indexed.
+class LineIndex {
+public:
+    // Below this size a single worker is used
+    static constexpr size_t ParallelThreshold = 64 * 1024 * 1024;
+
+    LineIndex();
+    ~LineIndex();
+
+    LineIndex(const LineIndex&) = delete;
+    LineIndex& operator=(const LineIndex&) = delete;
+
+    // Starts indexing; data must stay valid until the index is destroyed.
+    // A worker count of 0 picks one from the hardware and the size.
+    void build(const char* data, size_t size, unsigned workers = 0);
+
+    // Newlines found so far and the offset of the i-th one (i < ready())
+    size_t ready() const;
+    size_t at(size_t i) const;
+    bool complete() const;
+
+    // Blocks until `count` newlines are known or the scan is finished
+    void waitFor(size_t count);
+    // Waits for the whole scan and hands over every offset in order
+    std::vector<size_t> take();
+
+private:
+    static constexpr size_t ChunkSize = 4 * 1024 * 1024;
+
+    const char* data;
+    size_t size;
+    unsigned workerCount;
+    std::vector<std::vector<size_t>> chunks; // sized up front, never reallocated
+    std::unique_ptr<bool[]> finished; // guarded by mutex
+    std::vector<size_t> firstLine; // newlines before each chunk
+    std::atomic<size_t> nextChunk;
+    std::atomic<size_t> chunksReady;
+    std::atomic<bool> done;
+    std::atomic<bool> cancelled;
+    std::thread coordinator;
+    std::mutex mutex;
+    std::condition_variable progress;
+
+    void run();
+    void work();
+    void stop();
+};
+
+#endif
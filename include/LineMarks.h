@@ -0,0 +1,33 @@
+#ifndef LINEMARKS_H
+#define LINEMARKS_H
+
+#include "TextBuffer.h"
+#include <string_view>
+#include <vector>
+
+// The lines :g marked, visited in order while the command run on each
+// edits the buffer. Marks follow their lines as lines come and go above
+// them, and a mark whose line is deleted is skipped. Edits above the next
+// mark, the usual case, cost one shift for all the marks still to come.
+class LineMarks : public TextBufferListener {
+public:
+    LineMarks(const TextBuffer& textBuffer, std::vector<int> lines);
+
+    // Where the next mark still standing is now; false after the last
+    bool next(int& line);
+
+    void onInsert(size_t offset, std::string_view text) override;
+    void onErase(size_t offset, std::string_view removed) override;
+
+private:
+    const TextBuffer& textBuffer;
+    std::vector<int> lines;
+    std::vector<bool> dropped;
+    size_t ahead; // lines[ahead] onwards are still to come
+    int shift;    // added to each of them
+
+    // Moves the marks still to come below line y by delta lines
+    void moveBelow(int y, int delta);
+};
+
+#endif
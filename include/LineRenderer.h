@@ -0,0 +1,49 @@
+#ifndef LINERENDERER_H
+#define LINERENDERER_H
+
+#include "TokenType.h"
+#include <ncurses.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Consecutive cells of one screen row that share the same attributes
+struct AttrRun {
+    attr_t attr;
+    int start;
+    int length;
+};
+
+// Colour pair and attributes a token is drawn with
+attr_t tokenAttributes(TokenType type);
+
+// Lays out one screen row as attribute runs so it can be drawn with a
+// single waddnstr per run instead of a call sequence per character.
+// Every byte takes exactly one cell.
+class LineRenderer {
+public:
+    void begin(int cols);
+    // Appends text up to the right edge, merging with the last run when
+    // the attributes match
+    void add(std::string_view text, attr_t attr);
+    // Pads the row out to the right edge
+    void fill(attr_t attr);
+    // Redraws cells [from, to) with attr, splitting the runs it crosses
+    void overlay(int from, int to, attr_t attr);
+
+    const std::vector<AttrRun>& runs() const;
+    const std::string& text() const;
+
+    // Returns the number of ncurses calls made
+    int draw(WINDOW* win, int row) const;
+
+private:
+    int cols = 0;
+    std::string cells;
+    std::vector<AttrRun> spans;
+    std::vector<AttrRun> scratch;
+
+    void push(std::vector<AttrRun>& out, attr_t attr, int start, int length);
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef MACRORECORDER_H
+#define MACRORECORDER_H
+
+#include <array>
+#include <string>
+#include <vector>
+
+// One step of a recorded macro. Text typed in Insert mode is kept as a
+// string to go in with a single insert; every other key is kept as it
+// was read, for the command parser.
+struct MacroOp {
+    enum Kind { Keys, Text };
+    Kind kind;
+    std::vector<int> keys;
+    std::string text;
+};
+
+// The keys read between q{reg} and q, compiled into operations as they
+// come so @{reg} has nothing left to work out before it runs them.
+class MacroRecorder {
+public:
+    MacroRecorder();
+
+    // Registers are a to z and 0 to 9; A to Z append to a to z
+    bool start(char reg);
+    // Ends the recording and drops the q that ended it
+    void stop();
+    bool recording() const;
+    // The register being recorded into, 0 when none
+    char recordingRegister() const;
+    // A key read while recording; inserting when Insert mode reads it
+    void record(int ch, bool inserting);
+
+    // The macro in reg, null for a bad register; empty if none is recorded
+    const std::vector<MacroOp>* ops(char reg) const;
+
+private:
+    std::array<std::vector<MacroOp>, 36> registers;
+    std::vector<MacroOp> recorded;
+    char reg;
+    bool appending;
+
+    static int slot(char reg);
+};
+
+#endif
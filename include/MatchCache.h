@@ -0,0 +1,68 @@
+#ifndef MATCHCACHE_H
+#define MATCHCACHE_H
+
+#include "Regex.h"
+#include "TextBuffer.h"
+#include <map>
+#include <vector>
+
+// Cells of one screen row inside a search match, as [start, end) columns
+struct MatchSpan {
+    int start;
+    int end;
+};
+
+// Where the last / or ? pattern matches on the lines around the
+// viewport, for highlighting all of them. Each line is searched once and
+// keeps its matches until an edit touches it, so scrolling back over it
+// costs nothing. A pattern that can cross a line break may match from
+// any line above an edit into it, so those lines are searched again too.
+class MatchCache : public TextBufferListener {
+public:
+    explicit MatchCache(const TextBuffer& textBuffer);
+
+    void onInsert(size_t offset, std::string_view text) override;
+    void onErase(size_t offset, std::string_view removed) override;
+
+    // Highlights pattern from now on, starting over if it is a new one.
+    // An empty Regex highlights nothing.
+    void setPattern(const Regex& pattern);
+    // Makes spans() usable for lines first to last. Lines whose spans
+    // differ from the ones the last update gave them are reported in
+    // [from, to]; returns false when there are none.
+    bool update(int first, int last, int& from, int& to);
+    // Valid for the lines of the last update, in order
+    const std::vector<MatchSpan>& spans(int y) const;
+
+    // Forgets every line, for when the whole buffer was replaced
+    void clear();
+    // Lines searched so far, to tell a cached line from a fresh one
+    unsigned long linesSearched() const;
+
+private:
+    // Lines kept around the viewport before far ones are dropped
+    static constexpr size_t MaxLines = 1 << 14;
+    // Nothing is drawn this far along a line, so no match starting past it is looked for
+    static constexpr size_t MaxColumns = 1 << 16;
+
+    // A match starting on a line, in bytes from the line's start; the
+    // end may be on a later line
+    struct Hit {
+        size_t start;
+        size_t end;
+    };
+
+    const TextBuffer& textBuffer;
+    Regex pattern;
+    std::map<int, std::vector<Hit>> lines;
+    int visibleFirst;
+    std::vector<std::vector<MatchSpan>> visible;
+    std::vector<MatchSpan> row; // reused by update
+    unsigned long searched;
+
+    const std::vector<Hit>& hits(int y);
+    // Drops lines from..to and moves the ones below by delta
+    void forget(int from, int to, int delta);
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef MATCHCOUNTER_H
+#define MATCHCOUNTER_H
+
+#include "Regex.h"
+#include "TextBuffer.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Counts the matches of a pattern over a whole snapshot on its own
+// thread, for the "match 37 of 2,114" shown after a search. The starts
+// it found are kept, so n and N over the same text only look them up.
+class MatchCounter {
+public:
+    // Past this many the count stops, like Vim's maxcount
+    static constexpr size_t MaxCount = 1 << 20;
+
+    MatchCounter();
+    ~MatchCounter();
+
+    MatchCounter(const MatchCounter&) = delete;
+    MatchCounter& operator=(const MatchCounter&) = delete;
+
+    // Counts pattern in snapshot, the text of the buffer at version,
+    // unless that is what the last count was of
+    void count(const Regex& pattern, std::shared_ptr<const TextSnapshot> snapshot, unsigned long version);
+    void cancel();
+    // Once the latest count is done: the number of the match starting at
+    // offset (0 when it is past the counted ones) and how many there are.
+    // capped is set when there are more than MaxCount.
+    bool result(size_t offset, size_t& index, size_t& total, bool& capped) const;
+    bool busy() const;
+
+private:
+    // Bytes searched between checks for a newer count
+    static constexpr size_t SliceBytes = 1 << 20;
+
+    struct Job {
+        Regex pattern;
+        std::shared_ptr<const TextSnapshot> snapshot;
+    };
+
+    std::string pattern; // what the latest count is of, with version
+    unsigned long version;
+    std::optional<Job> pending; // guarded by mutex
+    std::vector<size_t> starts; // guarded by mutex
+    bool capped; // guarded by mutex
+    bool done; // guarded by mutex
+    bool stopping;
+    std::atomic<unsigned> generation;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::thread thread;
+
+    void run();
+    void scan(Job& job, unsigned gen);
+};
+
+#endif
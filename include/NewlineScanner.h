@@ -0,0 +1,23 @@
+#ifndef NEWLINESCANNER_H
+#define NEWLINESCANNER_H
+
+#include <cstddef>
+#include <vector>
+
+enum class NewlineKernel {
+    Scalar,
+    Sse2,
+    Avx2
+};
+
+// The widest kernel this CPU supports, detected once
+NewlineKernel bestNewlineKernel();
+const char* newlineKernelName(NewlineKernel kernel);
+
+// Appends base + offset for every '\n' in [data, data + size)
+void scanNewlines(const char* data, size_t size, size_t base, std::vector<size_t>& out);
+// kernel must not be wider than bestNewlineKernel()
+void scanNewlinesWith(NewlineKernel kernel, const char* data, size_t size, size_t base,
+                      std::vector<size_t>& out);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef PARALLELSEARCH_H
+#define PARALLELSEARCH_H
+
+#include "Regex.h"
+#include "TextBuffer.h"
+#include "ThreadPool.h"
+#include <string>
+#include <vector>
+
+// Searches too big for one thread, split into tasks for a ThreadPool.
+// Every worker searches with its own copy of the pattern, since a Regex
+// fills a cache as it goes.
+
+struct MatchTally {
+    size_t matches = 0;
+    size_t lines = 0;
+};
+
+// What :s/pat//n reports for the lines whose text runs from first to
+// end: the first match on each line, or every match when everyMatch.
+// The text is cut into pieces at line starts; a pattern that can match
+// over a line break is searched in one piece.
+MatchTally countMatches(const Regex& pattern, const TextSnapshot& text, size_t first, size_t end,
+                        bool everyMatch, ThreadPool& pool);
+
+// The lines :g marks in the text from first to end, whose first line
+// is firstLine: those holding a match, or with invert (for :v) those that
+// hold none. Each comes once and in order.
+std::vector<int> markLines(const Regex& pattern, const TextSnapshot& text, size_t first, size_t end,
+                           int firstLine, bool invert, ThreadPool& pool);
+
+// One :vimgrep match; line and column count from 0
+struct GrepHit {
+    std::string file;
+    int line;
+    int column;
+    std::string text; // the line, cut short when long
+};
+
+// The files the globs name, in order and each once. ** stands for any
+// number of directories, skipping hidden ones; * and ? match within a
+// name. A word without wildcards is taken as a file name.
+bool expandGlobs(const std::vector<std::string>& globs, std::vector<std::string>& files,
+                 std::string& error);
+
+// Maps each file and searches it on a pool worker, the first match on
+// each line or every match. Hits come back in file order.
+void grepFiles(const Regex& pattern, const std::vector<std::string>& files, bool everyMatch,
+               ThreadPool& pool, std::vector<GrepHit>& hits);
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef PIECETABLE_H
+#define PIECETABLE_H
+
+#include "LineIndex.h"
+#include "TextBuffer.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Piece table over a read-only original (the mapped file) and an
+// append-only add buffer. Pieces live in a treap keyed by position whose
+// nodes carry subtree byte and newline counts, so edits and line lookups
+// are O(log n) wherever they land in the document.
+//
+// Originals above BackgroundIndexThreshold have their newlines found by a
+// background thread. Until it finishes only the lines indexed so far are
+// visible, and the first edit waits for the rest.
+class PieceTable : public TextBuffer {
+public:
+    static constexpr size_t BackgroundIndexThreshold = 8 * 1024 * 1024;
+
+    PieceTable();
+    ~PieceTable();
+
+    size_t length() const override;
+    int lineCount() const override;
+    size_t lineStart(int y) const override;
+    int lineAt(size_t offset) const override;
+    char byteAt(size_t offset) const override;
+    void copy(size_t offset, size_t count, std::string& out) const override;
+    void forEachChunk(const std::function<void(const char*, size_t)>& fn) const override;
+    std::string_view chunkAt(size_t offset, size_t& chunkStart) const override;
+    std::shared_ptr<const TextSnapshot> snapshot() const override;
+    void reset(std::shared_ptr<const MappedFile> original) override;
+    unsigned long version() const override;
+    bool isIndexing() const override;
+    void waitForLines(int count) override;
+
+protected:
+    void insertBytes(size_t offset, std::string_view text) override;
+    void eraseBytes(size_t offset, size_t count) override;
+
+private:
+    struct Buffer {
+        const char* data = nullptr;
+        size_t size = 0;
+        size_t capacity = 0;
+        std::vector<size_t> lineFeeds; // offsets of every '\n' in data
+        std::unique_ptr<char[]> storage; // add buffer blocks own their bytes
+        std::shared_ptr<const MappedFile> mapping; // original keeps the file mapped
+    };
+
+    struct Piece {
+        int buffer;
+        size_t start;
+        size_t length;
+        size_t lineFeeds;
+    };
+
+    struct Node {
+        Piece piece;
+        uint32_t priority;
+        int left;
+        int right;
+        size_t subLength;
+        size_t subLineFeeds;
+    };
+
+    std::vector<std::shared_ptr<Buffer>> buffers;
+    std::vector<Node> nodes;
+    std::vector<int> freeNodes;
+    int root;
+    uint32_t seed;
+    unsigned long editVersion;
+    std::unique_ptr<LineIndex> pendingIndex; // original's newlines while still being found
+
+    static constexpr size_t AddBlockSize = 64 * 1024;
+
+    void adoptIndex();
+    int newNode(const Piece& piece);
+    void freeTree(int t);
+    void update(int t);
+    size_t subLength(int t) const;
+    size_t subLineFeeds(int t) const;
+    size_t countLineFeeds(int buffer, size_t start, size_t length) const;
+
+    void split(int t, size_t offset, int& left, int& right);
+    void cut(int t, size_t offset, int& left, int& right, int& tail);
+    int merge(int left, int right);
+    int rightmost(int t) const;
+    void extendRightmost(int t, size_t length, size_t lineFeeds);
+
+    Piece append(std::string_view text);
+    void collect(int t, size_t from, size_t to, size_t base, std::string& out) const;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef REGEX_H
+#define REGEX_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+class TextBuffer;
+class TextSnapshot;
+
+struct RegexMatch {
+    size_t start = 0;
+    size_t end = 0;
+};
+
+// A pattern in Vim's default ("magic") syntax, compiled once to an NFA
+// and searched with a DFA built lazily as the text needs its states, so
+// no pattern makes a search backtrack. Supported:
+//   literals, ., [abc], [^a-z], [[:alpha:]] and the other POSIX classes
+//   \s \S \d \D \w \W \a \A \l \L \u \U \x \X \h \H \o \O
+//   \t \e \r \n (a line break, so a match may span lines)
+//   ^ $ \< \>
+//   * \+ \= \? \{n,m} \{n} \{n,} \{,m} and \{-n,m} for the fewest
+//   \(...\) \%(...\) \|
+//   \c and \C anywhere to ignore or match case
+// Matches are leftmost-first like Vim's: the earliest start, then the
+// alternative and repeat counts Vim would prefer.
+//
+// When a pattern needs more DFA states than the cache holds, the search
+// finishes on the NFA directly, which is slower but still linear.
+// A plain literal skips all of this and goes to SubstringSearch.
+//
+// Searching fills a cache, so one Regex must not be searched from two
+// threads at once; copies share the compiled program and each gets its
+// own cache.
+class Regex {
+public:
+    Regex();
+    Regex(const Regex& other);
+    Regex& operator=(const Regex& other);
+    ~Regex();
+
+    // Errors read like Vim's, e.g. "E54: Unmatched \("
+    bool compile(std::string_view pattern, std::string& error);
+    bool empty() const;
+    const std::string& pattern() const;
+    // The text a pattern with nothing special in it stands for, else null
+    const std::string* literal() const;
+    // True when a match may run over a line break (\n, \_s and the like)
+    bool spansLines() const;
+
+    // The first match starting anywhere in [first, last], or the last one
+    // when backward. The bytes around the range still count for ^, $, \<
+    // and \>, and a match may run past last.
+    bool search(const TextBuffer& buffer, size_t first, size_t last, bool backward,
+                RegexMatch& match) const;
+    bool search(const TextSnapshot& snapshot, size_t first, size_t last, bool backward,
+                RegexMatch& match) const;
+    bool search(std::string_view text, size_t first, size_t last, bool backward,
+                RegexMatch& match) const;
+
+    // The forward search on the NFA alone, to check the DFA against
+    bool searchNfa(std::string_view text, size_t first, size_t last, RegexMatch& match) const;
+
+private:
+    struct Program;
+    struct Cache;
+    struct Input;
+
+    std::string source;
+    std::shared_ptr<const Program> program;
+    std::unique_ptr<Cache> cache;
+
+    bool run(const Input& input, size_t first, size_t last, bool backward, RegexMatch& match) const;
+    // earliest stops at the first end any match reaches, for a match
+    // that need not be the leftmost-first one
+    bool forward(const Input& input, size_t first, size_t last, bool earliest, RegexMatch& match) const;
+    bool backward(const Input& input, size_t first, size_t last, RegexMatch& match) const;
+    bool pike(const Input& input, size_t first, size_t last, RegexMatch& match) const;
+};
+
+#endif
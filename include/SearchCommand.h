@@ -2,6 +2,7 @@
 #define SEARCHCOMMAND_H
 
 #include "Editor.h"
+#include "Regex.h"
 #include <string>
 
 class SearchCommand {
@@ -10,13 +11,16 @@ public:
     ~SearchCommand();
 
     void execute(const std::string& word, char direction);
+    // Reads a pattern on the bottom row, moving the cursor to its first
+    // match as it is typed. False when the search is abandoned.
+    bool captureSearchInput(char direction, std::string& query);
 
 private:
+    static constexpr int PreviewPollMs = 10;
+
     Editor& editor;
     int numOfTimes;
-
-    std::string captureSearchInput(char direction);
-    bool performSearch(const std::string& query, char direction, int& foundY, int& foundX);
+    bool performSearch(const Regex& pattern, char direction, size_t& offset, bool& wrapped);
     void highlightPattern(int y, int x, const std::string& query, char direction);
 };
 
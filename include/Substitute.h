@@ -0,0 +1,48 @@
+#ifndef SUBSTITUTE_H
+#define SUBSTITUTE_H
+
+#include "Regex.h"
+#include "TextBuffer.h"
+#include <string>
+#include <vector>
+
+// The replacement half of :s/pat/rep/, parsed once for every match.
+// & and \0 stand for the match, \r for a line break, \n for a NUL byte,
+// \t for a tab and ~ for the previous replacement; a backslash before
+// anything else keeps that character as it is.
+class Replacement {
+public:
+    // Errors read like Vim's; previous is what ~ expands to
+    bool parse(const std::string& text, const std::string& previous, std::string& error);
+    // The text with ~ expanded, to be the next previous
+    const std::string& source() const;
+    // Appends what the match [start, end) of text is replaced with
+    void expand(const TextSnapshot& text, size_t start, size_t end, std::string& out) const;
+
+private:
+    struct Part {
+        std::string text;
+        bool match; // the matched text rather than text
+    };
+    std::string expanded;
+    std::vector<Part> parts;
+};
+
+struct SubstituteResult {
+    size_t substitutions = 0;
+    size_t lines = 0;
+    int lastLine = -1; // the line the last substitution is on, afterwards
+};
+
+// Replaces the first match on each of the lines first to last, or every
+// match when everyMatch. Matches are found in a snapshot taken before the
+// first edit, and each changed line is rebuilt in one pass into a reused
+// buffer and written back with a single erase and insert; lines without
+// a match are not copied at all.
+SubstituteResult substituteLines(TextBuffer& buffer, const Regex& pattern, const Replacement& replacement,
+                                 int first, int last, bool everyMatch);
+// The same for a sorted list of lines, such as the ones :g marked
+SubstituteResult substituteLines(TextBuffer& buffer, const Regex& pattern, const Replacement& replacement,
+                                 const std::vector<int>& lines, bool everyMatch);
+
+#endif
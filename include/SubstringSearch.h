@@ -0,0 +1,52 @@
+#ifndef SUBSTRINGSEARCH_H
+#define SUBSTRINGSEARCH_H
+
+#include "LexScanner.h"
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+class TextBuffer;
+class TextSnapshot;
+
+// A needle prepared once for any number of searches. Short needles are
+// found by comparing the first and last needle bytes against a block of
+// candidate positions at a time (falling back to memchr for one byte);
+// longer ones, and CPUs without SSE2, use Boyer-Moore-Horspool skip
+// tables in both directions.
+class SubstringSearch {
+public:
+    static constexpr size_t npos = std::string_view::npos;
+    // Needles up to this long go through the block filter; Horspool
+    // overtakes it on longer ones
+    static constexpr size_t MaxFilterLength = 16;
+
+    explicit SubstringSearch(std::string_view needle);
+    // kernel must not be wider than bestScanKernel()
+    SubstringSearch(std::string_view needle, ScanKernel kernel);
+
+    const std::string& needle() const;
+    size_t size() const;
+
+    // First match starting at or after from
+    size_t find(std::string_view text, size_t from = 0) const;
+    // Last match starting at or before from
+    size_t rfind(std::string_view text, size_t from = npos) const;
+
+    // The first match (the last one when backward) starting anywhere in
+    // [first, last], reading the buffer as one stream of bytes so matches
+    // may span lines and pieces
+    size_t find(const TextBuffer& buffer, size_t first, size_t last, bool backward) const;
+    size_t find(const TextSnapshot& snapshot, size_t first, size_t last, bool backward) const;
+
+private:
+    std::string pattern;
+    ScanKernel kernel;
+    bool filter;
+    // Shift for the byte under the window's last (first) byte
+    std::array<uint32_t, 256> skip{};
+    std::array<uint32_t, 256> backSkip{};
+};
+
+#endif
@@ -4,15 +4,20 @@
 #include "Lexer.h"
 #include "Token.h"
 #include <vector>
-#include <string>
-#include <utility>
+#include <string_view>
 
 class SyntaxHighlighter {
 public:
     SyntaxHighlighter();
     ~SyntaxHighlighter();
 
-    std::vector<std::pair<TokenType, std::string>> highlight(const std::string& line);
+    // Null, the default, leaves every line plain
+    void setGrammar(const Grammar* grammar);
+
+    // Highlights a line on its own, as if it started the file
+    void highlight(std::string_view line, std::vector<Token>& tokens);
+    // Highlights the next line of a run, carrying state across lines
+    void highlight(std::string_view line, LexerState& state, std::vector<Token>& tokens);
 
 private:
     Lexer lexer;
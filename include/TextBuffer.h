@@ -0,0 +1,103 @@
+#ifndef TEXTBUFFER_H
+#define TEXTBUFFER_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class MappedFile;
+
+// Told about every edit after it has been applied to the buffer
+class TextBufferListener {
+public:
+    virtual ~TextBufferListener() = default;
+    virtual void onInsert(size_t offset, std::string_view text) = 0;
+    virtual void onErase(size_t offset, std::string_view removed) = 0;
+};
+
+// The contents of a buffer at one moment. It never changes afterwards, so
+// other threads may read it while the buffer keeps being edited.
+class TextSnapshot {
+public:
+    virtual ~TextSnapshot() = default;
+    virtual size_t length() const = 0;
+    virtual void forEachChunk(const std::function<void(const char*, size_t)>& fn) const = 0;
+    // The stored run of bytes holding offset, which starts at chunkStart
+    virtual std::string_view chunkAt(size_t offset, size_t& chunkStart) const = 0;
+
+    // Appends up to count bytes from offset to out
+    void append(size_t offset, size_t count, std::string& out) const;
+    // The '\n' ending the line that holds offset, or length()
+    size_t lineEnd(size_t offset) const;
+};
+
+// Document text addressed either by byte offset or by (line, column).
+// Lines are separated by '\n' and there is always at least one line.
+class TextBuffer {
+public:
+    virtual ~TextBuffer() = default;
+
+    // Storage primitives
+    virtual size_t length() const = 0;
+    virtual int lineCount() const = 0;
+    virtual size_t lineStart(int y) const = 0;
+    // Line holding the byte at offset (the last line for offset == length())
+    virtual int lineAt(size_t offset) const = 0;
+    virtual char byteAt(size_t offset) const = 0;
+    // Replaces out with up to count bytes from offset, reusing its storage
+    virtual void copy(size_t offset, size_t count, std::string& out) const = 0;
+    virtual void forEachChunk(const std::function<void(const char*, size_t)>& fn) const = 0;
+    // The stored run of bytes holding offset, which starts at chunkStart
+    virtual std::string_view chunkAt(size_t offset, size_t& chunkStart) const = 0;
+    // Cheap to take: shares the stored text instead of copying it
+    virtual std::shared_ptr<const TextSnapshot> snapshot() const = 0;
+    // Replaces the contents with the mapped file (empty when null)
+    virtual void reset(std::shared_ptr<const MappedFile> original) = 0;
+    // Bumped on every modification
+    virtual unsigned long version() const = 0;
+    // True while the line structure is still being built in the background;
+    // lineCount() then covers only the lines found so far
+    virtual bool isIndexing() const { return false; }
+    // Blocks until `count` lines are known or indexing is done
+    virtual void waitForLines(int count) { (void)count; }
+
+    // Edits, reported to the listeners
+    void insertAt(size_t offset, std::string_view text);
+    void eraseAt(size_t offset, size_t count);
+    void addListener(TextBufferListener* listener);
+    void removeListener(TextBufferListener* listener);
+
+    // Line oriented helpers built on the primitives
+    std::string substr(size_t offset, size_t count) const;
+    std::string line(int y) const;
+    void line(int y, std::string& out) const;
+    int lineLength(int y) const;
+    // The '\n' ending the line that holds offset, or length()
+    size_t lineEnd(size_t offset) const;
+    char charAt(int y, int x) const;
+    size_t offsetOf(int y, int x) const;
+
+    void insert(int y, int x, std::string_view text);
+    void erase(int y, int x, size_t count);
+    void insertLines(int y, const std::vector<std::string>& lines);
+    void eraseLines(int y, int count);
+    // Erases the sorted lines given, a run of adjacent ones at a time and
+    // from the bottom up, so each run is a single edit
+    void eraseLines(const std::vector<int>& lines);
+    void replaceLine(int y, std::string_view text);
+
+    std::vector<std::string> lines() const;
+    void assign(const std::vector<std::string>& lines);
+
+protected:
+    virtual void insertBytes(size_t offset, std::string_view text) = 0;
+    virtual void eraseBytes(size_t offset, size_t count) = 0;
+
+private:
+    std::vector<TextBufferListener*> listeners;
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Worker threads started once and shared by the searches that split
+// their work. A job is a number of tasks. Each worker starts on its own
+// run of them and, once that is used up, steals the back half of the
+// longest run left, so one huge file among thousands of small ones does
+// not leave the other cores idle.
+class ThreadPool {
+public:
+    // 0 picks one thread per core
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Workers, counting the thread that calls run
+    unsigned size() const;
+    // Calls task(i, worker) for every i below count, the calling thread
+    // working as worker 0, and returns once all of them are done.
+    // worker < size() tells which per-thread state a task may use.
+    void run(size_t count, const std::function<void(size_t, unsigned)>& task);
+
+    // The pool the editor's commands share
+    static ThreadPool& shared();
+
+private:
+    // The tasks [next, end) a worker has left
+    struct Share {
+        std::mutex mutex;
+        size_t next = 0;
+        size_t end = 0;
+    };
+
+    std::vector<std::unique_ptr<Share>> shares;
+    std::vector<std::thread> threads;
+    const std::function<void(size_t, unsigned)>* job; // guarded by mutex
+    unsigned long jobs; // jobs started, guarded by mutex
+    unsigned busy; // helpers still on the current job, guarded by mutex
+    bool stopping;
+    std::mutex runMutex; // one job at a time
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+
+    void helper(unsigned worker);
+    void work(unsigned worker, const std::function<void(size_t, unsigned)>& task);
+    bool take(unsigned worker, size_t& task);
+    bool steal(unsigned worker);
+};
+
+#endif
@@ -2,16 +2,16 @@
 #define TOKEN_H
 
 #include "TokenType.h"
-#include <string>
 
+// A span of the line it was lexed from; the text stays in the buffer
 class Token {
 public:
     TokenType type;
-    std::string text;
     int position; // Starting position in the line
+    int length;
 
-    Token(TokenType type, const std::string& text, int position)
-        : type(type), text(text), position(position) {}
+    Token(TokenType type, int position, int length)
+        : type(type), position(position), length(length) {}
 };
 
 #endif 
@@ -13,6 +13,11 @@ enum class TokenType {
     MismatchedBrace,
     MismatchedBracket,
     MismatchedParenthesis,
+    Type,
+    Constant,
+    Function,
+    Variable,
+    Key,
     PlainText
 };
 
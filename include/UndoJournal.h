@@ -0,0 +1,76 @@
+#ifndef UNDOJOURNAL_H
+#define UNDOJOURNAL_H
+
+#include "TextBuffer.h"
+#include <ctime>
+#include <string>
+#include <vector>
+
+// Replacing `removed` by `inserted` at a byte offset
+struct EditDelta {
+    size_t offset;
+    std::string removed;
+    std::string inserted;
+};
+
+// One state in the undo tree and the edits that lead to it from its parent
+struct UndoRecord {
+    std::vector<EditDelta> deltas;
+    int cursorYBefore;
+    int cursorXBefore;
+    int cursorYAfter;
+    int cursorXAfter;
+    unsigned long seq; // creation order, also the index into the tree
+    std::time_t time;
+    long parent;
+    long depth;
+    long redoChild; // child that redo follows, the last one visited
+    std::vector<long> children;
+};
+
+// Collects the buffer's edits into undo steps kept as a tree, so undoing
+// and then editing starts a new branch instead of discarding the old one.
+// Each step keeps only the text it touched, so memory and the time to move
+// between states follow the size of the edits rather than the file size.
+class UndoJournal : public TextBufferListener {
+public:
+    UndoJournal();
+
+    void onInsert(size_t offset, std::string_view text) override;
+    void onErase(size_t offset, std::string_view removed) override;
+
+    // Remembers where the cursor was before the step now being built
+    void beginStep(int cursorY, int cursorX);
+    // Closes the step being built; does nothing if it made no edits
+    void commit(int cursorY, int cursorX, std::time_t when = std::time(nullptr));
+    bool hasPending() const;
+
+    // Along the current branch
+    bool undo(TextBuffer& textBuffer, int& cursorY, int& cursorX);
+    bool redo(TextBuffer& textBuffer, int& cursorY, int& cursorX);
+
+    // Through every state in the order it was created (g- and g+)
+    bool stepChronological(TextBuffer& textBuffer, long steps, int& cursorY, int& cursorX);
+    // To the newest state created at least `seconds` before (negative) or
+    // after (positive) the current one
+    bool stepTime(TextBuffer& textBuffer, long seconds, int& cursorY, int& cursorX);
+    bool gotoSeq(TextBuffer& textBuffer, unsigned long seq, int& cursorY, int& cursorX);
+
+    // Identifies the current state; equal values mean equal text
+    unsigned long currentSeq() const;
+    unsigned long lastSeq() const;
+    // The tips of all branches, oldest first
+    std::vector<const UndoRecord*> leaves() const;
+    void clear();
+
+private:
+    std::vector<UndoRecord> nodes; // nodes[0] is the state before any edit
+    long current;
+    UndoRecord pending;
+    bool replaying;
+
+    void apply(TextBuffer& textBuffer, const UndoRecord& record, bool forward);
+    UndoRecord root() const;
+};
+
+#endif
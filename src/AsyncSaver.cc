@@ -0,0 +1,92 @@
+#include "AsyncSaver.h"
+#include <algorithm>
+
+AsyncSaver::AsyncSaver(std::shared_ptr<FileManager> fileManager)
+    : fileManager(std::move(fileManager)), currentTotal(0), currentWritten(0), writing(false), stopping(false) {}
+
+AsyncSaver::~AsyncSaver() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (writer.joinable()) {
+        writer.join();
+    }
+}
+
+void AsyncSaver::save(const std::string& filename, std::shared_ptr<const TextSnapshot> snapshot,
+                      unsigned long tag) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // Writing an older snapshot first would be wasted work
+        auto waiting = std::find_if(queue.begin(), queue.end(),
+            [&filename](const Job& job) { return job.filename == filename; });
+        if (waiting != queue.end()) {
+            waiting->snapshot = std::move(snapshot);
+            waiting->tag = tag;
+        } else {
+            queue.push_back({filename, std::move(snapshot), tag});
+        }
+        if (!writer.joinable()) {
+            writer = std::thread(&AsyncSaver::run, this);
+        }
+    }
+    wake.notify_one();
+}
+
+bool AsyncSaver::busy() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return writing || !queue.empty();
+}
+
+void AsyncSaver::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return !writing && queue.empty(); });
+}
+
+std::vector<AsyncSaver::Result> AsyncSaver::takeResults() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Result> finished;
+    finished.swap(results);
+    return finished;
+}
+
+bool AsyncSaver::progress(std::string& filename, size_t& written, size_t& total) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!writing) {
+        return false;
+    }
+    filename = currentFilename;
+    written = currentWritten.load(std::memory_order_relaxed);
+    total = currentTotal;
+    return true;
+}
+
+void AsyncSaver::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (queue.empty()) {
+            return;
+        }
+        Job job = std::move(queue.front());
+        queue.pop_front();
+        writing = true;
+        currentFilename = job.filename;
+        currentTotal = job.snapshot->length() + 1;
+        currentWritten.store(0, std::memory_order_relaxed);
+        lock.unlock();
+
+        bool ok = fileManager->saveFile(job.filename, *job.snapshot, [this](size_t written) {
+            currentWritten.store(written, std::memory_order_relaxed);
+        });
+
+        lock.lock();
+        results.push_back({job.filename, job.tag, ok});
+        writing = false;
+        if (queue.empty()) {
+            idle.notify_all();
+        }
+    }
+}
@@ -0,0 +1,158 @@
+#include "GrammarRegistry.h"
+
+namespace {
+
+// Rules are tried in the order they are listed, so longer delimiters
+// come before the shorter ones they start with
+
+constexpr std::string_view cpp = R"(
+language cpp
+extensions c cc cpp cxx c++ h hh hpp hxx h++ ino
+keyword words alignas alignof and and_eq asm atomic_cancel atomic_commit
+keyword words atomic_noexcept auto bitand bitor bool break case catch char
+keyword words char8_t char16_t char32_t class compl const consteval constexpr
+keyword words constinit const_cast continue co_await co_return co_yield decltype
+keyword words default delete do double dynamic_cast else enum explicit export
+keyword words extern false float for friend goto if inline int long mutable
+keyword words namespace new noexcept not not_eq nullptr operator or or_eq
+keyword words private protected public reflexpr register reinterpret_cast
+keyword words requires return short signed sizeof static static_assert
+keyword words static_cast struct switch synchronized template this
+keyword words thread_local throw true try typedef typeid union unsigned
+keyword words using virtual void volatile wchar_t while xor xor_eq
+comment line //
+comment region /* */ multiline
+string region " " escape \\
+string region ' ' escape \\
+preprocessor line #
+number run 0-9 0-9.xX
+operator pairs == != <= >= ++ -- && || += -= *= /= %= &= |= ^= -> ::
+operator symbols +*/%=<>!&|^~?:.-
+punctuation brackets ()[]{}
+punctuation symbols ;,
+identifier word a-zA-Z_ a-zA-Z0-9_
+)";
+
+constexpr std::string_view python = R"(
+language python
+extensions py pyw pyi
+filenames SConstruct SConscript
+interpreters python python2 python3 pypy pypy3
+keyword words and as assert async await break class continue def del elif
+keyword words else except finally for from global if import in is lambda
+keyword words nonlocal not or pass raise return try while with yield match case
+constant words True False None NotImplemented Ellipsis __name__ __file__
+function words abs all any bin bool bytearray bytes callable chr classmethod
+function words compile complex delattr dict dir divmod enumerate eval exec
+function words filter float format frozenset getattr globals hasattr hash
+function words help hex id input int isinstance issubclass iter len list
+function words locals map max memoryview min next object oct open ord pow
+function words print property range repr reversed round set setattr slice
+function words sorted staticmethod str sum super tuple type vars zip
+type words self cls
+comment line #
+string region """ """ escape \\ multiline
+string region ''' ''' escape \\ multiline
+string region " " escape \\
+string region ' ' escape \\
+function run @ a-zA-Z0-9_.
+number run 0-9 0-9a-fA-FxXoObBjJ_.
+operator pairs ** // == != <= >= << >> += -= *= /= %= &= |= ^= -> := @=
+operator symbols +*/%=<>!&|^~:.@-
+punctuation brackets ()[]{}
+punctuation symbols ;,
+identifier word a-zA-Z_ a-zA-Z0-9_
+)";
+
+constexpr std::string_view shell = R"(
+language shell
+extensions sh bash zsh ksh
+filenames .bashrc .bash_profile .bash_logout .profile .zshrc .zprofile .zshenv
+interpreters sh bash zsh ksh dash ash
+keyword words if then else elif fi case esac for select while until do done
+keyword words in function time coproc return exit break continue local
+keyword words export readonly declare typeset unset shift
+function words echo printf read cd pwd pushd popd source eval exec test
+function words trap wait kill set alias unalias getopts command builtin
+function words type hash true false
+comment line #
+string region " " escape \\ multiline
+string region ' ' multiline
+string region ` ` escape \\ multiline
+variable run $ a-zA-Z0-9_{}#?@*!$-
+operator pairs && || ;; >> << |& &> >& <( >( ==
+operator symbols =<>|&!
+punctuation brackets ()[]{}
+punctuation symbols ;
+number run 0-9 0-9
+identifier word a-zA-Z_ a-zA-Z0-9_-
+)";
+
+constexpr std::string_view json = R"(
+language json
+extensions json jsonc geojson webmanifest
+filenames .babelrc .eslintrc .prettierrc
+key region " " escape \\ before :
+string region " " escape \\
+constant words true false null
+comment line //
+comment region /* */ multiline
+number run -0-9 0-9.eE+-
+punctuation brackets []{}
+punctuation symbols :,
+identifier word a-zA-Z_ a-zA-Z0-9_
+)";
+
+constexpr std::string_view yaml = R"(
+language yaml
+extensions yaml yml
+filenames .clang-format .clang-tidy
+constant words true false null yes no on off True False Null Yes No On Off TRUE FALSE NULL
+comment line #
+preprocessor line --- linestart
+preprocessor line ... linestart
+key region " " escape \\ before :
+key region ' ' before :
+string region " " escape \\
+string region ' '
+key word a-zA-Z0-9_ a-zA-Z0-9_./- before :
+variable run &* a-zA-Z0-9_-
+type run ! a-zA-Z0-9_!:/.-
+number run 0-9 0-9.eE_:+-
+punctuation brackets []{}
+punctuation symbols -:,?|>
+identifier word a-zA-Z_ a-zA-Z0-9_./-
+)";
+
+constexpr std::string_view makefile = R"(
+language makefile
+extensions mk mak make
+filenames Makefile makefile GNUmakefile
+interpreters make
+keyword words ifeq ifneq ifdef ifndef else endif include -include sinclude
+keyword words define endef export unexport override private vpath
+function words .PHONY .SUFFIXES .DEFAULT .PRECIOUS .INTERMEDIATE .SECONDARY
+function words .DELETE_ON_ERROR .ONESHELL .SILENT .NOTPARALLEL
+comment line #
+variable run $ a-zA-Z0-9_@<^?*%(){}./+-
+string region " " escape \\
+string region ' '
+variable word a-zA-Z_ a-zA-Z0-9_ linestart before :=
+variable word a-zA-Z_ a-zA-Z0-9_ linestart before ?=
+variable word a-zA-Z_ a-zA-Z0-9_ linestart before +=
+variable word a-zA-Z_ a-zA-Z0-9_ linestart before !=
+variable word a-zA-Z_ a-zA-Z0-9_ linestart before =
+key word a-zA-Z0-9_.%/$()+- a-zA-Z0-9_.%/$()+- linestart before :
+operator pairs := ?= += != ::
+operator symbols =:|;@
+punctuation brackets ()[]{}
+identifier word a-zA-Z_.- a-zA-Z0-9_.-
+)";
+
+constexpr std::string_view grammars[] = {cpp, python, shell, json, yaml, makefile};
+
+}
+
+std::span<const std::string_view> builtinGrammars() {
+    return grammars;
+}
@@ -1,8 +1,21 @@
 #include "ColonCommands.h"
+#include "LineMarks.h"
+#include "ParallelSearch.h"
+#include "Substitute.h"
+#include <algorithm>
+#include <cctype>
+#include <limits>
 #include <sstream>
 #include <fstream>
 #include <ncurses.h> 
 
+namespace {
+
+// Set while :g runs its command, which must not be another :g
+bool inGlobal = false;
+
+}
+
 ColonCommands::ColonCommands(Editor& editor)
     : editor(editor) {
 }
@@ -19,6 +32,52 @@ void ColonCommands::execute(const std::string& commandStr) {
         return;
     }
 
+    // A line range such as %, 3,$ or '<,'> may lead the command
+    size_t at = 0;
+    int first, last;
+    bool ranged;
+    if (!parseRange(trimmedCommand, at, first, last, ranged)) {
+        ungetch('\n');
+        return;
+    }
+    std::string rest = trimmedCommand.substr(at);
+
+    // :s takes any punctuation as its separator, spaces included
+    if (rest.size() > 1 && rest[0] == 's' && std::ispunct(static_cast<unsigned char>(rest[1]))) {
+        substitute(first, last, rest.substr(1));
+        ungetch('\n');
+        return;
+    }
+    // :g/pat/cmd, :g!/pat/cmd and :v/pat/cmd, over every line by default
+    size_t name = 0;
+    while (name < rest.size() && std::isalpha(static_cast<unsigned char>(rest[name]))) {
+        name++;
+    }
+    std::string word = rest.substr(0, name);
+    if (word == "g" || word == "global" || word == "v" || word == "vglobal") {
+        bool invert = word[0] == 'v';
+        if (!invert && name < rest.size() && rest[name] == '!') {
+            invert = true;
+            name++;
+        }
+        if (name < rest.size() && std::ispunct(static_cast<unsigned char>(rest[name]))) {
+            if (!ranged) {
+                editor.textBuffer->waitForLines(std::numeric_limits<int>::max());
+                first = 0;
+                last = editor.textBuffer->lineCount() - 1;
+            }
+            global(first, last, invert, rest.substr(name));
+            ungetch('\n');
+            return;
+        }
+    }
+    if (ranged && rest.empty() && trimmedCommand != "0" && trimmedCommand != "$") {
+        // :12, :'< and the like go to the line
+        editor.setCursorPosition(std::clamp(last, 0, editor.textBuffer->lineCount() - 1), 0);
+        ungetch('\n');
+        return;
+    }
+
     std::istringstream iss(trimmedCommand);
     std::string command;
     iss >> command;
@@ -27,16 +86,18 @@ void ColonCommands::execute(const std::string& commandStr) {
         std::string filename;
         iss >> filename;
         if (!filename.empty()) {
-            saveFile(filename);
+            editor.saveFile(filename);
         } else {
             if (!editor.getFilename().empty()) {
-                saveFile(editor.getFilename());
+                editor.saveFile(editor.getFilename());
             } else {
                 editor.setStatusMessage("No filename specified. Use :w <filename> to save.", true);
             }
         }
     }
     else if (command == "q") {
+        // A save still being written may be what makes the buffer clean
+        editor.finishSaves();
         if (editor.getIsModified()) { 
             ungetch('\n');
             editor.setStatusMessage("E37: No write since last change (add ! to override)", true);
@@ -51,8 +112,11 @@ void ColonCommands::execute(const std::string& commandStr) {
     else if (command == "wq") {
         // Save and quit
         if (!editor.getFilename().empty()) {
-            saveFile(editor.getFilename());
-            quit();
+            // Only leave once the file is safely on disk
+            editor.saveFile(editor.getFilename());
+            if (editor.finishSaves()) {
+                quit();
+            }
         } else {
             editor.setStatusMessage("No filename specified. Use :w <filename> to save before quitting.", true);
         }
@@ -78,13 +142,42 @@ void ColonCommands::execute(const std::string& commandStr) {
             editor.setStatusMessage("Usage: :r <filename>", true);
         }
     }
-    else if (isNumber(command)) {
-        int lineNumber = 0;
-        for (int i = 0; i < (int)commandStr.size(); i++) {
-            lineNumber = lineNumber * 10 + (commandStr[i] - '0');
+    else if (command == "undolist" || command == "undol") {
+        editor.setStatusMessage(editor.undoList(), false);
+    }
+    else if (command == "earlier" || command == "ea" || command == "later" || command == "lat") {
+        std::string amount;
+        iss >> amount;
+        long count = 0;
+        long unit = 0;
+        if (!parseUndoAmount(amount, count, unit)) {
+            editor.setStatusMessage("E475: Invalid argument: " + amount, true);
+        } else {
+            long sign = (command[0] == 'e') ? -1 : 1;
+            if (unit == 0) {
+                editor.undoChronological(sign * count);
+            } else {
+                editor.undoTime(sign * count * unit);
+            }
         }
-        lineNumber = std::min((int)editor.textBuffer.size(), lineNumber);
-        editor.setCursorPosition(lineNumber - 1, 0);
+    }
+    else if (command == "noh" || command == "nohlsearch") {
+        // Until the next search
+        editor.highlightSearch(false);
+        ungetch('\n');
+    }
+    else if (command == "vimgrep" || command == "vim") {
+        std::string rest;
+        std::getline(iss, rest);
+        vimgrep(rest);
+        ungetch('\n');
+    }
+    else if (command == "cn" || command == "cnext") {
+        editor.stepQuickfix(1);
+        ungetch('\n');
+    }
+    else if (command == "cp" || command == "cprevious" || command == "cN" || command == "cNext") {
+        editor.stepQuickfix(-1);
         ungetch('\n');
     }
     else {
@@ -92,21 +185,349 @@ void ColonCommands::execute(const std::string& commandStr) {
     }
 }
 
-bool ColonCommands::isNumber(const std::string& commandStr) {
-    for (int i = 0; i < (int)commandStr.size(); i++) {
-        if (commandStr[i] < '0' || commandStr[i] > '9') {
+// One line address: a number, . for the cursor line, $ for the last line
+// or a mark such as '<, followed by any +N and -N. Lines count from 0.
+bool ColonCommands::parseAddress(const std::string& text, size_t& at, int& line, bool& given) {
+    TextBuffer& buffer = *editor.textBuffer;
+    given = true;
+    line = editor.cursorY;
+    if (at < text.size() && std::isdigit(static_cast<unsigned char>(text[at]))) {
+        line = readNumber(text, at) - 1;
+    } else if (at < text.size() && text[at] == '.') {
+        at++;
+    } else if (at < text.size() && text[at] == '$') {
+        buffer.waitForLines(std::numeric_limits<int>::max());
+        line = buffer.lineCount() - 1;
+        at++;
+    } else if (at + 1 < text.size() && text[at] == '\'' && (text[at + 1] == '<' || text[at + 1] == '>')) {
+        line = text[at + 1] == '<' ? editor.visualFirstLine : editor.visualLastLine;
+        if (line < 0) {
+            editor.setStatusMessage("E20: Mark not set", true);
+            return false;
+        }
+        at += 2;
+    } else {
+        given = false;
+    }
+    while (at < text.size() && (text[at] == '+' || text[at] == '-')) {
+        int sign = text[at++] == '+' ? 1 : -1;
+        bool digits = at < text.size() && std::isdigit(static_cast<unsigned char>(text[at]));
+        line += sign * (digits ? readNumber(text, at) : 1);
+        given = true;
+    }
+    return true;
+}
+
+// The lines a command works on: % for all of them, or one or two
+// addresses split by a comma. Without a range both are the cursor line.
+bool ColonCommands::parseRange(const std::string& text, size_t& at, int& first, int& last, bool& given) {
+    TextBuffer& buffer = *editor.textBuffer;
+    if (at < text.size() && text[at] == '%') {
+        at++;
+        buffer.waitForLines(std::numeric_limits<int>::max());
+        first = 0;
+        last = buffer.lineCount() - 1;
+        given = true;
+        return true;
+    }
+    if (!parseAddress(text, at, first, given)) {
+        return false;
+    }
+    last = first;
+    if (at < text.size() && text[at] == ',') {
+        at++;
+        bool secondGiven;
+        if (!parseAddress(text, at, last, secondGiven)) {
+            return false;
+        }
+        given = true;
+    }
+    if (first > last) {
+        std::swap(first, last);
+    }
+    return true;
+}
+
+// Digits from at, stopping short of overflow
+int ColonCommands::readNumber(const std::string& text, size_t& at) {
+    long number = 0;
+    while (at < text.size() && std::isdigit(static_cast<unsigned char>(text[at]))) {
+        number = std::min<long>(number * 10 + (text[at++] - '0'), std::numeric_limits<int>::max() / 2);
+    }
+    return static_cast<int>(number);
+}
+
+// "10s", "5m", "2h", "1d" or a plain step count; unit is 0 for steps
+bool ColonCommands::parseUndoAmount(const std::string& amount, long& count, long& unit) {
+    if (amount.empty()) {
+        count = 1;
+        unit = 0;
+        return true;
+    }
+    size_t digits = 0;
+    while (digits < amount.size() && amount[digits] >= '0' && amount[digits] <= '9') {
+        digits++;
+    }
+    if (digits == 0 || digits > 9 || amount.size() - digits > 1) {
+        return false;
+    }
+    count = std::stol(amount.substr(0, digits));
+    switch (digits < amount.size() ? amount[digits] : '\0') {
+        case '\0': unit = 0; break;
+        case 's': unit = 1; break;
+        case 'm': unit = 60; break;
+        case 'h': unit = 60 * 60; break;
+        case 'd': unit = 24 * 60 * 60; break;
+        default: return false;
+    }
+    return true;
+}
+
+// Reads up to the next delimiter not escaped with a backslash, which is
+// taken as a plain delimiter; at ends up past the closing one
+bool ColonCommands::readDelimited(const std::string& text, size_t& at, char delimiter, std::string& out) {
+    out.clear();
+    while (at < text.size() && text[at] != delimiter) {
+        if (text[at] == '\\' && at + 1 < text.size()) {
+            if (text[at + 1] != delimiter) {
+                out += '\\';
+            }
+            at++;
+        }
+        out += text[at++];
+    }
+    if (at == text.size()) {
+        return false;
+    }
+    at++;
+    return true;
+}
+
+// The pattern of :s or :vimgrep, or the last search for an empty one
+bool ColonCommands::searchPattern(const std::string& text, Regex& pattern) {
+    if (text.empty()) {
+        if (editor.searchPattern.empty()) {
+            editor.setStatusMessage("E35: No previous regular expression", true);
             return false;
         }
+        pattern = editor.searchPattern;
+        return true;
+    }
+    std::string error;
+    if (!pattern.compile(text, error)) {
+        editor.setStatusMessage(error, true);
+        return false;
+    }
+    // Like a / search, it becomes the pattern n and hlsearch use
+    editor.searchPattern = pattern;
+    editor.highlightSearch(true);
+    return true;
+}
+
+// :s/pat/rep/flags over lines first to last. The flags are g for every
+// match on a line, n to count the matches instead and e to say nothing
+// when there are none. All the edits make one undo step.
+void ColonCommands::substitute(int first, int last, const std::string& text, const std::vector<int>* marked) {
+    char delimiter = text[0];
+    size_t at = 1;
+    std::string patternText, replacementText;
+    readDelimited(text, at, delimiter, patternText);
+    readDelimited(text, at, delimiter, replacementText);
+    bool everyMatch = false;
+    bool countOnly = false;
+    bool quiet = false;
+    for (; at < text.size(); at++) {
+        switch (text[at]) {
+            case 'g': everyMatch = true; break;
+            case 'n': countOnly = true; break;
+            case 'e': quiet = true; break;
+            default:
+                editor.setStatusMessage("E488: Trailing characters: " + text.substr(at), true);
+                return;
+        }
+    }
+    TextBuffer& buffer = *editor.textBuffer;
+    buffer.waitForLines(last + 1);
+    if (first < 0 || last >= buffer.lineCount()) {
+        editor.setStatusMessage("E16: Invalid range", true);
+        return;
+    }
+    Regex pattern;
+    if (!searchPattern(patternText, pattern)) {
+        return;
+    }
+
+    size_t matches, lines;
+    if (countOnly && marked) {
+        editor.setStatusMessage("E488: Trailing characters: n", true);
+        return;
+    }
+    if (countOnly) {
+        size_t end = buffer.lineStart(last) + buffer.lineLength(last);
+        MatchTally tally = countMatches(pattern, *buffer.snapshot(), buffer.lineStart(first), end,
+                                        everyMatch, ThreadPool::shared());
+        matches = tally.matches;
+        lines = tally.lines;
+    } else {
+        Replacement replacement;
+        std::string error;
+        if (!replacement.parse(replacementText, editor.lastReplacement, error)) {
+            editor.setStatusMessage(error, true);
+            return;
+        }
+        editor.lastReplacement = replacement.source();
+        SubstituteResult result = marked ? substituteLines(buffer, pattern, replacement, *marked, everyMatch)
+                                         : substituteLines(buffer, pattern, replacement, first, last, everyMatch);
+        matches = result.substitutions;
+        lines = result.lines;
+        if (result.lines > 0) {
+            editor.setCursorPosition(result.lastLine, 0);
+        }
+    }
+    if (matches == 0) {
+        if (!quiet) {
+            editor.setStatusMessage("E486: Pattern not found: " + pattern.pattern(), true);
+        }
+        return;
+    }
+    std::string message = std::to_string(matches);
+    if (countOnly) {
+        message += matches == 1 ? " match" : " matches";
+    } else {
+        message += matches == 1 ? " substitution" : " substitutions";
+    }
+    message += " on " + std::to_string(lines) + (lines == 1 ? " line" : " lines");
+    editor.setStatusMessage(message, false);
+}
+
+// :g/pat/cmd over lines first to last, or with invert the lines holding
+// no match. Every line is marked before cmd runs on any of them; cmd is
+// d, s/pat/rep/flags or normal {keys}, and the lot is one undo step.
+void ColonCommands::global(int first, int last, bool invert, const std::string& text) {
+    if (inGlobal) {
+        editor.setStatusMessage("E147: Cannot do :global recursive", true);
+        return;
+    }
+    char delimiter = text[0];
+    size_t at = 1;
+    std::string patternText;
+    readDelimited(text, at, delimiter, patternText);
+    size_t commandStart = std::min(text.find_first_not_of(" \t", at), text.size());
+    std::string command = text.substr(commandStart);
+    std::string keys;
+    bool deleting = command == "d" || command == "delete";
+    bool substituting = command.size() > 1 && command[0] == 's' &&
+                        std::ispunct(static_cast<unsigned char>(command[1]));
+    if (!deleting && !substituting && !normalKeys(command, keys)) {
+        editor.setStatusMessage("E492: Not an editor command: " + (command.empty() ? "p" : command), true);
+        return;
+    }
+
+    TextBuffer& buffer = *editor.textBuffer;
+    buffer.waitForLines(last + 1);
+    if (first < 0 || last >= buffer.lineCount()) {
+        editor.setStatusMessage("E16: Invalid range", true);
+        return;
+    }
+    Regex pattern;
+    if (!searchPattern(patternText, pattern)) {
+        return;
+    }
+    size_t end = buffer.lineStart(last) + buffer.lineLength(last);
+    std::vector<int> lines = markLines(pattern, *buffer.snapshot(), buffer.lineStart(first), end, first, invert,
+                                       ThreadPool::shared());
+    if (lines.empty()) {
+        editor.setStatusMessage((invert ? "Pattern found in every line: " : "Pattern not found: ") +
+                                pattern.pattern(), false);
+        return;
+    }
+
+    inGlobal = true;
+    if (deleting) {
+        editor.setClipboard(std::vector<std::string>{buffer.line(lines.back())});
+        buffer.eraseLines(lines);
+        editor.setCursorPosition(std::min(lines.back() + 1 - static_cast<int>(lines.size()),
+                                          buffer.lineCount() - 1), 0);
+        editor.setStatusMessage(lines.size() == 1 ? "1 line less" : std::to_string(lines.size()) + " fewer lines",
+                                false);
+    } else if (substituting) {
+        substitute(first, last, command.substr(1), &lines);
+    } else {
+        // Marks follow their lines as the keys add and delete lines
+        LineMarks marks(buffer, std::move(lines));
+        buffer.addListener(&marks);
+        for (int y; marks.next(y);) {
+            editor.setCursorPosition(y, 0);
+            editor.runKeys(keys);
+        }
+        buffer.removeListener(&marks);
     }
+    inGlobal = false;
+}
+
+// The keys of normal {keys}, which may be shortened to norm
+bool ColonCommands::normalKeys(const std::string& command, std::string& keys) {
+    size_t nameEnd = std::min(command.find_first_of(" \t!"), command.size());
+    if (nameEnd < 4 || std::string("normal").compare(0, nameEnd, command, 0, nameEnd) != 0) {
+        return false;
+    }
+    size_t start = command.find_first_not_of(" \t", nameEnd < command.size() && command[nameEnd] == '!' ?
+                                                         nameEnd + 1 : nameEnd);
+    keys = start == std::string::npos ? "" : command.substr(start);
     return true;
 }
 
-void ColonCommands::saveFile(const std::string& filename) {
-    if (editor.saveFile(filename)) {
-        editor.setStatusMessage("File saved: " + filename, false); 
+// :vimgrep /pat/[g][j] file... where a file may be a glob such as **/*.cc
+void ColonCommands::vimgrep(const std::string& args) {
+    size_t at = args.find_first_not_of(" \t");
+    if (at == std::string::npos) {
+        editor.setStatusMessage("E683: File name missing or invalid pattern", true);
+        return;
+    }
+    std::string patternText;
+    if (std::ispunct(static_cast<unsigned char>(args[at]))) {
+        char delimiter = args[at++];
+        if (!readDelimited(args, at, delimiter, patternText)) {
+            editor.setStatusMessage("E683: File name missing or invalid pattern", true);
+            return;
+        }
     } else {
-        editor.setStatusMessage("Error saving file: " + filename, true); 
+        size_t space = std::min(args.find_first_of(" \t", at), args.size());
+        patternText = args.substr(at, space - at);
+        at = space;
+    }
+    bool everyMatch = false;
+    bool jump = true;
+    for (; at < args.size() && (args[at] == 'g' || args[at] == 'j'); at++) {
+        (args[at] == 'g' ? everyMatch : jump) = args[at] == 'g';
+    }
+
+    std::istringstream names(args.substr(at));
+    std::vector<std::string> globs;
+    for (std::string name; names >> name;) {
+        globs.push_back(name);
+    }
+    if (globs.empty()) {
+        editor.setStatusMessage("E683: File name missing or invalid pattern", true);
+        return;
+    }
+    Regex pattern;
+    if (!searchPattern(patternText, pattern)) {
+        return;
+    }
+    std::vector<std::string> files;
+    std::string error;
+    if (!expandGlobs(globs, files, error)) {
+        editor.setStatusMessage(error, true);
+        return;
+    }
+    std::vector<GrepHit> hits;
+    grepFiles(pattern, files, everyMatch, ThreadPool::shared(), hits);
+    if (hits.empty()) {
+        editor.setStatusMessage("E480: No match: " + pattern.pattern(), true);
+        return;
     }
+    editor.setQuickfix(std::move(hits), jump);
 }
 
 void ColonCommands::quit() {
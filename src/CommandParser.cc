@@ -29,10 +29,10 @@ std::shared_ptr<ICommand> CommandParser::parseInput(int ch) {
         int numOfTimes = -1;
         if (ch > '0' && ch <= '9') {
             numOfTimes = ch - '0';
-            ch = getch();
+            ch = editor.readKey();
             while (ch >= '0' && ch <= '9') {
                 numOfTimes = numOfTimes * 10 + (ch - '0');
-                ch = getch();
+                ch = editor.readKey();
             }
         }
         if (numOfTimes > 0) {
@@ -90,13 +90,13 @@ std::shared_ptr<ICommand> CommandParser::parseInput(int ch) {
             }
             // Paste Command
             case 'p': {
-                for (int cnt = 0; cnt < editor.lastMult; cnt++) paste(true);
+                paste(true, editor.lastMult);
                 editor.savedCommandSeq = editor.commandSeq;
                 editor.commandSeq = "";
                 break;
             }
             case 'P': {
-                for (int cnt = 0; cnt < editor.lastMult; cnt++) paste(false);
+                paste(false, editor.lastMult);
                 editor.savedCommandSeq = editor.commandSeq;
                 editor.commandSeq = "";
                 break;
@@ -110,17 +110,26 @@ std::shared_ptr<ICommand> CommandParser::parseInput(int ch) {
             }
             // Delete Command
             case 'r': {
-                char c = getch();
+                char c = editor.readKey();
                 r(c, editor.lastMult);
                 editor.savedCommandSeq = editor.commandSeq;
                 editor.commandSeq = "";
                 break;
             }
+            // Undo Command (g- and g+ walk the undo tree in time order)
+            case 'g': {
+                char c = editor.readKey();
+                if (c == '-') {
+                    editor.undoChronological(-editor.lastMult);
+                } else if (c == '+') {
+                    editor.undoChronological(editor.lastMult);
+                }
+                break;
+            }
             // Delete Command (might need to pass in the number of times to execute the command)
             case 'x': {
                 editor.lastCommand = "x";
-                int charsRemaining = (int)editor.textBuffer[editor.cursorY].size() - editor.cursorX - 1;
-                callDeleteCommand(editor, false, ch, std::ranges::min(charsRemaining, numOfTimes));
+                callDeleteCommand(editor, false, ch, numOfTimes);
                 editor.savedCommandSeq = editor.commandSeq;
                 editor.commandSeq = "";
                 break;
@@ -136,9 +145,9 @@ std::shared_ptr<ICommand> CommandParser::parseInput(int ch) {
             // Delete Command
             case 's': {
                 editor.clipboardContent.clear();
-                std::string deletedString = "", currentLine = editor.textBuffer[editor.cursorY];
+                std::string deletedString = "", currentLine = editor.textBuffer->line(editor.cursorY);
                 for (int cnt = 0; cnt < editor.lastMult && editor.cursorX + cnt < (int)currentLine.size(); cnt++) {
-                    deletedString += editor.textBuffer[editor.cursorY][editor.cursorX + cnt];
+                    deletedString += currentLine[editor.cursorX + cnt];
                 }
                 editor.clipboardContent.push_back(deletedString);
                 callDeleteCommand(editor, false, ch, editor.lastMult);
@@ -172,7 +181,7 @@ std::shared_ptr<ICommand> CommandParser::parseInput(int ch) {
             }
             // Search Command
             case 'f': { 
-                char c = getch();
+                char c = editor.readKey();
                 repeatChar = c;
                 upper = 0;
                 findCharOnLine(true, c);
@@ -180,7 +189,7 @@ std::shared_ptr<ICommand> CommandParser::parseInput(int ch) {
             }
             // Search Command
             case 'F': { 
-                char c = getch();
+                char c = editor.readKey();
                 repeatChar = c;
                 upper = 1;
                 findCharOnLine(false, c);
@@ -242,15 +251,26 @@ std::shared_ptr<ICommand> CommandParser::parseInput(int ch) {
                 editor.commandSeq = "";
                 break;
             }
-            // Undo Command (might have to handle all the undo stuff in a separate class)
+            // Undo Command
             case 'u': {
-                if (!editor.fileHistory.empty()) {
-                    auto prev = editor.fileHistory.top();
-                    editor.textBuffer = prev.first;
-                    editor.setCursorPosition(prev.second.first, prev.second.second);
-                    editor.fileHistory.pop();
-                    editor.render();
+                editor.undo();
+                break;
+            }
+            // Macro Commands
+            case 'q': {
+                if (editor.macros.recording()) {
+                    editor.macros.stop();
+                } else if (editor.macros.start(editor.readKey())) {
+                    editor.setStatusMessage("");
+                } else {
+                    beep();
                 }
+                editor.commandSeq = "";
+                break;
+            }
+            case '@': {
+                editor.playMacro(editor.readKey(), editor.lastMult);
+                editor.commandSeq = "";
                 break;
             }
             case '.': {
@@ -330,19 +350,17 @@ std::shared_ptr<ICommand> CommandParser::parseInput(int ch) {
         else if (ch == ('v' & 0x1F)) {
             editor.enterVisualModeBlock();
         }
+        // Redo Command
+        else if (ch == ('r' & 0x1F)) {
+            editor.redo();
+        }
 
         if (fun) {
             for (int cnt = 0; cnt < editor.lastMult; cnt++) {
                 (this->*fun)();
             }
         }
-        if (ch != 'u' && editor.fileHistory.empty()) {
-            editor.fileHistory.push({editor.textBuffer, {editor.cursorY, editor.cursorX}});
-        }   
-        else if (ch != 'u' && !editor.fileHistory.empty() && editor.textBuffer != editor.fileHistory.top().first) {
-            editor.fileHistory.push({editor.textBuffer, {editor.cursorY, editor.cursorX}});
-        }
-        else if (ch == 27) {
+        if (ch == 27) {
             editor.commandSeq = "";
         }
     } else if (mode == Mode::Insert) {
@@ -353,10 +371,11 @@ std::shared_ptr<ICommand> CommandParser::parseInput(int ch) {
             if (!editor.replaying)
                 editor.recordLastChangeKeys(editor.commandSeq);
             editor.commandSeq = "";
-            editor.switchMode(Mode::Command);
-            editor.moveCursor(0, -1);
+            // The counted copies go where the typing stopped
             if (editor.lastCommand != "s" && editor.lastCommand != "S")
                 editor.handleInsertToCommand();
+            editor.switchMode(Mode::Command);
+            editor.moveCursor(0, -1);
         } 
         else if (isprint(ch)) {
             // Create an InsertCommand
@@ -408,6 +427,10 @@ std::shared_ptr<ICommand> CommandParser::parseInput(int ch) {
             editor.enterVisualModeLine();
         } else if (ch == 22) {
             editor.enterVisualModeBlock();
+        } else if (ch == ':') {
+            // Commands from here work on the selected lines
+            editor.exitVisualMode();
+            colonCommand("'<,'>");
         }
     }
     return nullptr;
@@ -421,29 +444,26 @@ void CommandParser::a() {
 
 void CommandParser::A() {
     editor.switchMode(Mode::Insert);
-    const std::string& currentLine = editor.textBuffer[editor.cursorY];
+    std::string currentLine = editor.textBuffer->line(editor.cursorY);
     editor.setCursorPosition(editor.cursorY, currentLine.size());
 }
 
 void CommandParser::cc(int numOfTimes) {
-    int linesLeft = (int)editor.textBuffer.size() - editor.cursorY;
-    for (int cnt = 0; cnt < std::ranges::min(linesLeft, numOfTimes * editor.lastMult); cnt++) {
-        dd();
-    }
+    dd(numOfTimes * editor.lastMult);
     editor.insertCharacter('\n');
     editor.moveCursor(-1, 0);
     editor.lastCommand = "line";
 }
 
 void CommandParser::cMotion() {
-    char ch = getch();
+    char ch = editor.readKey();
     int numOfTimes = 1;
     if (ch > '0' && ch <= '9') {
         numOfTimes = ch - '0';
-        ch = getch();
+        ch = editor.readKey();
         while (ch >= '0' && ch <= '9') {
             numOfTimes = numOfTimes * 10 + (ch - '0');
-            ch = getch();
+            ch = editor.readKey();
         }
     }
     editor.commandSeq += std::to_string(numOfTimes);
@@ -454,9 +474,7 @@ void CommandParser::cMotion() {
         callDeleteCommand(editor, true, 8, editor.cursorX);
     }
     else if (ch == '$') {
-        for (int cnt = 0; cnt < numOfTimes * editor.lastMult; cnt++) {
-            dd();
-        }
+        dd(numOfTimes * editor.lastMult);
         if (numOfTimes * editor.lastMult > 1) {
             editor.lastCommand = "line";
         }
@@ -464,20 +482,18 @@ void CommandParser::cMotion() {
     else if (ch == 'k') {
         int curY = editor.cursorY;
         int n = std::ranges::min(curY, numOfTimes * editor.lastMult);
-        for (int cnt = 0; cnt < n; cnt++) {
-            dd();
-            editor.cursorY--;
-        }
+        // Lines curY - n + 1 to curY, leaving the cursor above them
+        editor.cursorY = curY - n + 1;
+        dd(n);
+        editor.cursorY = curY - n;
         if (n >= 1) {
             editor.lastCommand = "line";
         }
     }
     else if (ch == 'j') {
-        int linesLeft = (int)editor.textBuffer.size() - editor.cursorY;
+        int linesLeft = editor.textBuffer->lineCount() - editor.cursorY;
         int n = std::ranges::min(linesLeft, numOfTimes * editor.lastMult);
-        for (int cnt = 0; cnt < n; cnt++) {
-            dd();
-        }
+        dd(n);
         if (n >= 1) {
             editor.lastCommand = "line";
         }
@@ -487,7 +503,7 @@ void CommandParser::cMotion() {
         editor.lastCommand = "inline";
     }
     else if (ch == 'l') {
-        std::string currentLine = editor.textBuffer[editor.cursorY];
+        std::string currentLine = editor.textBuffer->line(editor.cursorY);
         callDeleteCommand(editor, false, 127, std::ranges::min((int)currentLine.size() - editor.cursorX, numOfTimes * editor.lastMult));
         editor.lastCommand = "inline";
     }
@@ -504,7 +520,7 @@ void CommandParser::cMotion() {
     } 
     else if (ch == 'f') {
         int curX = editor.cursorX, curY = editor.cursorY;
-        char c = getch();
+        char c = editor.readKey();
         repeatChar = c;
         upper = 0;
         findCharOnLine(true, c);
@@ -513,7 +529,7 @@ void CommandParser::cMotion() {
     }
     else if (ch == 'F') {
         int curX = editor.cursorX, curY = editor.cursorY;
-        char c = getch();
+        char c = editor.readKey();
         repeatChar = c;
         upper = 1;
         findCharOnLine(false, c);
@@ -526,24 +542,33 @@ void CommandParser::cMotion() {
     editor.switchMode(Mode::Insert);
 }
 
-void CommandParser::dd() {
+void CommandParser::dd(int count) {
+    count = std::ranges::min(count, editor.textBuffer->lineCount() - editor.cursorY);
+    if (count <= 0) {
+        return;
+    }
     editor.lastCommand = "dd";
     editor.clipboardContent.clear();
 
-    std::string deletedLine = editor.textBuffer[editor.cursorY];
-    editor.setClipboard(std::vector<std::string>{deletedLine});
-
-    editor.textBuffer.erase(editor.textBuffer.begin() + editor.cursorY);
-    if (editor.textBuffer.empty()) {
-        editor.textBuffer.emplace_back("");
+    // The whole count goes to the clipboard and out of the buffer at once
+    std::vector<std::string> deletedLines(count);
+    for (int cnt = 0; cnt < count; cnt++) {
+        editor.textBuffer->line(editor.cursorY + cnt, deletedLines[cnt]);
     }
+    editor.setClipboard(deletedLines);
+
+    editor.textBuffer->eraseLines(editor.cursorY, count);
 
-    if (editor.cursorY >= static_cast<int>(editor.textBuffer.size())) {
-        editor.cursorY = editor.textBuffer.size() - 1;
+    if (editor.cursorY >= editor.textBuffer->lineCount()) {
+        editor.cursorY = editor.textBuffer->lineCount() - 1;
     }
     editor.cursorX = 0;
 
-    editor.setStatusMessage("Deleted line.", false);
+    if (count == 1) {
+        editor.setStatusMessage("Deleted line.", false);
+    } else {
+        editor.setStatusMessage(std::to_string(count) + " fewer lines", false);
+    }
 }
 
 void CommandParser::deleteWord() {
@@ -551,8 +576,8 @@ void CommandParser::deleteWord() {
 }
 
 void CommandParser::deleteRange(int startY, int startX, int endY, int endX) {
-    int startLineLen = (int)editor.textBuffer[startY].size();
-    int endLineLen = (int)editor.textBuffer[endY].size();
+    int startLineLen = editor.textBuffer->lineLength(startY);
+    int endLineLen = editor.textBuffer->lineLength(endY);
     if (startX < 0) startX = 0;
     if (startX > startLineLen) startX = startLineLen;
     if (endX < 0) endX = 0;
@@ -563,38 +588,19 @@ void CommandParser::deleteRange(int startY, int startX, int endY, int endX) {
         std::swap(startX, endX);
     }
 
-    if (startY == endY) {
-        std::string &line = editor.textBuffer[startY];
-        if (endX >= startX && startX < (int)line.size()) {
-            line.erase(startX, (endX - startX));
-        }
-    } else {
-        std::string &startLine = editor.textBuffer[startY];
-        std::string &endLine = editor.textBuffer[endY];
-
-        if (startX < (int)startLine.size()) {
-            startLine.erase(startX);
-        }
-
-        if (endX >= 0 && endX < (int)endLine.size()) {
-            endLine.erase(0, endX);
-        }
-
-        if (endY - startY > 1) {
-            editor.textBuffer.erase(editor.textBuffer.begin() + startY + 1, editor.textBuffer.begin() + endY);
-        }
-
-        editor.textBuffer[startY] += endLine;
-        if (endY > startY) {
-            editor.textBuffer.erase(editor.textBuffer.begin() + startY + 1);
-        }
+    // Both ends are clamped to their lines, so this is a single erase that
+    // also joins the start and end lines when they differ
+    size_t from = editor.textBuffer->offsetOf(startY, startX);
+    size_t to = editor.textBuffer->offsetOf(endY, endX);
+    if (to > from) {
+        editor.textBuffer->eraseAt(from, to - from);
     }
 
-    if (startY >= (int)editor.textBuffer.size()) {
-        startY = (int)editor.textBuffer.size() - 1;
+    if (startY >= editor.textBuffer->lineCount()) {
+        startY = editor.textBuffer->lineCount() - 1;
     }
     if (startY < 0) startY = 0;
-    int newLineLen = (int)editor.textBuffer[startY].size();
+    int newLineLen = editor.textBuffer->lineLength(startY);
     if (startX > newLineLen) startX = newLineLen;
 
     editor.setCursorPosition(startY, startX);
@@ -602,14 +608,14 @@ void CommandParser::deleteRange(int startY, int startX, int endY, int endX) {
 
 
 void CommandParser::dMotion() {
-    char ch = getch();
+    char ch = editor.readKey();
     int numOfTimes = 1;
     if (ch > '0' && ch <= '9') {
         numOfTimes = ch - '0';
-        ch = getch();
+        ch = editor.readKey();
         while (ch >= '0' && ch <= '9') {
             numOfTimes = numOfTimes * 10 + (ch - '0');
-            ch = getch();
+            ch = editor.readKey();
         }
     }
     editor.commandSeq += std::to_string(numOfTimes);
@@ -620,10 +626,8 @@ void CommandParser::dMotion() {
         callDeleteCommand(editor, true, 8, editor.cursorX);
     }
     else if (ch == '$') {
-        callDeleteCommand(editor, false, 127, editor.textBuffer[editor.cursorY].size() - editor.cursorX);
-        for (int cnt = 0; cnt < numOfTimes * editor.lastMult - 1; cnt++) {
-            dd();
-        }
+        callDeleteCommand(editor, false, 127, editor.textBuffer->lineLength(editor.cursorY) - editor.cursorX);
+        dd(numOfTimes * editor.lastMult - 1);
         if (numOfTimes * editor.lastMult > 1) {
             editor.lastCommand = "line";
         }
@@ -631,20 +635,18 @@ void CommandParser::dMotion() {
     else if (ch == 'k') {
         int curY = editor.cursorY;
         int n = std::ranges::min(curY, numOfTimes * editor.lastMult + 1);
-        for (int cnt = 0; cnt < n; cnt++) {
-            dd();
-            editor.cursorY--;
-        }
+        // Lines curY - n + 1 to curY, leaving the cursor above them
+        editor.cursorY = curY - n + 1;
+        dd(n);
+        editor.cursorY = curY - n;
         if (n >= 1) {
             editor.lastCommand = "line";
         }
     }
     else if (ch == 'j') {
-        int linesLeft = (int)editor.textBuffer.size() - editor.cursorY;
+        int linesLeft = editor.textBuffer->lineCount() - editor.cursorY;
         int n = std::ranges::min(linesLeft, numOfTimes * editor.lastMult + 1);
-        for (int cnt = 0; cnt < n; cnt++) {
-            dd();
-        }
+        dd(n);
         if (n >= 1) {
             editor.lastCommand = "line";
         }
@@ -654,15 +656,12 @@ void CommandParser::dMotion() {
         editor.lastCommand = "inline";
     }
     else if (ch == 'l') {
-        std::string currentLine = editor.textBuffer[editor.cursorY];
+        std::string currentLine = editor.textBuffer->line(editor.cursorY);
         callDeleteCommand(editor, false, 127, std::ranges::min((int)currentLine.size() - editor.cursorX, numOfTimes * editor.lastMult));
         editor.lastCommand = "inline";
     }
     else if (ch == 'd') {
-        int linesLeft = (int)editor.textBuffer.size() - editor.cursorY;
-        for (int cnt = 0; cnt < std::ranges::min(linesLeft, numOfTimes * editor.lastMult); cnt++) {
-            dd();
-        }
+        dd(numOfTimes * editor.lastMult);
         editor.lastCommand = "line";
     }
     else if (ch == 'w' || ch == 'b' || ch == '%') {
@@ -675,7 +674,7 @@ void CommandParser::dMotion() {
     }
     else if (ch == 'f') {
         int curX = editor.cursorX, curY = editor.cursorY;
-        char c = getch();
+        char c = editor.readKey();
         repeatChar = c;
         upper = 0;
         findCharOnLine(true, c);
@@ -683,7 +682,7 @@ void CommandParser::dMotion() {
     }
     else if (ch == 'F') {
         int curX = editor.cursorX, curY = editor.cursorY;
-        char c = getch();
+        char c = editor.readKey();
         repeatChar = c;
         upper = 1;
         findCharOnLine(false, c);
@@ -705,7 +704,7 @@ void CommandParser::findCharOnLine(bool lower, char c, int mult) {
         editor.backupMult = editor.lastMult;
     }
     for (int cnt = 0; cnt < multiplier; cnt++) {
-        const std::string& currentLine = lower ? editor.textBuffer[editor.cursorY] : editor.textBuffer[editor.cursorY].substr(0, editor.cursorX);
+        const std::string currentLine = lower ? editor.textBuffer->line(editor.cursorY) : editor.textBuffer->line(editor.cursorY).substr(0, editor.cursorX);
         size_t pos = lower ? currentLine.find(c, editor.cursorX + 1) : currentLine.rfind(c);
 
         if (pos != std::string::npos) {
@@ -728,7 +727,7 @@ void CommandParser::i() {
 }
 
 void CommandParser::I() {
-    const std::string& currentLine = editor.textBuffer[editor.cursorY];
+    std::string currentLine = editor.textBuffer->line(editor.cursorY);
     size_t pos = currentLine.find_first_not_of(" \t");
     
     if (pos != std::string::npos) {
@@ -744,12 +743,12 @@ void CommandParser::I() {
 }
 
 void CommandParser::J() {
-    if (editor.cursorY + 1 >= (int)editor.textBuffer.size()) {
+    if (editor.cursorY + 1 >= editor.textBuffer->lineCount()) {
         beep();
         return;
     }
-    std::string currentLine = editor.textBuffer[editor.cursorY];
-    std::string nextLine = editor.textBuffer[editor.cursorY + 1];
+    std::string currentLine = editor.textBuffer->line(editor.cursorY);
+    std::string nextLine = editor.textBuffer->line(editor.cursorY + 1);
 
     size_t start = nextLine.find_first_not_of(" \t");
     if (start != std::string::npos)
@@ -768,8 +767,8 @@ void CommandParser::J() {
     } else {
         currentLine += nextLine;
     }
-    editor.textBuffer[editor.cursorY] = currentLine;
-    editor.textBuffer.erase(editor.textBuffer.begin() + editor.cursorY + 1);
+    editor.textBuffer->eraseLines(editor.cursorY + 1, 1);
+    editor.textBuffer->replaceLine(editor.cursorY, currentLine);
 
     editor.setCursorPosition(editor.cursorY, newCursorX);
     editor.preferredCursorX = newCursorX;
@@ -783,7 +782,7 @@ void CommandParser::openLine(bool lower) {
         insertPosition++;
     }
     editor.input.push_back('\n');
-    editor.textBuffer.insert(editor.textBuffer.begin() + insertPosition, "");
+    editor.textBuffer->insertLines(insertPosition, {""});
     if (lower) {
         editor.cursorY++;
     }
@@ -791,7 +790,7 @@ void CommandParser::openLine(bool lower) {
     editor.switchMode(Mode::Insert);
 }
 
-void CommandParser::paste(bool lower) {
+void CommandParser::paste(bool lower, int count) {
     if (editor.clipboardContent.empty()) {
         editor.setStatusMessage("Clipboard is empty. Nothing to paste.", true);
         beep();
@@ -802,26 +801,32 @@ void CommandParser::paste(bool lower) {
         insertPosition++;
     }
 
-    editor.fileHistory.push({editor.textBuffer, {editor.cursorY, editor.cursorX}});
-    editor.textBuffer.insert(editor.textBuffer.begin() + insertPosition, editor.clipboardContent.begin(), editor.clipboardContent.end());
+    // Counted pastes go in as one block of count copies
+    std::vector<std::string> pasted;
+    pasted.reserve(editor.clipboardContent.size() * count);
+    for (int cnt = 0; cnt < count; cnt++) {
+        pasted.insert(pasted.end(), editor.clipboardContent.begin(), editor.clipboardContent.end());
+    }
+    editor.textBuffer->insertLines(insertPosition, pasted);
 
     if (lower) {
-        editor.cursorY += editor.clipboardContent.size();
+        editor.cursorY += pasted.size();
     }
     editor.setCursorPosition(editor.cursorY, 0); 
 
 }
 
 void CommandParser::r(char c, int numOfTimes) {
-    if (editor.cursorX + numOfTimes > static_cast<int>(editor.textBuffer[editor.cursorY].size())) {
+    if (editor.cursorX + numOfTimes > editor.textBuffer->lineLength(editor.cursorY)) {
         beep();
         return;
     }
-    for (int cnt = 0; cnt < numOfTimes; cnt++) {
-        editor.deleteCharacter(false);
-        editor.insertCharacter(c);
-    }
-    editor.cursorX -= 1;
+    // One erase and one insert however long the run
+    int x = editor.cursorX;
+    editor.textBuffer->erase(editor.cursorY, x, numOfTimes);
+    editor.textBuffer->insert(editor.cursorY, x, std::string(numOfTimes, c));
+    editor.input.insert(editor.input.end(), numOfTimes, c);
+    editor.cursorX = x + numOfTimes - 1;
 }
 
 void CommandParser::R() {
@@ -829,9 +834,9 @@ void CommandParser::R() {
     editor.switchMode(Mode::Replace);
     editor.render();
     editor.input.clear();
-    char c = getch();
+    char c = editor.readKey();
     while (c != 27) {
-        if (editor.cursorX < static_cast<int>(editor.textBuffer[editor.cursorY].size())) {
+        if (editor.cursorX < editor.textBuffer->lineLength(editor.cursorY)) {
             r(c, 1);
             editor.cursorX += 1;
         }
@@ -839,7 +844,7 @@ void CommandParser::R() {
             editor.insertCharacter(c);
         }
         editor.render();
-        c = getch();
+        c = editor.readKey();
     }
     editor.handleInsertToCommand();
     editor.switchMode(Mode::Command);
@@ -848,7 +853,7 @@ void CommandParser::R() {
 void CommandParser::copyCharacters(Editor &editor, char ch, int count) {
     int y = editor.getCursorY();
     int x = editor.getCursorX();
-    std::string &line = editor.textBuffer[y];
+    std::string line = editor.textBuffer->line(y);
 
     int length;
     if (ch == 'h') { 
@@ -871,7 +876,7 @@ void CommandParser::copyWord(int multiplier, int direction) {
     // direction: +1 for forward (yw), -1 for backward (yb)
     // multiplier: number of words to yank
 
-    std::string &line = editor.textBuffer[editor.cursorY];
+    std::string line = editor.textBuffer->line(editor.cursorY);
     std::string yankedData;
 
     int originalY = editor.cursorY;
@@ -934,13 +939,13 @@ void CommandParser::copyLines(Editor &editor, int count) {
     // dd but just copy lines into clipboard without removing
     int startY = editor.getCursorY();
     int endY = startY + (count - 1);
-    if (endY >= (int)editor.textBuffer.size()) {
-        endY = (int)editor.textBuffer.size() - 1;
+    if (endY >= editor.textBuffer->lineCount()) {
+        endY = editor.textBuffer->lineCount() - 1;
     }
 
     std::vector<std::string> copiedLines;
     for (int y = startY; y <= endY; y++) {
-        copiedLines.push_back(editor.textBuffer[y]);
+        copiedLines.push_back(editor.textBuffer->line(y));
     }
     editor.setClipboard(copiedLines);
     editor.setStatusMessage("Yanked " + std::to_string(copiedLines.size()) + " line(s).", false);
@@ -948,14 +953,14 @@ void CommandParser::copyLines(Editor &editor, int count) {
 
 
 void CommandParser::yMotion() {
-    char ch = getch();
+    char ch = editor.readKey();
     int numOfTimes = 1;
     if (ch > '0' && ch <= '9') {
         numOfTimes = ch - '0';
-        ch = getch();
+        ch = editor.readKey();
         while (ch >= '0' && ch <= '9') {
             numOfTimes = numOfTimes * 10 + (ch - '0');
-            ch = getch();
+            ch = editor.readKey();
         }
     }
 
@@ -965,7 +970,7 @@ void CommandParser::yMotion() {
     if (ch == '0') {
         int y = editor.getCursorY();
         int x = editor.getCursorX();
-        std::string &line = editor.textBuffer[y];
+        std::string line = editor.textBuffer->line(y);
         // This would copy from start of line (0) to x
         std::string extracted = line.substr(0, x);
         editor.setClipboard(std::vector<std::string>{extracted});
@@ -976,32 +981,32 @@ void CommandParser::yMotion() {
         int startX = editor.getCursorX();
         int multiplier = editor.lastMult * numOfTimes;
         int endY = startY + (multiplier - 1);
-        if (endY >= (int)editor.textBuffer.size()) {
-            endY = (int)editor.textBuffer.size() - 1;
+        if (endY >= editor.textBuffer->lineCount()) {
+            endY = editor.textBuffer->lineCount() - 1;
         }
 
         std::vector<std::string> copiedLines;
 
         // If just y$, multiplier=1, copy from cursorX to end of current line
         if (multiplier == 1) {
-            std::string &line = editor.textBuffer[startY];
+            std::string line = editor.textBuffer->line(startY);
             std::string extracted = (startX < (int)line.size()) ? line.substr(startX) : "";
             copiedLines.push_back(extracted);
             editor.lastCommand = "inline";
         } else {
             // For multiple lines
             // First line: from cursorX to end
-            std::string firstLinePart = editor.textBuffer[startY].substr(startX);
+            std::string firstLinePart = editor.textBuffer->line(startY).substr(startX);
             copiedLines.push_back(firstLinePart);
 
             // Intermediate lines: copy them entirely
             for (int l = startY + 1; l < endY; l++) {
-                copiedLines.push_back(editor.textBuffer[l]);
+                copiedLines.push_back(editor.textBuffer->line(l));
             }
 
             // Last line (endY > startY): copy entire line up to endX (which is line length)
             if (endY > startY) {
-                copiedLines.push_back(editor.textBuffer[endY]);
+                copiedLines.push_back(editor.textBuffer->line(endY));
             }
             editor.lastCommand = "line";
         }
@@ -1016,7 +1021,7 @@ void CommandParser::yMotion() {
         editor.lastCommand = "line";
     }
     else if (ch == 'j') {
-        int linesLeft = (int)editor.textBuffer.size() - editor.cursorY;
+        int linesLeft = editor.textBuffer->lineCount() - editor.cursorY;
         int linesToCopy = std::min(linesLeft, numOfTimes * editor.lastMult);
         copyLines(editor, linesToCopy);
         editor.lastCommand = "line";
@@ -1028,14 +1033,14 @@ void CommandParser::yMotion() {
         editor.lastCommand = "inline";
     }
     else if (ch == 'l') {
-        std::string currentLine = editor.textBuffer[editor.cursorY];
+        std::string currentLine = editor.textBuffer->line(editor.cursorY);
         int available = (int)currentLine.size() - editor.cursorX;
         int toCopy = std::min(available, numOfTimes * editor.lastMult);
         copyCharacters(editor, ch, toCopy);
         editor.lastCommand = "inline";
     }
     else if (ch == 'y') {
-        int linesLeft = (int)editor.textBuffer.size() - editor.cursorY;
+        int linesLeft = editor.textBuffer->lineCount() - editor.cursorY;
         int linesToCopy = std::min(linesLeft, numOfTimes * editor.lastMult);
         copyLines(editor, linesToCopy);
         editor.lastCommand = "line";
@@ -1066,7 +1071,7 @@ void CommandParser::ctrlG() {
     std::string modStatus = modified ? " [Modified] " : "";
     fileInfo += modStatus;
 
-    int totalLines = editor.textBuffer.size();
+    int totalLines = editor.textBuffer->lineCount();
     fileInfo += std::to_string(totalLines) + " lines ";
 
     int currentLine = editor.cursorY + 1; 
@@ -1083,7 +1088,7 @@ void CommandParser::percentCommand(int percentage) {
     if (percentage > 0 && percentage <= 100) {
         int lineNumber = ((double)percentage / 100) * editor.getMaxCursorY();
         editor.setCursorPosition(lineNumber, 0);
-        while (editor.textBuffer[editor.cursorY][editor.cursorX] == ' ') {
+        while (editor.textBuffer->charAt(editor.cursorY, editor.cursorX) == ' ') {
             editor.cursorX++;
         }
         return;
@@ -1096,12 +1101,13 @@ void CommandParser::percentCommand(int percentage) {
         // else beep();
         // if the cursor is currently on some opening bracket --> go until you find the matching closing bracket, else beep();
         // if the cursor is currently on some closing bracket --> go back until you find the matching opening bracket, else beep();
-        char currentChar = editor.textBuffer[editor.cursorY][editor.cursorX];
+        std::string currentLine = editor.textBuffer->line(editor.cursorY);
+        char currentChar = currentLine[editor.cursorX];
         if (currentChar != '{' && currentChar != '[' && currentChar != '(' && currentChar != '}' && currentChar != ']' && currentChar != ')') {
             int curX = editor.cursorX;
             bool flag = false;
-            while (curX < static_cast<int>(editor.textBuffer[editor.cursorY].size())) {
-                char checkClosing = editor.textBuffer[editor.cursorY][++curX];
+            while (curX < (int)currentLine.size()) {
+                char checkClosing = currentLine[++curX];
                 if (checkClosing == '}' || checkClosing == ']' || checkClosing == ')') {
                     flag = true;
                     break;
@@ -1113,8 +1119,8 @@ void CommandParser::percentCommand(int percentage) {
             }
             curX = editor.cursorX;
             flag = false;
-            while (curX < static_cast<int>(editor.textBuffer[editor.cursorY].size())) {
-                char checkOpening = editor.textBuffer[editor.cursorY][++curX];
+            while (curX < (int)currentLine.size()) {
+                char checkOpening = currentLine[++curX];
                 if (checkOpening == '{' || checkOpening == '[' || checkOpening == '(') {
                     flag = true;
                     break;
@@ -1137,13 +1143,14 @@ void CommandParser::percentCommand(int percentage) {
 void CommandParser::findMatchingBracket(int startX, int startY, bool dir) {
 
     std::stack<char> stk;
-    char bracketType = editor.textBuffer[startY][startX];
+    char bracketType = editor.textBuffer->charAt(startY, startX);
     stk.push(bracketType);
     if (dir) {
-        for (int y = startY; y < static_cast<int>(editor.textBuffer.size()); ++y) {
+        for (int y = startY; y < editor.textBuffer->lineCount(); ++y) {
             int xStart = (y == startY) ? startX + 1 : 0;
-            for (int x = xStart; x < static_cast<int>(editor.textBuffer[y].size()); ++x) {
-                char currentChar = editor.textBuffer[y][x];
+            std::string line = editor.textBuffer->line(y);
+            for (int x = xStart; x < static_cast<int>(line.size()); ++x) {
+                char currentChar = line[x];
                 if (currentChar == bracketType) {
                     stk.push(currentChar);
                 }
@@ -1158,9 +1165,10 @@ void CommandParser::findMatchingBracket(int startX, int startY, bool dir) {
         }
     } else {
         for (int y = startY; y >= 0; --y) {
-            int xEnd = (y == startY) ? startX - 1 : editor.textBuffer[y].size() - 1;
+            std::string line = editor.textBuffer->line(y);
+            int xEnd = (y == startY) ? startX - 1 : line.size() - 1;
             for (int x = xEnd; x >= 0; --x) {
-                char currentChar = editor.textBuffer[y][x];
+                char currentChar = line[x];
                 if (currentChar == bracketType) {
                     stk.push(currentChar);
                 }
@@ -1176,16 +1184,36 @@ void CommandParser::findMatchingBracket(int startX, int startY, bool dir) {
     }
 }
 
-void CommandParser::colonCommand() {
+void CommandParser::colonCommand(const std::string& prefix) {
     std::string commandStr;
     echo(); 
     curs_set(1); 
     move(LINES - 1, 0);
     clrtoeol(); 
-    printw(":"); 
-    char inputBuffer[256];
-    getnstr(inputBuffer, 255);
-    commandStr = std::string(inputBuffer);
+    printw(":%s", prefix.c_str()); 
+    commandStr = prefix;
+    if (editor.runningKeys()) {
+        // The keys being run hold the command line too, up to Enter
+        int ch;
+        while ((ch = editor.readKey()) != '\n' && ch != '\r') {
+            if (ch == 27) {
+                noecho();
+                return;
+            }
+            commandStr += static_cast<char>(ch);
+        }
+    } else {
+        char inputBuffer[256];
+        getnstr(inputBuffer, 255);
+        commandStr += inputBuffer;
+        // getnstr reads past readKey, so a macro takes the line from here
+        if (editor.macros.recording()) {
+            for (const char* c = inputBuffer; *c; c++) {
+                editor.macros.record(static_cast<unsigned char>(*c), false);
+            }
+            editor.macros.record('\n', false);
+        }
+    }
     noecho();
     move(LINES - 1, 0);
     clrtoeol();
@@ -1212,25 +1240,11 @@ void CommandParser::callDeleteCommand(Editor& editor, bool type, char ch, int nu
 
 void CommandParser::callSearchCommand(Editor& editor, char direction, int numOfTimes) {
     std::string wordStr;
-    echo(); 
-    curs_set(1); 
-    move(LINES - 1, 0);
-    clrtoeol(); 
-    if (direction == '/') {
-        printw("/");
-    }
-    else {
-        printw("?");
-    }
-    char inputBuffer[256];
-    getnstr(inputBuffer, 255); 
-    wordStr = std::string(inputBuffer);
-    query = wordStr;
-    noecho();
-    move(LINES - 1, 0);
-    clrtoeol();
     SearchCommand searchCommand(editor, numOfTimes);
-    searchCommand.execute(wordStr, direction);
+    if (searchCommand.captureSearchInput(direction, wordStr)) {
+        query = wordStr;
+        searchCommand.execute(wordStr, direction);
+    }
     editor.commandSeq = "";
 }
 
@@ -0,0 +1,66 @@
+#include "DamageTracker.h"
+#include <algorithm>
+#include <climits>
+
+DamageTracker::DamageTracker(const TextBuffer& textBuffer)
+    : textBuffer(textBuffer), dirtyFrom(INT_MAX), all(true) {}
+
+void DamageTracker::onInsert(size_t offset, std::string_view text) {
+    int y = textBuffer.lineAt(offset);
+    if (text.find('\n') != std::string_view::npos) {
+        markFrom(y);
+    } else {
+        markLines(y, y);
+    }
+}
+
+void DamageTracker::onErase(size_t offset, std::string_view removed) {
+    int y = textBuffer.lineAt(offset);
+    if (removed.find('\n') != std::string_view::npos) {
+        markFrom(y);
+    } else {
+        markLines(y, y);
+    }
+}
+
+void DamageTracker::markLines(int from, int to) {
+    if (all || from >= dirtyFrom) {
+        return;
+    }
+    // Past a handful of separate ranges a full repaint is no worse
+    if (ranges.size() >= MaxRanges) {
+        markFrom(std::min(from, std::min_element(ranges.begin(), ranges.end())->first));
+        return;
+    }
+    ranges.emplace_back(std::min(from, to), std::max(from, to));
+}
+
+void DamageTracker::markFrom(int y) {
+    dirtyFrom = std::min(dirtyFrom, y);
+}
+
+void DamageTracker::markAll() {
+    all = true;
+}
+
+bool DamageTracker::isDirty(int y) const {
+    if (all || y >= dirtyFrom) {
+        return true;
+    }
+    for (const auto& range : ranges) {
+        if (y >= range.first && y <= range.second) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool DamageTracker::allDirty() const {
+    return all;
+}
+
+void DamageTracker::clear() {
+    ranges.clear();
+    dirtyFrom = INT_MAX;
+    all = false;
+}
@@ -1,5 +1,6 @@
 #include "DeleteCommand.h"
 #include "ncurses.h"
+#include <algorithm>
 #include <iostream>
 
 DeleteCommand::DeleteCommand(Editor& editor, bool type, char command, int numOfTimes)
@@ -9,21 +10,34 @@ DeleteCommand::DeleteCommand(Editor& editor, bool type, char command, int numOfT
 }
 
 void DeleteCommand::execute() {
-    for (int cnt = 0; cnt < numOfTimes; cnt++) {
-        deletedChar = editor.getCharacterAtCursor();
+    // The count is clamped to the line and comes off in one erase, so
+    // 100000x costs the same as x
+    int y = editor.getCursorY();
+    int x = editor.getCursorX();
+    int count = type ? std::min(numOfTimes, x) : std::min(numOfTimes, editor.textBuffer->lineLength(y) - x);
+    int start = type ? x - count : x;
+    if (count <= 0 && editor.getMode() == Mode::Insert) {
+        // Backspace at the start of a line or Delete at its end joins lines
         editor.deleteCharacter(type);
+        return;
+    }
+    if (type) {
+        editor.input.resize(std::max<int>(0, editor.input.size() - count));
+    }
+    if (count > 0) {
+        deletedChar = editor.textBuffer->substr(editor.textBuffer->lineStart(y) + start, count);
+        editor.textBuffer->erase(y, start, count);
+        editor.setCursorPosition(y, start);
     }
     if (command == 's') {
         editor.switchMode(Mode::Insert);
     }
-    if (!editor.fileHistory.empty() && editor.textBuffer != editor.fileHistory.top().first) {
-        editor.fileHistory.push({editor.textBuffer, {cursorYBefore, cursorXBefore}});
-    }
 }
 
 void DeleteCommand::undo() {
+    int x = type ? cursorXBefore - (int)deletedChar.size() : cursorXBefore;
+    editor.textBuffer->insert(cursorYBefore, x, deletedChar);
     editor.setCursorPosition(cursorYBefore, cursorXBefore);
-    editor.insertCharacter(deletedChar[0]);
 }
 
 std::string DeleteCommand::getType() const {
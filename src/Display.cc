@@ -8,6 +8,11 @@
 #define COLOR_ID 19
 #define COLOR_COMMENTS 20
 #define COLOR_PREP 21
+#define COLOR_TYPE 22
+#define COLOR_CONSTANT 23
+#define COLOR_FUNCTION 24
+#define COLOR_VARIABLE 25
+#define COLOR_KEY 26
 
 
 Display::Display() : window(nullptr) {}
@@ -53,6 +58,17 @@ void Display::initialize() {
     init_pair(11, COLOR_PREP, COLOR_BLACK);    // Preprocessor directives
     init_pair(12, COLOR_WHITE, COLOR_BLACK);   // Operators and punctuation
     init_pair(13, COLOR_RED, COLOR_BLACK);     // Mismatched braces, brackets, parentheses
+    init_color(COLOR_TYPE, 306, 788, 690);
+    init_pair(14, COLOR_TYPE, COLOR_BLACK);    // Types
+    init_color(COLOR_CONSTANT, 337, 612, 839);
+    init_pair(15, COLOR_CONSTANT, COLOR_BLACK); // Constants
+    init_color(COLOR_FUNCTION, 862, 862, 666);
+    init_pair(16, COLOR_FUNCTION, COLOR_BLACK); // Functions and builtins
+    init_color(COLOR_VARIABLE, 612, 862, 996);
+    init_pair(17, COLOR_VARIABLE, COLOR_BLACK); // Variables
+    init_color(COLOR_KEY, 808, 569, 471);
+    init_pair(18, COLOR_KEY, COLOR_BLACK);     // Keys of maps and make targets
+    init_pair(19, COLOR_BLACK, COLOR_YELLOW);  // Search matches
 
     int rows, cols;
     getmaxyx(stdscr, rows, cols);
@@ -60,7 +76,8 @@ void Display::initialize() {
 
     scrollok(window, FALSE);
 
-    refresh();
+    // Flush stdscr once so the first getch() does not paint it over the window
+    ::refresh();
 }
 
 void Display::renderText(const std::vector<std::string>& textBuffer, int rows) {
@@ -84,15 +101,17 @@ void Display::renderCC(const std::vector<std::string>& textBuffer, int rows) {
     werase(window);
 
     // Render the text buffer with syntax highlighting
+    LexerState state;
+    std::vector<Token> tokens;
     for (int i = 0; i < rows - 1; ++i) { 
         if (i < static_cast<int>(textBuffer.size())) {
-            std::string line = textBuffer[i];
-            std::vector<std::pair<TokenType, std::string>> highlightedTokens = syntaxHighlighter.highlight(line);
+            const std::string& line = textBuffer[i];
+            syntaxHighlighter.highlight(line, state, tokens);
 
             int x = 0;
-            for (const auto& tokenPair : highlightedTokens) {
-                TokenType type = tokenPair.first;
-                std::string text = tokenPair.second;
+            for (const Token& token : tokens) {
+                TokenType type = token.type;
+                std::string text = line.substr(token.position, token.length);
 
                 switch (type) {
                     case TokenType::Keyword:
@@ -4,13 +4,36 @@
 #include "InsertCommand.h"
 #include "DeleteCommand.h"
 #include "ColonCommands.h" 
+#include "PieceTable.h"
 #include <ncurses.h>
+#include <algorithm>
 #include <cctype> 
+#include <chrono>
 #include <memory>
 #include <iostream>
 #include <cassert>
+#include <cstdlib>
+#include <ctime>
+#include <limits>
 #include <unordered_map>
 
+namespace {
+
+// 2114 as "2,114"
+std::string withCommas(size_t n) {
+    std::string digits = std::to_string(n);
+    std::string out;
+    for (size_t i = 0; i < digits.size(); i++) {
+        if (i > 0 && (digits.size() - i) % 3 == 0) {
+            out += ',';
+        }
+        out += digits[i];
+    }
+    return out;
+}
+
+}
+
 Editor::Editor(const std::string& initFilename)
     : cursorY(0),
       cursorX(0),
@@ -18,23 +41,48 @@ Editor::Editor(const std::string& initFilename)
       mode(Mode::Command),
       isRunning(true),
       filename(initFilename),
-      viewOffsetY(0)
+      viewOffsetY(0),
+      grammar(nullptr),
+      countPending(false),
+      countOffset(0),
+      countIsError(false),
+      quickfixIndex(0)
 {
     display = std::make_shared<Display>();
     fileManager = std::make_shared<FileManager>(); 
+    saver = std::make_unique<AsyncSaver>(fileManager);
     statusBar = std::make_unique<StatusBar>();     
+    textBuffer = std::make_unique<PieceTable>();
 
     if (!filename.empty() && fileManager->fileExists(filename)) {
-        if (!fileManager->loadFile(filename, textBuffer)) {
+        if (!fileManager->loadFile(filename, *textBuffer)) {
             std::cerr << "Failed to load file. Starting with an empty buffer.\n";
-            textBuffer.emplace_back("");
+            textBuffer->reset(nullptr);
         }
-    } else {
-        textBuffer.emplace_back("");
     }
-    unmodifiedFile = textBuffer;
+    textBuffer->addListener(&undoJournal);
+    damage = std::make_unique<DamageTracker>(*textBuffer);
+    textBuffer->addListener(damage.get());
+    highlights = std::make_unique<HighlightCache>(*textBuffer);
+    textBuffer->addListener(highlights.get());
+    matches = std::make_unique<MatchCache>(*textBuffer);
+    textBuffer->addListener(matches.get());
+    // Grammars of the user's own take over the built-in ones
+    const char* home = std::getenv("HOME");
+    std::string grammarError;
+    if (home && !grammars.loadDirectory(std::string(home) + "/.vm/grammars", grammarError)) {
+        std::cerr << "Error: Could not load grammar " << grammarError << "\n";
+    }
+    detectGrammar();
+    savedSeq = undoJournal.currentSeq();
     lastMult = 1;
     replaying = false;
+    visualFirstLine = -1;
+    visualLastLine = -1;
+    feedingKeys = false;
+    suppressRender = false;
+    lastMacro = 0;
+    macroDepth = 0;
 }
 
 Editor::~Editor() {
@@ -59,57 +107,64 @@ void Editor::setCursorPosition(int y, int x) {
 void Editor::handleInsertToCommand() {
     backup = input;
     backupMult = lastMult;
-    if (backup.size() == 0) {
-        fileHistory.pop();
-    }
-    for (int i = 0; i < lastMult - 1; i++) {
-        for (int j = 0; j < static_cast<int>(backup.size()); j++) {
-            insertCharacter(backup[j]);
+    if (lastMult > 1 && !backup.empty()) {
+        // The other count - 1 copies go in as one splice
+        std::string repeated;
+        repeated.reserve(backup.size() * (lastMult - 1));
+        for (int i = 0; i < lastMult - 1; i++) {
+            repeated.append(backup.begin(), backup.end());
         }
+        insertText(repeated);
     }
     input.clear();
 }
 
+void Editor::insertText(std::string_view text) {
+    int missingLines = cursorY - textBuffer->lineCount() + 1;
+    if (missingLines > 0) {
+        textBuffer->insertAt(textBuffer->length(), std::string(missingLines, '\n'));
+    }
+    textBuffer->insert(cursorY, cursorX, text);
+    size_t lastBreak = text.rfind('\n');
+    if (lastBreak == std::string_view::npos) {
+        setCursorPosition(cursorY, cursorX + text.size());
+    } else {
+        int breaks = std::count(text.begin(), text.end(), '\n');
+        setCursorPosition(cursorY + breaks, text.size() - lastBreak - 1);
+    }
+    input.insert(input.end(), text.begin(), text.end());
+}
+
 void Editor::insertCharacter(int ch) {
     // If cursorY is beyond textBuffer, create new lines
-    while (cursorY >= static_cast<int>(textBuffer.size())) {
-        textBuffer.emplace_back("");
+    int missingLines = cursorY - textBuffer->lineCount() + 1;
+    if (missingLines > 0) {
+        textBuffer->insertAt(textBuffer->length(), std::string(missingLines, '\n'));
     }
 
+    char c = static_cast<char>(ch);
+    textBuffer->insert(cursorY, cursorX, std::string_view(&c, 1));
     if (ch == '\n') {
-        std::string& currentLine = textBuffer[cursorY];
-        std::string newLine = currentLine.substr(cursorX);
-        currentLine.erase(cursorX);
-        textBuffer.insert(textBuffer.begin() + cursorY + 1, newLine);
         setCursorPosition(cursorY + 1, 0);
     } else {
-        std::string& currentLine = textBuffer[cursorY];
-        currentLine.insert(cursorX, 1, static_cast<char>(ch));
         setCursorPosition(cursorY, cursorX + 1);
     }
-    input.push_back(static_cast<char>(ch));
+    input.push_back(c);
 }
 
 void Editor::deleteCharacter(bool type) {
-    if (textBuffer.empty()) {
-        beep();
-        return;
-    }
-    
     if (type) { // Backspace
         if (!input.empty()) {
             input.pop_back();
         }
-        std::string& currentLine = textBuffer[cursorY];
         if (cursorX > 0) {
-            currentLine.erase(cursorX - 1, 1);
+            textBuffer->erase(cursorY, cursorX - 1, 1);
             cursorX--;
         }
         else if (cursorY > 0) {
-            std::string previousLine = textBuffer[cursorY - 1];
-            int previousLineLength = previousLine.length();
-            textBuffer[cursorY - 1] += currentLine;
-            textBuffer.erase(textBuffer.begin() + cursorY);
+            // Removing the previous line's newline joins the two lines
+            int previousLineLength = textBuffer->lineLength(cursorY - 1);
+            textBuffer->erase(cursorY - 1, previousLineLength, 1);
             cursorY--;
             cursorX = previousLineLength;
         }
@@ -118,14 +173,12 @@ void Editor::deleteCharacter(bool type) {
         }
     }
     else { 
-        std::string& currentLine = textBuffer[cursorY];
-        if (cursorX < static_cast<int>(currentLine.length())) {
-            currentLine.erase(cursorX, 1);
+        int lineLength = textBuffer->lineLength(cursorY);
+        if (cursorX < lineLength) {
+            textBuffer->erase(cursorY, cursorX, 1);
         }
-        else if (cursorY < static_cast<int>(textBuffer.size()) - 1) {
-            std::string nextLine = textBuffer[cursorY + 1];
-            textBuffer[cursorY] += nextLine;
-            textBuffer.erase(textBuffer.begin() + cursorY + 1);
+        else if (cursorY < textBuffer->lineCount() - 1) {
+            textBuffer->erase(cursorY, lineLength, 1);
         }
         else {
             beep();
@@ -136,10 +189,8 @@ void Editor::deleteCharacter(bool type) {
 }
 
 char Editor::getCharacterAtCursor() const {
-    const std::string& currentLine = textBuffer[cursorY];
-    if (cursorX > 0 &&
-        cursorX <= static_cast<int>(currentLine.length())) {
-        return currentLine[cursorX - 1];
+    if (cursorX > 0) {
+        return textBuffer->charAt(cursorY, cursorX - 1);
     }
     return '\0';
 }
@@ -155,16 +206,22 @@ Mode Editor::getMode() const {
 }
 
 void Editor::switchMode(Mode newMode) {
-    if (newMode == Mode::Insert) {
-        if (!fileHistory.empty() && textBuffer != fileHistory.top().first) {
-            fileHistory.push({textBuffer, {cursorY, cursorX}});
-        }
-    }
     mode = newMode;
 }
 
 void Editor::setFilename(const std::string& fname) {
     filename = fname;
+    detectGrammar();
+}
+
+void Editor::detectGrammar() {
+    // A #! line picks the grammar of a file with no telling name
+    std::string firstLine;
+    if (textBuffer->lineCount() > 0) {
+        textBuffer->line(0, firstLine);
+    }
+    grammar = grammars.forFile(filename, firstLine);
+    highlights->setGrammar(grammar);
 }
 
 std::string Editor::getFilename() const {
@@ -173,7 +230,12 @@ std::string Editor::getFilename() const {
 
 bool Editor::loadFile(const std::string& filename) {
     if (fileManager->fileExists(filename)) {
-        if (fileManager->loadFile(filename, textBuffer)) {
+        if (fileManager->loadFile(filename, *textBuffer)) {
+            undoJournal.clear();
+            damage->markAll();
+            highlights->clear();
+            matches->clear();
+            savedSeq = undoJournal.currentSeq();
             setFilename(filename);
             cursorY = 0;
             cursorX = 0;
@@ -183,8 +245,12 @@ bool Editor::loadFile(const std::string& filename) {
         setStatusMessage("Error loading file: " + filename, true);
         return false;
     } else {
-        textBuffer.clear();
-        textBuffer.emplace_back("");
+        textBuffer->reset(nullptr);
+        undoJournal.clear();
+        damage->markAll();
+        highlights->clear();
+        matches->clear();
+        savedSeq = undoJournal.currentSeq();
         setFilename(filename);
         cursorY = 0;
         cursorX = 0;
@@ -193,14 +259,30 @@ bool Editor::loadFile(const std::string& filename) {
     }
 }
 
-bool Editor::saveFile(const std::string& filename) {
-    if (fileManager->saveFile(filename, textBuffer)) {
-        setFilename(filename);
-        setStatusMessage("File saved: " + filename, false);
-        return true;
+void Editor::saveFile(const std::string& filename) {
+    // Editing goes on while the writer thread works from the snapshot
+    saver->save(filename, textBuffer->snapshot(), undoJournal.currentSeq());
+    setFilename(filename);
+    setStatusMessage("Saving " + filename + "...", false);
+}
+
+bool Editor::finishSaves() {
+    saver->wait();
+    return collectSaveResults();
+}
+
+bool Editor::collectSaveResults() {
+    bool allOk = true;
+    for (const AsyncSaver::Result& result : saver->takeResults()) {
+        if (result.ok) {
+            savedSeq = result.tag;
+            setStatusMessage("File saved: " + result.filename, false);
+        } else {
+            allOk = false;
+            setStatusMessage("Error saving file: " + result.filename, true);
+        }
     }
-    setStatusMessage("Error saving file: " + filename, true);
-    return false;
+    return allOk;
 }
 
 void Editor::setIsRunning(bool running) {
@@ -208,220 +290,240 @@ void Editor::setIsRunning(bool running) {
 }
 
 bool Editor::getIsModified() const {
-    return unmodifiedFile == textBuffer;
+    return undoJournal.hasPending() || undoJournal.currentSeq() != savedSeq;
+}
+
+void Editor::undo() {
+    int y = cursorY;
+    int x = cursorX;
+    if (undoJournal.undo(*textBuffer, y, x)) {
+        setCursorPosition(y, x);
+    } else {
+        setStatusMessage("Already at oldest change", false);
+    }
+}
+
+void Editor::redo() {
+    int y = cursorY;
+    int x = cursorX;
+    if (undoJournal.redo(*textBuffer, y, x)) {
+        setCursorPosition(y, x);
+    } else {
+        setStatusMessage("Already at newest change", false);
+    }
+}
+
+void Editor::undoChronological(long steps) {
+    int y = cursorY;
+    int x = cursorX;
+    if (undoJournal.stepChronological(*textBuffer, steps, y, x)) {
+        setCursorPosition(y, x);
+        setStatusMessage("Change " + std::to_string(undoJournal.currentSeq()) + " of " +
+                         std::to_string(undoJournal.lastSeq()), false);
+    } else {
+        setStatusMessage(steps < 0 ? "Already at oldest change" : "Already at newest change", false);
+    }
+}
+
+void Editor::undoTime(long seconds) {
+    int y = cursorY;
+    int x = cursorX;
+    if (undoJournal.stepTime(*textBuffer, seconds, y, x)) {
+        setCursorPosition(y, x);
+        setStatusMessage("Change " + std::to_string(undoJournal.currentSeq()) + " of " +
+                         std::to_string(undoJournal.lastSeq()), false);
+    } else {
+        setStatusMessage(seconds < 0 ? "Already at oldest change" : "Already at newest change", false);
+    }
+}
+
+std::string Editor::undoList() const {
+    std::vector<const UndoRecord*> leaves = undoJournal.leaves();
+    if (leaves.empty()) {
+        return "Nothing to undo";
+    }
+    std::string list = "number changes when:";
+    for (const UndoRecord* leaf : leaves) {
+        char when[16];
+        std::strftime(when, sizeof(when), "%H:%M:%S", std::localtime(&leaf->time));
+        list += "  " + std::to_string(leaf->seq) + " " + std::to_string(leaf->depth) + " " + when;
+    }
+    return list;
 }
 
 void Editor::setStatusMessage(const std::string& message, bool isError) {
     statusBar->setStatusMessage(message, isError);
 }
 
-void Editor::render() {
-    display->clear();
+void Editor::setPrompt(const std::string& text) {
+    prompt = text;
+}
 
-    int rows, cols;
-    display->getWindowSize(rows, cols);
+void Editor::showMatchCount(const std::string& message, bool isError) {
+    setStatusMessage(message, isError);
+    countMessage = message;
+    countIsError = isError;
+    countOffset = textBuffer->offsetOf(cursorY, cursorX);
+    countPending = true;
+    // The same pattern over unchanged text is answered from the last count
+    matchCounter.count(searchPattern, textBuffer->snapshot(), textBuffer->version());
+    collectMatchCount();
+}
 
-    int endLine = viewOffsetY + (rows - 1);
-    if (endLine > (int)textBuffer.size()) {
-        endLine = (int)textBuffer.size();
+void Editor::collectMatchCount() {
+    size_t index, total;
+    bool capped;
+    if (!countPending || !matchCounter.result(countOffset, index, total, capped)) {
+        return;
     }
-
-    bool hasSelection = (mode == Mode::Visual && visualModeHandler.hasSelection());
-    int selStartY = 0, selStartX = 0, selEndY = 0, selEndX = 0;
-    VisualType vType = VisualType::Character;
-    if (hasSelection) {
-        visualModeHandler.getSelectionBounds(selStartY, selStartX, selEndY, selEndX);
-        vType = visualModeHandler.getVisualType();
+    countPending = false;
+    std::string message = countMessage + "  match " + (index ? withCommas(index) : "?") + " of ";
+    if (capped) {
+        message += ">";
     }
+    setStatusMessage(message + withCommas(total), countIsError);
+}
 
-    WINDOW* win = display->getWindow();
-    werase(win);
-    leaveok(win, FALSE);
+void Editor::highlightSearch(bool on) {
+    matches->setPattern(on ? searchPattern : Regex());
+}
 
-    int visibleRows = rows - 1; // last line for status bar
-    bool isCppFile = (filename.ends_with(".h") || filename.ends_with(".cc"));
-    if (!enhanced) {
-        
+void Editor::setQuickfix(std::vector<GrepHit> hits, bool jump) {
+    quickfix = std::move(hits);
+    quickfixIndex = 0;
+    if (jump) {
+        showQuickfix(0);
+    } else {
+        std::string position = "(1 of ";
+        position += withCommas(quickfix.size()) + "): ";
+        setStatusMessage(position + quickfix[0].text, false);
     }
+}
 
-    for (int i = 0; i < visibleRows; i++) {
-        int actualLine = viewOffsetY + i;
-        std::string line;
-        if (actualLine < (int)textBuffer.size()) {
-            line = textBuffer[actualLine];
-        } else {
-            line.clear();
-        }
+void Editor::stepQuickfix(long step) {
+    if (quickfix.empty()) {
+        setStatusMessage("E42: No Errors", true);
+        return;
+    }
+    long index = static_cast<long>(quickfixIndex) + step;
+    if (index < 0 || index >= static_cast<long>(quickfix.size())) {
+        setStatusMessage("E553: No more items", true);
+        return;
+    }
+    showQuickfix(index);
+}
 
-        bool isLineSelected = false;
-        if (hasSelection && vType == VisualType::Line) {
-            if (actualLine >= selStartY && actualLine <= selEndY) {
-                isLineSelected = true;
-            }
+bool Editor::showQuickfix(size_t index) {
+    const GrepHit& hit = quickfix[index];
+    if (hit.file != filename) {
+        // Leaving the buffer would lose its changes
+        if (getIsModified()) {
+            setStatusMessage("E37: No write since last change (add ! to override)", true);
+            return false;
+        }
+        if (!loadFile(hit.file)) {
+            return false;
         }
+    }
+    quickfixIndex = index;
+    textBuffer->waitForLines(hit.line + 1);
+    setCursorPosition(std::min(hit.line, getMaxCursorY()), hit.column);
+    std::string position = "(";
+    position += withCommas(quickfixIndex + 1) + " of " + withCommas(quickfix.size()) + "): ";
+    setStatusMessage(position + hit.text, false);
+    return true;
+}
 
-        int blockStartX = 0, blockEndX = -1;
-        if (hasSelection && vType == VisualType::Block) {
-            blockStartX = std::min(selStartX, selEndX);
-            blockEndX = std::max(selStartX, selEndX);
-        }
-
-        if (isCppFile && actualLine < (int)textBuffer.size()) {
-            auto highlightedTokens = display->syntaxHighlighter.highlight(line);
-
-            int x = 0;
-            for (const auto& tokenPair : highlightedTokens) {
-                TokenType type = tokenPair.first;
-                const std::string& text = tokenPair.second;
-
-                int colorPairToUse = 2;
-                attr_t attrToUse = A_NORMAL;
-                switch (type) {
-                    case TokenType::Keyword: colorPairToUse = 6; break;
-                    case TokenType::NumericLiteral: colorPairToUse = 7; break;
-                    case TokenType::StringLiteral: colorPairToUse = 8; break;
-                    case TokenType::Identifier: colorPairToUse = 9; break;
-                    case TokenType::Comment: colorPairToUse = 10; break;
-                    case TokenType::PreprocessorDirective: colorPairToUse = 11; break;
-                    case TokenType::Operator:
-                    case TokenType::Punctuation:
-                        colorPairToUse = 12;
-                        break;
-                    case TokenType::MismatchedBrace:
-                    case TokenType::MismatchedBracket:
-                    case TokenType::MismatchedParenthesis:
-                        colorPairToUse = 13; attrToUse = A_BOLD;
-                        break;
-                    case TokenType::PlainText:
-                    default:
-                        colorPairToUse = 2; break;
-                }
-
-                for (size_t charIdx = 0; charIdx < text.size() && x < cols; charIdx++, x++) {
-                    bool charInSelection = false;
-                    if (hasSelection) {
-                        if (vType == VisualType::Character) {
-                            if ((actualLine > selStartY || (actualLine == selStartY && (int)x >= selStartX)) &&
-                                (actualLine < selEndY || (actualLine == selEndY && (int)x <= selEndX))) {
-                                charInSelection = true;
-                            }
-                        } else if (vType == VisualType::Line) {
-                            charInSelection = isLineSelected; // entire line selected
-                        } else if (vType == VisualType::Block) {
-                            if (actualLine >= selStartY && actualLine <= selEndY &&
-                                x >= blockStartX && x <= blockEndX) {
-                                charInSelection = true;
-                            }
-                        }
-                    }
-
-                    if (charInSelection) {
-                        wattron(win, A_REVERSE);
-                        mvwaddch(win, i, x, text[charIdx]);
-                        wattroff(win, A_REVERSE);
-                    } else {
-                        wattron(win, COLOR_PAIR(colorPairToUse) | attrToUse);
-                        mvwaddch(win, i, x, text[charIdx]);
-                        wattroff(win, COLOR_PAIR(colorPairToUse) | attrToUse);
-                    }
-                }
-            }
+int Editor::getViewOffsetY() const {
+    return viewOffsetY;
+}
 
-            int lineLen = (int)line.size();
-            for (int xPos = lineLen; xPos < cols; xPos++) {
-                bool charInSelection = false;
-                if (hasSelection && vType == VisualType::Line && isLineSelected) {
-                    charInSelection = true; 
-                }
-                if (charInSelection) {
-                    wattron(win, A_REVERSE);
-                    mvwaddch(win, i, xPos, ' ');
-                    wattroff(win, A_REVERSE);
-                } else {
-                    wattron(win, COLOR_PAIR(5));
-                    mvwaddch(win, i, xPos, ' ');
-                    wattroff(win, COLOR_PAIR(5));
-                }
-            }
+void Editor::setViewOffsetY(int y) {
+    viewOffsetY = std::max(0, std::min(y, cursorY));
+}
 
-        } else {
-            int lineLen = (int)line.size();
-            for (int x = 0; x < lineLen && x < cols; x++) {
-                bool charInSelection = false;
-                if (hasSelection) {
-                    if (vType == VisualType::Character) {
-                        if ((actualLine > selStartY || (actualLine == selStartY && x >= selStartX)) &&
-                            (actualLine < selEndY || (actualLine == selEndY && x <= selEndX))) {
-                            charInSelection = true;
-                        }
-                    } else if (vType == VisualType::Line) {
-                        charInSelection = isLineSelected;
-                    } else if (vType == VisualType::Block) {
-                        if (actualLine >= selStartY && actualLine <= selEndY &&
-                            x >= blockStartX && x <= blockEndX) {
-                            charInSelection = true;
-                        }
-                    }
-                }
-
-                if (charInSelection) {
-                    wattron(win, A_REVERSE);
-                    mvwaddch(win, i, x, line[x]);
-                    wattroff(win, A_REVERSE);
-                } else {
-                    wattron(win, COLOR_PAIR(2));
-                    mvwaddch(win, i, x, line[x]);
-                    wattroff(win, COLOR_PAIR(2));
-                }
-            }
+void Editor::render() {
+    if (suppressRender) {
+        return;
+    }
+    int rows, cols;
+    display->getWindowSize(rows, cols);
+    // A large file is drawn as soon as the lines on screen are indexed
+    textBuffer->waitForLines(viewOffsetY + rows);
 
-            for (int x = lineLen; x < cols; x++) {
-                bool charInSelection = false;
-                if (hasSelection && vType == VisualType::Line && isLineSelected) {
-                    charInSelection = true;
-                }
-                if (charInSelection) {
-                    wattron(win, A_REVERSE);
-                    mvwaddch(win, i, x, ' ');
-                    wattroff(win, A_REVERSE);
-                } else {
-                    wattron(win, COLOR_PAIR(5));
-                    mvwaddch(win, i, x, ' ');
-                    wattroff(win, COLOR_PAIR(5));
-                }
-            }
-        }
+    WINDOW* win = display->getWindow();
+    leaveok(win, FALSE);
 
-        if (actualLine >= (int)textBuffer.size()) {
-            if (actualLine >= (int)textBuffer.size()) {
-                wattron(win, COLOR_PAIR(5));
-                mvwprintw(win, i, 0, "~");
-                wattroff(win, COLOR_PAIR(5));
-            }
+    int lineCount = textBuffer->lineCount();
+    int visibleRows = rows - 1; // last line for status bar
+    // Whatever moved under every row forces a full repaint
+    if (viewOffsetY != drawn.viewOffsetY || rows != drawn.rows || cols != drawn.cols ||
+        grammar != drawn.grammar) {
+        damage->markAll();
+    }
+    markSelectionDamage();
+    int restyledFrom, restyledTo;
+    if (grammar &&
+        highlights->update(viewOffsetY, viewOffsetY + visibleRows - 1, restyledFrom, restyledTo)) {
+        damage->markLines(restyledFrom, restyledTo);
+    }
+    if (matches->update(viewOffsetY, viewOffsetY + visibleRows - 1, restyledFrom, restyledTo)) {
+        damage->markLines(restyledFrom, restyledTo);
+    }
+    drawn.viewOffsetY = viewOffsetY;
+    drawn.rows = rows;
+    drawn.cols = cols;
+    drawn.grammar = grammar;
+
+    // Only stale rows are repainted, so moving the cursor touches nothing
+    // but the status line
+    for (int i = 0; i < visibleRows; i++) {
+        int actualLine = viewOffsetY + i;
+        if (damage->isDirty(actualLine)) {
+            drawLine(win, i, actualLine, lineCount, cols);
         }
     }
+    damage->clear();
 
+    std::string left;
     if (mode == Mode::Visual) {
         VisualType vt = visualModeHandler.getVisualType();
         if (vt == VisualType::Character) {
-            statusBar->setLeftText("-- VISUAL --");
+            left = "-- VISUAL --";
         } else if (vt == VisualType::Line) {
-            statusBar->setLeftText("-- VISUAL LINE --");
+            left = "-- VISUAL LINE --";
         } else if (vt == VisualType::Block) {
-            statusBar->setLeftText("-- VISUAL BLOCK --");
+            left = "-- VISUAL BLOCK --";
         }
     } else if (mode == Mode::Insert) {
-        statusBar->setLeftText("-- INSERT --");
+        left = "-- INSERT --";
     } else if (mode == Mode::Replace) {
-        statusBar->setLeftText("-- REPLACE --");
+        left = "-- REPLACE --";
     } else {
-        statusBar->setLeftText(!filename.empty() ? filename : "-- COMMAND --");
+        left = !filename.empty() ? filename : "-- COMMAND --";
+    }
+    if (macros.recording()) {
+        left = mode == Mode::Command ? "recording @" : left + "recording @";
+        left += macros.recordingRegister();
     }
+    statusBar->setLeftText(left);
 
     std::string right = "Line: " + std::to_string(cursorY + 1) +
                         ", Col: " + std::to_string(cursorX + 1);
+    std::string savingFilename;
+    size_t written = 0, total = 0;
+    if (saver->progress(savingFilename, written, total)) {
+        right = "Saving " + std::to_string(total ? written * 100 / total : 100) + "%  " + right;
+    }
     statusBar->setRightText(right);
-    statusBar->render(win, rows, cols);
+    if (!prompt.empty()) {
+        mvwhline(win, rows - 1, 0, ' ', cols);
+        mvwaddnstr(win, rows - 1, 0, prompt.c_str(), cols);
+    } else {
+        statusBar->render(win, rows, cols);
+    }
+    // The : and / prompts write this row through stdscr
+    touchline(win, rows - 1, 1);
 
     int relativeCursorY = cursorY - viewOffsetY;
     if (relativeCursorY >= 0 && relativeCursorY < rows - 1) {
@@ -432,13 +534,101 @@ void Editor::render() {
     wrefresh(win);
 }
 
+void Editor::drawLine(WINDOW* win, int i, int actualLine, int lineCount, int cols) {
+    lineRenderer.begin(cols);
+    if (actualLine >= lineCount) {
+        lineRenderer.add("~", COLOR_PAIR(5));
+        lineRenderer.fill(COLOR_PAIR(5));
+        lineRenderer.draw(win, i);
+        return;
+    }
+
+    textBuffer->line(actualLine, lineText);
+    if (grammar) {
+        std::string_view text = lineText;
+        for (const Token& token : highlights->tokens(actualLine)) {
+            lineRenderer.add(text.substr(token.position, token.length), tokenAttributes(token.type));
+        }
+    } else {
+        lineRenderer.add(lineText, COLOR_PAIR(2));
+    }
+    int lineLen = lineRenderer.text().size();
+    lineRenderer.fill(COLOR_PAIR(5));
+    for (const MatchSpan& span : matches->spans(actualLine)) {
+        lineRenderer.overlay(span.start, span.end, COLOR_PAIR(19));
+    }
+
+    // The selection splits the runs it covers rather than being checked
+    // cell by cell
+    if (mode == Mode::Visual && visualModeHandler.hasSelection()) {
+        int selStartY, selStartX, selEndY, selEndX;
+        visualModeHandler.getSelectionBounds(selStartY, selStartX, selEndY, selEndX);
+        if (actualLine >= selStartY && actualLine <= selEndY) {
+            VisualType vType = visualModeHandler.getVisualType();
+            if (vType == VisualType::Character) {
+                int from = actualLine == selStartY ? selStartX : 0;
+                int to = actualLine == selEndY ? selEndX + 1 : lineLen;
+                lineRenderer.overlay(from, std::min(to, lineLen), A_REVERSE);
+            } else if (vType == VisualType::Line) {
+                lineRenderer.overlay(0, cols, A_REVERSE);
+            } else if (vType == VisualType::Block) {
+                int blockEndX = std::max(selStartX, selEndX) + 1;
+                lineRenderer.overlay(std::min(selStartX, selEndX), std::min(blockEndX, lineLen), A_REVERSE);
+            }
+        }
+    }
+    lineRenderer.draw(win, i);
+}
+
+void Editor::markSelectionDamage() {
+    DrawnFrame now;
+    now.hasSelection = (mode == Mode::Visual && visualModeHandler.hasSelection());
+    if (now.hasSelection) {
+        visualModeHandler.getSelectionBounds(now.selStartY, now.selStartX, now.selEndY, now.selEndX);
+        now.selectionType = visualModeHandler.getVisualType();
+    }
+    DrawnFrame& last = drawn;
+    if (now.hasSelection == last.hasSelection && (!now.hasSelection ||
+        (now.selectionType == last.selectionType && now.selStartY == last.selStartY &&
+         now.selStartX == last.selStartX && now.selEndY == last.selEndY && now.selEndX == last.selEndX))) {
+        return;
+    }
+
+    // Growing or shrinking from a fixed anchor only changes the lines the
+    // moving end passed over; a block's width change touches all its lines
+    bool sameAnchor = now.hasSelection && last.hasSelection && now.selectionType == last.selectionType &&
+                      now.selStartY == last.selStartY && now.selStartX == last.selStartX &&
+                      (now.selectionType != VisualType::Block || now.selEndX == last.selEndX);
+    if (sameAnchor) {
+        damage->markLines(last.selEndY, now.selEndY);
+    } else {
+        if (last.hasSelection) {
+            damage->markLines(last.selStartY, last.selEndY);
+        }
+        if (now.hasSelection) {
+            damage->markLines(now.selStartY, now.selEndY);
+        }
+    }
+    last.hasSelection = now.hasSelection;
+    last.selectionType = now.selectionType;
+    last.selStartY = now.selStartY;
+    last.selStartX = now.selStartX;
+    last.selEndY = now.selEndY;
+    last.selEndX = now.selEndX;
+}
+
 void Editor::handleInput(int ch, CommandParser& commandParser) {
+    undoJournal.beginStep(cursorY, cursorX);
     auto command = commandParser.parseInput(ch);
 
     if (command) {
         executeCommand(command);
     }
-    
+
+    // An insert session is one undo step, closed when it returns to command mode
+    if (mode == Mode::Command) {
+        undoJournal.commit(cursorY, cursorX);
+    }
 }
 
 void Editor::moveCursor(int deltaY, int deltaX) {
@@ -457,21 +647,16 @@ void Editor::ensureCursorInBounds(bool vertical) {
 
     int rows, cols;
     display->getWindowSize(rows, cols);
-    if (cursorY < 0) {
-        cursorY = 0;
-    } else if (cursorY > maxCursorY) {
-        cursorY = maxCursorY;
-    } else if (cursorY >= viewOffsetY + rows - 1 && viewOffsetY + rows - 1 <= maxCursorY) {
-        while (cursorY >= viewOffsetY + rows - 1 && viewOffsetY + rows - 1 <= maxCursorY) {
-            viewOffsetY += 1;
-        }
+    // A counted move may overshoot either end; clamp before scrolling to it
+    cursorY = std::clamp(cursorY, 0, std::max(maxCursorY, 0));
+    if (cursorY >= viewOffsetY + rows - 1 && viewOffsetY + rows - 1 <= maxCursorY) {
+        // A search may land millions of lines away, so no stepping there
+        viewOffsetY = cursorY - rows + 2;
     } else if (cursorY < viewOffsetY) {
-        while (cursorY < viewOffsetY) {
-            viewOffsetY -= 1;
-        }
+        viewOffsetY = cursorY;
     }
 
-    int lineLength = textBuffer[cursorY].length();
+    int lineLength = textBuffer->lineLength(cursorY);
 
     if (vertical) {
         // When moving vertically, try to maintain preferredCursorX
@@ -496,7 +681,7 @@ void Editor::ensureCursorInBounds(bool vertical) {
 }
 
 int Editor::getMaxCursorY() const {
-    return textBuffer.size() - 1;
+    return textBuffer->lineCount() - 1;
 }
 
 void Editor::setCommandParser(CommandParser& cp) {
@@ -512,10 +697,53 @@ void Editor::run() {
 
     ungetch('\n');
     while (isRunning) {
-        int ch = getch();
-        handleInput(ch, commandParser);
+        // Wake up now and then while work goes on in the background so the
+        // line count, scroll range, save progress, highlighting and match
+        // count catch up without a key press
+        if (textBuffer->isIndexing() || saver->busy() || highlights->busy() ||
+            (countPending && matchCounter.busy())) {
+            timeout(BackgroundPollMs);
+        }
+        int ch = readKey();
+        timeout(-1);
+        // Keys already waiting, such as a paste, are all taken before the
+        // next frame, and text typed into Insert mode goes in as one insert
+        std::string typed;
+        auto burstStart = std::chrono::steady_clock::now();
+        while (ch != ERR && isRunning) {
+            if (mode == Mode::Insert && (ch == '\n' || ch == KEY_ENTER || (ch < 256 && std::isprint(ch)))) {
+                typed += ch == KEY_ENTER ? '\n' : static_cast<char>(ch);
+            } else {
+                typeText(typed);
+                handleInput(ch, commandParser);
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (now - burstStart >= BurstFrameInterval) {
+                break; // a burst that goes on still shows now and then
+            }
+            // A key within what is left of this frame joins it, so frames
+            // come no faster than the screen refreshes
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(FrameInterval - (now - lastFrame));
+            timeout(std::max<int>(wait.count(), 0));
+            ch = readKey();
+            timeout(-1);
+        }
+        typeText(typed);
+        collectSaveResults();
+        collectMatchCount();
         render();
+        lastFrame = std::chrono::steady_clock::now();
+    }
+}
+
+void Editor::typeText(std::string& typed) {
+    if (typed.empty()) {
+        return;
     }
+    commandSeq += typed;
+    setStatusMessage("");
+    insertText(typed);
+    typed.clear();
 }
 
 void Editor::moveCursorToStart() {
@@ -523,12 +751,8 @@ void Editor::moveCursorToStart() {
 }
 
 void Editor::moveCursorToEnd() {
-    if (textBuffer.empty()) {
-        setCursorPosition(0, 0);
-        return;
-    }
-
-    int lastLine = textBuffer.size() - 1;
+    textBuffer->waitForLines(std::numeric_limits<int>::max());
+    int lastLine = textBuffer->lineCount() - 1;
     if (lastLine < 0) {
         lastLine = 0;
     }
@@ -591,7 +815,7 @@ void Editor::insertLinesBelowCursor(const std::vector<std::string>& lines) {
 
     int insertionLine = cursorY + 1;
 
-    textBuffer.insert(textBuffer.begin() + insertionLine, lines.begin(), lines.end());
+    textBuffer->insertLines(insertionLine, lines);
 
     cursorY = insertionLine;
     cursorX = 0;
@@ -599,11 +823,11 @@ void Editor::insertLinesBelowCursor(const std::vector<std::string>& lines) {
 }
 
 void Editor::moveCursorBackWord() {
-    if (cursorY < 0 || cursorY >= static_cast<int>(textBuffer.size())) {
+    if (cursorY < 0 || cursorY >= textBuffer->lineCount()) {
         setStatusMessage("Invalid cursor position.", true);
         return;
     }
-    std::string currentLine = textBuffer[cursorY];
+    std::string currentLine = textBuffer->line(cursorY);
     int y = cursorY;
     int x = cursorX;
     if (x == 0) {
@@ -612,8 +836,8 @@ void Editor::moveCursorBackWord() {
             return;
         } else {
             y--;
-            x = textBuffer[y].length();
-            currentLine = textBuffer[y];
+            currentLine = textBuffer->line(y);
+            x = currentLine.length();
         }
     }
     if (x > 0) {
@@ -630,8 +854,8 @@ void Editor::moveCursorBackWord() {
                 x = 0;
                 break;
             }
-            currentLine = textBuffer[y];
-            x = textBuffer[y].length() - 1;
+            currentLine = textBuffer->line(y);
+            x = currentLine.length() - 1;
             continue;
         }
         while (x >= 0 && !std::isspace(currentLine[x])) {
@@ -701,6 +925,10 @@ void Editor::enterVisualModeBlock() {
 void Editor::exitVisualMode() {
     if (mode == Mode::Visual) {
         mode = Mode::Command;
+        if (visualModeHandler.hasSelection()) {
+            int startX, endX;
+            visualModeHandler.getSelectionBounds(visualFirstLine, startX, visualLastLine, endX);
+        }
         visualModeHandler.clearSelection();
         setStatusMessage("", false);
     }
@@ -718,14 +946,14 @@ void Editor::yankSelection() {
         visualModeHandler.getSelectionBounds(startY, startX, endY, endX);
         std::vector<std::string> selectedText;
         if (startY == endY) {
-            std::string line = textBuffer[startY].substr(startX, endX - startX + 1);
+            std::string line = textBuffer->line(startY).substr(startX, endX - startX + 1);
             selectedText.push_back(line);
         } else {
-            selectedText.push_back(textBuffer[startY].substr(startX));
+            selectedText.push_back(textBuffer->line(startY).substr(startX));
             for (int l = startY + 1; l < endY; l++) {
-                selectedText.push_back(textBuffer[l]);
+                selectedText.push_back(textBuffer->line(l));
             }
-            selectedText.push_back(textBuffer[endY].substr(0, endX + 1));
+            selectedText.push_back(textBuffer->line(endY).substr(0, endX + 1));
         }
         setClipboard(selectedText);
         setStatusMessage("Yanked selection", false);
@@ -739,33 +967,28 @@ void Editor::deleteSelection() {
         visualModeHandler.getSelectionBounds(startY, startX, endY, endX);
         std::vector<std::string> selectedText;
         if (startY == endY) {
-            std::string line = textBuffer[startY].substr(startX, endX - startX + 1);
+            std::string line = textBuffer->line(startY).substr(startX, endX - startX + 1);
             selectedText.push_back(line);
         } else {
-            selectedText.push_back(textBuffer[startY].substr(startX));
+            selectedText.push_back(textBuffer->line(startY).substr(startX));
             for (int l = startY + 1; l < endY; l++) {
-                selectedText.push_back(textBuffer[l]);
+                selectedText.push_back(textBuffer->line(l));
             }
-            selectedText.push_back(textBuffer[endY].substr(0, endX + 1));
+            selectedText.push_back(textBuffer->line(endY).substr(0, endX + 1));
         }
         setClipboard(selectedText);
 
-        if (startY == endY) {
-            textBuffer[startY].erase(startX, endX - startX + 1);
-        } else {
-            textBuffer[startY].erase(startX);
-            for (int l = startY + 1; l < endY; l++) {
-                textBuffer.erase(textBuffer.begin() + (startY + 1));
-            }
-            std::string &lastLine = textBuffer[startY + 1];
-            lastLine.erase(0, endX + 1);
-            textBuffer[startY] += lastLine;
-            textBuffer.erase(textBuffer.begin() + (startY + 1));
+        // One erase from the selection start through the last selected
+        // character, which also joins the first and last lines
+        size_t from = textBuffer->offsetOf(startY, std::min(startX, textBuffer->lineLength(startY)));
+        size_t to = textBuffer->offsetOf(endY, std::min(endX + 1, textBuffer->lineLength(endY)));
+        if (to > from) {
+            textBuffer->eraseAt(from, to - from);
         }
 
         cursorY = startY;
-        if (cursorX > (int)textBuffer[startY].size()) {
-            cursorX = (int)textBuffer[startY].size();
+        if (cursorX > textBuffer->lineLength(startY)) {
+            cursorX = textBuffer->lineLength(startY);
         }
 
         setStatusMessage("Deleted selection", false);
@@ -782,13 +1005,114 @@ void Editor::repeatLastChange() {
         setStatusMessage("No last change to repeat", true);
         return;
     }
+    // Fed like :normal keys, so a count or an operator reads the keys
+    // after it from the change rather than the terminal, and nothing is
+    // drawn until it is done
+    bool wasReplaying = replaying;
     replaying = true;
-    for (char c : lastChangeKeys) {
-        handleInput(c, *commandParserRef); 
-    }
-    replaying = false;
-    ungetch('\n');
+    runKeys(lastChangeKeys);
+    replaying = wasReplaying;
  
     setStatusMessage("Repeated last change", false);
 }
 
+int Editor::readKey() {
+    if (!feedingKeys) {
+        int ch = getch();
+        if (ch != ERR && macros.recording()) {
+            macros.record(ch, mode == Mode::Insert);
+        }
+        return ch;
+    }
+    if (pendingKeys.empty()) {
+        return 27;
+    }
+    int ch = pendingKeys.front();
+    pendingKeys.pop_front();
+    return ch;
+}
+
+bool Editor::runningKeys() const {
+    return feedingKeys;
+}
+
+void Editor::runKeys(const std::string& keys) {
+    std::deque<int> outer;
+    outer.swap(pendingKeys);
+    pendingKeys.assign(keys.begin(), keys.end());
+    // Only drawing waits; the keys are typed as usual, so a . among them
+    // repeats the last change
+    bool wasFeeding = feedingKeys;
+    bool wasSuppressing = suppressRender;
+    feedingKeys = true;
+    suppressRender = true;
+    parsePendingKeys();
+    if (mode != Mode::Command) {
+        auto command = commandParserRef->parseInput(27);
+        if (command) {
+            executeCommand(command);
+        }
+    }
+    feedingKeys = wasFeeding;
+    suppressRender = wasSuppressing;
+    pendingKeys.swap(outer);
+}
+
+void Editor::parsePendingKeys() {
+    while (!pendingKeys.empty() && isRunning) {
+        auto command = commandParserRef->parseInput(readKey());
+        if (command) {
+            executeCommand(command);
+        }
+    }
+}
+
+void Editor::playMacro(char reg, int count) {
+    if (reg == '@') {
+        if (!lastMacro) {
+            setStatusMessage("E748: No previously used register", true);
+            return;
+        }
+        reg = lastMacro;
+    }
+    const std::vector<MacroOp>* ops = macros.ops(reg);
+    if (!ops) {
+        beep();
+        return;
+    }
+    if (macroDepth >= MaxMacroDepth) {
+        setStatusMessage("E169: Command too recursive", true);
+        return;
+    }
+    lastMacro = reg;
+
+    std::deque<int> outer;
+    outer.swap(pendingKeys);
+    // A macro is typed, not replayed: its changes become the last change
+    // and a . inside it repeats one, so only drawing is held back
+    bool wasFeeding = feedingKeys;
+    bool wasSuppressing = suppressRender;
+    feedingKeys = true;
+    suppressRender = true;
+    macroDepth++;
+    for (int cnt = 0; cnt < count && isRunning; cnt++) {
+        for (const MacroOp& op : *ops) {
+            if (op.kind == MacroOp::Text && mode == Mode::Insert) {
+                commandSeq += op.text;
+                insertText(op.text);
+            } else if (op.kind == MacroOp::Text) {
+                // The run went another way than the recording; type it
+                pendingKeys.assign(op.text.begin(), op.text.end());
+                parsePendingKeys();
+            } else {
+                pendingKeys.assign(op.keys.begin(), op.keys.end());
+                parsePendingKeys();
+            }
+        }
+    }
+    macroDepth--;
+    feedingKeys = wasFeeding;
+    suppressRender = wasSuppressing;
+    pendingKeys.swap(outer);
+}
+
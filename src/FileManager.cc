@@ -1,7 +1,98 @@
 #include "FileManager.h"
-#include <fstream>
+#include "MappedFile.h"
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
 #include <iostream>
-#include <sys/stat.h> 
+#include <memory>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+
+// Gathers pieces of text into iovec batches so a save costs a few large
+// writev calls no matter how fragmented the buffer is
+class BatchWriter {
+public:
+    BatchWriter(int fd, const std::function<void(size_t)>& progress)
+        : fd(fd), progress(progress), pending(0), written(0), ok(true) {}
+
+    void add(const char* data, size_t size) {
+        if (size == 0) {
+            return;
+        }
+        batch.push_back({const_cast<char*>(data), size});
+        pending += size;
+        if (batch.size() == MaxSegments || pending >= MaxBatchBytes) {
+            flush();
+        }
+    }
+
+    bool flush() {
+        size_t first = 0;
+        while (ok && first < batch.size()) {
+            ssize_t count = writev(fd, batch.data() + first, static_cast<int>(batch.size() - first));
+            if (count <= 0) {
+                if (count == 0 || errno != EINTR) {
+                    ok = false;
+                }
+                continue;
+            }
+            // Skip what went out, resuming inside a partly written segment
+            size_t left = static_cast<size_t>(count);
+            while (first < batch.size() && left >= batch[first].iov_len) {
+                left -= batch[first].iov_len;
+                first++;
+            }
+            if (first < batch.size()) {
+                batch[first].iov_base = static_cast<char*>(batch[first].iov_base) + left;
+                batch[first].iov_len -= left;
+            }
+        }
+        written += pending;
+        batch.clear();
+        pending = 0;
+        if (ok && progress) {
+            progress(written);
+        }
+        return ok;
+    }
+
+private:
+    static constexpr size_t MaxSegments = 1024; // IOV_MAX on Linux
+    static constexpr size_t MaxBatchBytes = 8 * 1024 * 1024;
+
+    int fd;
+    const std::function<void(size_t)>& progress;
+    std::vector<iovec> batch;
+    size_t pending;
+    size_t written;
+    bool ok;
+};
+
+// Makes the rename itself durable
+void syncDirectory(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    std::string directory = (slash == std::string::npos) ? "." : path.substr(0, slash + 1);
+    int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+// umask can only be read by setting it, which would race with files
+// other threads create; so it is read once, before main starts any
+mode_t readUmask() {
+    mode_t mask = umask(0);
+    umask(mask);
+    return mask;
+}
+
+const mode_t startupUmask = readUmask();
+
+}
 
 FileManager::FileManager() {
 }
@@ -14,34 +105,62 @@ bool FileManager::fileExists(const std::string& filename) const {
     return (stat(filename.c_str(), &buffer) == 0);
 }
 
-bool FileManager::loadFile(const std::string& filename, std::vector<std::string>& textBuffer) {
-    std::ifstream infile(filename);
-    if (!infile.is_open()) {
+bool FileManager::loadFile(const std::string& filename, TextBuffer& textBuffer) {
+    auto mapped = std::make_shared<MappedFile>();
+    if (!mapped->open(filename)) {
         std::cerr << "Error: Could not open file '" << filename << "' for reading.\n";
         return false;
     }
 
-    textBuffer.clear(); 
-    std::string line;
-    while (std::getline(infile, line)) {
-        textBuffer.emplace_back(line);
-    }
-    
-    infile.close();
+    textBuffer.reset(mapped);
     return true;
 }
 
-bool FileManager::saveFile(const std::string& filename, const std::vector<std::string>& textBuffer) {
-    std::ofstream outfile(filename);
-    if (!outfile.is_open()) {
+bool FileManager::saveFile(const std::string& filename, const TextBuffer& textBuffer) {
+    return saveFile(filename, *textBuffer.snapshot());
+}
+
+bool FileManager::saveFile(const std::string& filename, const TextSnapshot& snapshot,
+                           const std::function<void(size_t)>& progress) {
+    // Save through a symlink to the file it points at
+    std::string target = filename;
+    if (char* resolved = realpath(filename.c_str(), nullptr)) {
+        target = resolved;
+        free(resolved);
+    }
+
+    // Write beside the original and swap the new file in, so a crash never
+    // leaves a half-written file and the buffer's mapping of the old one
+    // stays valid
+    std::string tempFilename = target + ".XXXXXX";
+    int fd = mkstemp(tempFilename.data());
+    if (fd < 0) {
         std::cerr << "Error: Could not open file '" << filename << "' for writing.\n";
         return false;
     }
 
-    for (const auto& line : textBuffer) {
-        outfile << line << "\n";
+    struct stat original;
+    mode_t mode;
+    if (stat(target.c_str(), &original) == 0) {
+        mode = original.st_mode & 07777;
+    } else {
+        mode = 0666 & ~startupUmask;
     }
 
-    outfile.close();
+    // Unchanged text is written straight from the mapped original
+    BatchWriter writer(fd, progress);
+    snapshot.forEachChunk([&writer](const char* data, size_t size) {
+        writer.add(data, size);
+    });
+    writer.add("\n", 1);
+
+    bool ok = writer.flush() && fchmod(fd, mode) == 0 && fsync(fd) == 0;
+    ok = (close(fd) == 0) && ok;
+    if (!ok || rename(tempFilename.c_str(), target.c_str()) != 0) {
+        std::cerr << "Error: Could not write file '" << filename << "'.\n";
+        unlink(tempFilename.c_str());
+        return false;
+    }
+    syncDirectory(target);
     return true;
 }
@@ -0,0 +1,314 @@
+#include "Grammar.h"
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+namespace {
+
+constexpr std::pair<std::string_view, TokenType> typeNames[] = {
+    {"keyword", TokenType::Keyword},
+    {"type", TokenType::Type},
+    {"constant", TokenType::Constant},
+    {"function", TokenType::Function},
+    {"variable", TokenType::Variable},
+    {"key", TokenType::Key},
+    {"number", TokenType::NumericLiteral},
+    {"string", TokenType::StringLiteral},
+    {"comment", TokenType::Comment},
+    {"preprocessor", TokenType::PreprocessorDirective},
+    {"operator", TokenType::Operator},
+    {"punctuation", TokenType::Punctuation},
+    {"identifier", TokenType::Identifier},
+    {"plain", TokenType::PlainText},
+};
+
+bool parseType(std::string_view name, TokenType& type) {
+    for (const auto& [typeName, value] : typeNames) {
+        if (typeName == name) {
+            type = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Fields are separated by blanks; \s, \t and \\ stand for a space, a tab
+// and a backslash
+std::vector<std::string> splitFields(const std::string& line) {
+    std::vector<std::string> fields;
+    std::istringstream in(line);
+    std::string raw;
+    while (in >> raw) {
+        std::string field;
+        for (size_t i = 0; i < raw.size(); i++) {
+            if (raw[i] == '\\' && i + 1 < raw.size()) {
+                char next = raw[++i];
+                field += next == 's' ? ' ' : next == 't' ? '\t' : next;
+            } else {
+                field += raw[i];
+            }
+        }
+        fields.push_back(field);
+    }
+    return fields;
+}
+
+// a-z style ranges; a '-' at either end stands for itself
+bool parseSet(std::string_view text, std::bitset<256>& set) {
+    set.reset();
+    for (size_t i = 0; i < text.size(); i++) {
+        unsigned char low = text[i];
+        if (i + 2 < text.size() && text[i + 1] == '-') {
+            unsigned char high = text[i + 2];
+            if (high < low) {
+                return false;
+            }
+            for (int c = low; c <= high; c++) {
+                set.set(c);
+            }
+            i += 2;
+        } else {
+            set.set(low);
+        }
+    }
+    return true;
+}
+
+// Every byte of the word, eight at a time, so words that differ only
+// in the middle still hash apart
+uint64_t hashWord(std::string_view word) {
+    uint64_t hash = word.size() * 0x9e3779b97f4a7c15;
+    size_t i = 0;
+    for (; i + 8 <= word.size(); i += 8) {
+        uint64_t chunk;
+        std::memcpy(&chunk, word.data() + i, 8);
+        hash = (hash ^ chunk) * 0xc2b2ae3d27d4eb4f;
+        hash ^= hash >> 29;
+    }
+    uint64_t rest = 0;
+    std::memcpy(&rest, word.data() + i, word.size() - i);
+    hash = (hash ^ rest) * 0xc2b2ae3d27d4eb4f;
+    return hash ^ (hash >> 32);
+}
+
+}
+
+bool Grammar::compile(std::string_view source, std::string& error) {
+    *this = Grammar();
+    std::istringstream in{std::string(source)};
+    std::string line;
+    int number = 0;
+    auto fail = [&](const std::string& message) {
+        error = "line " + std::to_string(number) + ": " + message;
+        return false;
+    };
+
+    while (std::getline(in, line)) {
+        number++;
+        std::vector<std::string> fields = splitFields(line);
+        if (fields.empty() || fields[0][0] == ';') {
+            continue;
+        }
+        const std::string& directive = fields[0];
+        std::vector<std::string> values(fields.begin() + 1, fields.end());
+        if (directive == "language") {
+            if (values.size() != 1) {
+                return fail("language takes one name");
+            }
+            name = values[0];
+            continue;
+        }
+        if (directive == "extensions" || directive == "filenames" || directive == "interpreters") {
+            auto& list = directive == "extensions" ? extensions
+                       : directive == "filenames" ? filenames : interpreters;
+            list.insert(list.end(), values.begin(), values.end());
+            continue;
+        }
+
+        GrammarRule rule;
+        if (!parseType(directive, rule.type)) {
+            return fail("unknown directive or type '" + directive + "'");
+        }
+        if (values.empty()) {
+            return fail("missing rule after '" + directive + "'");
+        }
+        std::string kind = values[0];
+        values.erase(values.begin());
+
+        if (kind == "words") {
+            for (const std::string& word : values) {
+                bool known = std::any_of(words.begin(), words.end(),
+                                         [&](const Word& w) { return w.text == word; });
+                if (!known) {
+                    words.push_back({word, rule.type});
+                }
+            }
+            continue;
+        }
+
+        // Options come after the fixed arguments
+        size_t fixed = 1;
+        if (kind == "region" || kind == "run" || kind == "word") {
+            fixed = 2;
+        } else if (kind == "pairs") {
+            fixed = std::find_if(values.begin(), values.end(), [](const std::string& v) {
+                return v == "linestart" || v == "before";
+            }) - values.begin();
+        }
+        if (values.size() < fixed || fixed == 0) {
+            return fail("too few arguments for " + kind);
+        }
+        for (size_t i = fixed; i < values.size(); i++) {
+            if (values[i] == "multiline" && kind == "region") {
+                rule.multiline = true;
+            } else if (values[i] == "escape" && kind == "region" && i + 1 < values.size() &&
+                       values[i + 1].size() == 1) {
+                rule.escape = values[++i][0];
+            } else if (values[i] == "linestart") {
+                rule.lineStart = true;
+            } else if (values[i] == "before" && i + 1 < values.size()) {
+                rule.before = values[++i];
+            } else {
+                return fail("unexpected '" + values[i] + "' in " + kind + " rule");
+            }
+        }
+
+        if (kind == "line") {
+            rule.kind = GrammarRule::Kind::Line;
+            rule.start = values[0];
+        } else if (kind == "region") {
+            rule.kind = GrammarRule::Kind::Region;
+            rule.start = values[0];
+            rule.end = values[1];
+        } else if (kind == "run" || kind == "word") {
+            rule.kind = kind == "run" ? GrammarRule::Kind::Run : GrammarRule::Kind::Word;
+            std::bitset<256> identifier;
+            parseSet("a-zA-Z0-9_", identifier);
+            if (!parseSet(values[0], rule.first) || !parseSet(values[1], rule.rest)) {
+                return fail("backwards range in " + kind + " rule");
+            }
+            rule.identifierRest = rule.rest == identifier;
+        } else if (kind == "symbols") {
+            rule.kind = GrammarRule::Kind::Symbols;
+            if (!parseSet(values[0], rule.first)) {
+                return fail("backwards range in " + kind + " rule");
+            }
+        } else if (kind == "pairs") {
+            rule.kind = GrammarRule::Kind::Pairs;
+            for (size_t i = 0; i < fixed; i++) {
+                if (values[i].size() != 2) {
+                    return fail("'" + values[i] + "' is not a pair");
+                }
+                rule.pairs += values[i];
+            }
+        } else if (kind == "brackets") {
+            rule.kind = GrammarRule::Kind::Brackets;
+            rule.brackets = values[0];
+            if (rule.brackets.size() % 2 != 0) {
+                return fail("brackets come in open and close pairs");
+            }
+        } else {
+            return fail("unknown rule '" + kind + "'");
+        }
+        if ((rule.kind == GrammarRule::Kind::Line || rule.kind == GrammarRule::Kind::Region) &&
+            (rule.start.empty() || (rule.kind == GrammarRule::Kind::Region && rule.end.empty()))) {
+            return fail("empty delimiter");
+        }
+        rules.push_back(std::move(rule));
+    }
+    if (name.empty()) {
+        return fail("no language name");
+    }
+    if (rules.size() >= UINT16_MAX) {
+        return fail("too many rules");
+    }
+
+    // The dispatch table: for every byte, the rules that can start there
+    for (int c = 0; c < 256; c++) {
+        firstCandidate[c] = candidates.size();
+        for (size_t r = 0; r < rules.size(); r++) {
+            const GrammarRule& rule = rules[r];
+            bool starts = false;
+            switch (rule.kind) {
+                case GrammarRule::Kind::Line:
+                case GrammarRule::Kind::Region:
+                    starts = static_cast<unsigned char>(rule.start[0]) == c;
+                    break;
+                case GrammarRule::Kind::Run:
+                case GrammarRule::Kind::Word:
+                case GrammarRule::Kind::Symbols:
+                    starts = rule.first.test(c);
+                    break;
+                case GrammarRule::Kind::Pairs:
+                    for (size_t i = 0; i < rule.pairs.size(); i += 2) {
+                        starts = starts || static_cast<unsigned char>(rule.pairs[i]) == c;
+                    }
+                    break;
+                case GrammarRule::Kind::Brackets:
+                    starts = rule.brackets.find(static_cast<char>(c)) != std::string::npos;
+                    break;
+            }
+            if (starts) {
+                candidates.push_back(r);
+            }
+        }
+    }
+    firstCandidate[256] = candidates.size();
+
+    if (!buildWordTable()) {
+        return fail("no perfect hash for the word list");
+    }
+    return true;
+}
+
+bool Grammar::lookupWord(std::string_view word, TokenType& type) const {
+    if (word.size() < shortestWord || word.size() > longestWord) {
+        return false;
+    }
+    uint16_t slot = slots[(hashWord(word) * seed) >> shift];
+    if (slot == 0 || words[slot - 1].text != word) {
+        return false;
+    }
+    type = words[slot - 1].type;
+    return true;
+}
+
+// Tries multipliers until every word hashes to a slot of its own, with
+// a table sparse enough that one turns up quickly
+bool Grammar::buildWordTable() {
+    if (words.empty()) {
+        shortestWord = 1;
+        longestWord = 0;
+        return true;
+    }
+    shortestWord = SIZE_MAX;
+    std::vector<uint64_t> hashes;
+    for (const Word& word : words) {
+        shortestWord = std::min(shortestWord, word.text.size());
+        longestWord = std::max(longestWord, word.text.size());
+        hashes.push_back(hashWord(word.text));
+    }
+    int bits = 4;
+    while ((size_t(1) << bits) < words.size() * 8) {
+        bits++;
+    }
+    uint64_t candidate = 0x9e3779b97f4a7c15;
+    for (; bits <= 20; bits++) {
+        for (int attempt = 0; attempt < 1000; attempt++) {
+            candidate = (candidate * 6364136223846793005 + 1442695040888963407) | 1;
+            slots.assign(size_t(1) << bits, 0);
+            bool collided = false;
+            for (size_t i = 0; i < hashes.size() && !collided; i++) {
+                uint16_t& slot = slots[(hashes[i] * candidate) >> (64 - bits)];
+                collided = slot != 0;
+                slot = i + 1;
+            }
+            if (!collided) {
+                seed = candidate;
+                shift = 64 - bits;
+                return true;
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,108 @@
+#include "GrammarRegistry.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+GrammarRegistry::GrammarRegistry() {
+    for (std::string_view source : builtinGrammars()) {
+        std::string error;
+        // Built-in grammars are covered by the tests, so this never fails
+        load(source, error);
+    }
+}
+
+bool GrammarRegistry::load(std::string_view source, std::string& error) {
+    auto grammar = std::make_unique<Grammar>();
+    if (!grammar->compile(source, error)) {
+        return false;
+    }
+    const Grammar* added = grammar.get();
+    names[added->name] = added;
+    for (const std::string& extension : added->extensions) {
+        extensions[extension] = added;
+    }
+    for (const std::string& filename : added->filenames) {
+        filenames[filename] = added;
+    }
+    for (const std::string& interpreter : added->interpreters) {
+        interpreters[interpreter] = added;
+    }
+    grammars.push_back(std::move(grammar));
+    return true;
+}
+
+bool GrammarRegistry::loadDirectory(const std::string& dir, std::string& error) {
+    std::error_code ec;
+    if (!std::filesystem::is_directory(dir, ec)) {
+        return true;
+    }
+    for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+        if (entry.path().extension() != ".grammar") {
+            continue;
+        }
+        std::ifstream in(entry.path());
+        std::stringstream source;
+        source << in.rdbuf();
+        if (!in || !load(source.str(), error)) {
+            error = entry.path().string() + ": " + (in ? error : "could not be read");
+            return false;
+        }
+    }
+    if (ec) {
+        error = dir + ": " + ec.message();
+        return false;
+    }
+    return true;
+}
+
+const Grammar* GrammarRegistry::forFile(std::string_view filename, std::string_view firstLine) const {
+    std::string_view base = filename.substr(filename.rfind('/') + 1);
+    if (const Grammar* grammar = find(filenames, base)) {
+        return grammar;
+    }
+    size_t dot = base.rfind('.');
+    if (dot != std::string_view::npos) {
+        if (const Grammar* grammar = find(extensions, base.substr(dot + 1))) {
+            return grammar;
+        }
+    }
+
+    // #!/bin/sh, #!/usr/bin/env python3 -u and the like
+    if (!firstLine.starts_with("#!")) {
+        return nullptr;
+    }
+    std::istringstream words{std::string(firstLine.substr(2))};
+    std::string word;
+    std::string interpreter;
+    while (words >> word) {
+        word = word.substr(word.rfind('/') + 1);
+        if (interpreter.empty() && word == "env") {
+            interpreter = word;
+            continue;
+        }
+        if (interpreter == "env" && word[0] == '-') {
+            continue;
+        }
+        interpreter = word;
+        break;
+    }
+    if (const Grammar* grammar = find(interpreters, interpreter)) {
+        return grammar;
+    }
+    // python3.12 falls back to python
+    size_t version = interpreter.find_last_not_of("0123456789.");
+    if (version != std::string::npos) {
+        return find(interpreters, std::string_view(interpreter).substr(0, version + 1));
+    }
+    return nullptr;
+}
+
+const Grammar* GrammarRegistry::byName(std::string_view name) const {
+    return find(names, name);
+}
+
+const Grammar* GrammarRegistry::find(const std::unordered_map<std::string, const Grammar*>& map,
+                                     std::string_view key) {
+    auto it = map.find(std::string(key));
+    return it == map.end() ? nullptr : it->second;
+}
@@ -0,0 +1,193 @@
+#include "HighlightCache.h"
+#include <algorithm>
+
+HighlightCache::HighlightCache(const TextBuffer& textBuffer)
+    : textBuffer(textBuffer), firstStale(0), jobLast(-1), guessFirst(0) {
+    clear();
+}
+
+void HighlightCache::onInsert(size_t offset, std::string_view text) {
+    // Whatever the worker is doing refers to the old line numbers
+    if (jobLast >= 0) {
+        worker.cancel();
+        jobLast = -1;
+    }
+    int y = textBuffer.lineAt(offset);
+    if (y >= static_cast<int>(lines.size())) {
+        return;
+    }
+    // Shifting every cached line below would cost the whole prefix per
+    // edit; they are dropped instead and lexed again as they are needed
+    if (std::find(text.begin(), text.end(), '\n') != text.end()) {
+        lines.resize(y + 1);
+    }
+    markStale(y);
+}
+
+void HighlightCache::onErase(size_t offset, std::string_view removed) {
+    if (jobLast >= 0) {
+        worker.cancel();
+        jobLast = -1;
+    }
+    int y = textBuffer.lineAt(offset);
+    if (y >= static_cast<int>(lines.size())) {
+        return;
+    }
+    if (std::find(removed.begin(), removed.end(), '\n') != removed.end()) {
+        lines.resize(y + 1);
+    }
+    markStale(y);
+}
+
+bool HighlightCache::update(int first, int last, int& from, int& to) {
+    bool restyled = false;
+    int lineCount = textBuffer.lineCount();
+    last = std::min(last, lineCount - 1);
+
+    HighlightWorker::Result result;
+    while (jobLast >= 0 && worker.poll(result)) {
+        if (result.line < 0) {
+            jobLast = -1;
+        } else {
+            adopt(result.line, std::move(result.state));
+        }
+    }
+    while (firstStale < static_cast<int>(lines.size()) && !needsLexing(firstStale)) {
+        firstStale++;
+    }
+
+    if (jobLast < 0) {
+        // Close to the viewport the UI thread catches up by itself
+        int budget = InlineLines;
+        while (firstStale <= last && firstStale >= first - InlineLines && budget-- > 0) {
+            if (firstStale >= first) {
+                report(firstStale, restyled, from, to);
+            }
+            lexLine(firstStale);
+            while (firstStale < static_cast<int>(lines.size()) && !needsLexing(firstStale)) {
+                firstStale++;
+            }
+        }
+        int target = std::min(last + Lookahead, lineCount - 1);
+        // Cached lines on screen are passed on from the state they hold
+        // before the scan from further up gets to them; that scan then
+        // stops wherever it finds them already right
+        int start = firstStale;
+        for (int y = std::max(first, firstStale + 1); y <= last && y < static_cast<int>(lines.size()); y++) {
+            if (needsLexing(y)) {
+                start = y;
+                break;
+            }
+        }
+        if (start <= target) {
+            jobLast = target;
+            worker.start(lexer.getGrammar(), textBuffer.snapshot(), textBuffer.lineStart(start), start,
+                         lines[start].start, target);
+        }
+    }
+
+    // Lines the worker has not reached yet carry on from the line above
+    // as if its state were right, starting from the last state known
+    guessFirst = first;
+    guesses.resize(std::max(last - first + 1, 0));
+    LexerState guess = lines.back().start;
+    for (int y = first; y <= last; y++) {
+        if (y < static_cast<int>(lines.size())) {
+            Line& line = lines[y];
+            if (line.lexed && y + 1 < static_cast<int>(lines.size())) {
+                guess = lines[y + 1].start;
+                continue;
+            }
+            if (line.lexed) {
+                // The last cached line keeps no end state, so it is lexed
+                // again to find the one the lines after it start in
+                guess = line.start;
+                textBuffer.line(y, text);
+                lexer.tokenize(text, guess, guesses[y - first]);
+                continue;
+            }
+            guess = line.start;
+            textBuffer.line(y, text);
+            lexer.tokenize(text, guess, line.tokens);
+            line.lexed = true;
+        } else {
+            textBuffer.line(y, text);
+            lexer.tokenize(text, guess, guesses[y - first]);
+        }
+        report(y, restyled, from, to);
+    }
+    return restyled;
+}
+
+const std::vector<Token>& HighlightCache::tokens(int y) const {
+    if (y < static_cast<int>(lines.size())) {
+        return lines[y].tokens;
+    }
+    return guesses[y - guessFirst];
+}
+
+bool HighlightCache::busy() const {
+    return jobLast >= 0;
+}
+
+void HighlightCache::clear() {
+    worker.cancel();
+    jobLast = -1;
+    lines.assign(1, Line());
+    firstStale = 0;
+    guesses.clear();
+}
+
+void HighlightCache::setGrammar(const Grammar* grammar) {
+    if (grammar != lexer.getGrammar()) {
+        clear();
+        lexer.setGrammar(grammar);
+    }
+}
+
+void HighlightCache::markStale(int y) {
+    lines[y].stale = true;
+    lines[y].lexed = false;
+    firstStale = std::min(firstStale, y);
+}
+
+bool HighlightCache::needsLexing(int y) const {
+    // The last cached line is lexed again if lines appeared after it
+    return lines[y].stale || (y + 1 == static_cast<int>(lines.size()) && y + 1 < textBuffer.lineCount());
+}
+
+void HighlightCache::lexLine(int y) {
+    LexerState state = lines[y].start;
+    textBuffer.line(y, text);
+    lexer.tokenize(text, state, lines[y].tokens);
+    lines[y].lexed = true;
+    adopt(y + 1, std::move(state));
+}
+
+void HighlightCache::adopt(int y, LexerState&& state) {
+    // y - 1 has passed its end state on, so y starts where it should
+    lines[y - 1].stale = false;
+    if (firstStale == y - 1) {
+        firstStale = y;
+    }
+    if (y >= textBuffer.lineCount()) {
+        return;
+    }
+    if (y == static_cast<int>(lines.size())) {
+        lines.push_back({std::move(state), {}, true, false});
+    } else if (!(lines[y].start == state)) {
+        lines[y].start = std::move(state);
+        lines[y].stale = true;
+        lines[y].lexed = false;
+    } else if (!lines[y].stale && jobLast >= 0) {
+        // Everything from here on was already right
+        worker.cancel();
+        jobLast = -1;
+    }
+}
+
+void HighlightCache::report(int y, bool& restyled, int& from, int& to) {
+    from = restyled ? std::min(from, y) : y;
+    to = restyled ? std::max(to, y) : y;
+    restyled = true;
+}
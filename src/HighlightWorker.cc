@@ -0,0 +1,133 @@
+#include "HighlightWorker.h"
+#include <chrono>
+#include <cstring>
+#include <string>
+
+HighlightWorker::HighlightWorker() : ring(Capacity), head(0), tail(0), generation(0), stopping(false) {}
+
+HighlightWorker::~HighlightWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        generation++;
+    }
+    wake.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void HighlightWorker::start(const Grammar* grammar, std::shared_ptr<const TextSnapshot> snapshot,
+                            size_t offset, int line, const LexerState& state, int last) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        generation++;
+        pending = Job{grammar, std::move(snapshot), offset, line, state, last};
+        if (!thread.joinable()) {
+            thread = std::thread(&HighlightWorker::run, this);
+        }
+    }
+    wake.notify_one();
+}
+
+void HighlightWorker::cancel() {
+    std::lock_guard<std::mutex> lock(mutex);
+    generation++;
+    pending.reset();
+}
+
+bool HighlightWorker::poll(Result& result) {
+    unsigned current = generation.load(std::memory_order_relaxed);
+    size_t read = tail.load(std::memory_order_relaxed);
+    while (read != head.load(std::memory_order_acquire)) {
+        Result& slot = ring[read % Capacity];
+        bool wanted = slot.generation == current;
+        if (wanted) {
+            result = std::move(slot);
+        }
+        tail.store(++read, std::memory_order_release);
+        if (wanted) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void HighlightWorker::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return stopping || pending; });
+        if (stopping) {
+            return;
+        }
+        Job job = std::move(*pending);
+        pending.reset();
+        unsigned gen = generation.load();
+        lock.unlock();
+
+        lex(job, gen);
+
+        lock.lock();
+    }
+}
+
+void HighlightWorker::lex(Job& job, unsigned gen) {
+    int y = job.line;
+    bool stopped = false;
+    std::string line;
+    std::vector<Token> tokens;
+    lexer.setGrammar(job.grammar);
+    auto finishLine = [&] {
+        lexer.tokenize(line, job.state, tokens);
+        line.clear();
+        if (!publish(gen, ++y, job.state) || y > job.last) {
+            stopped = true;
+        }
+    };
+
+    // Starts at the chunk holding the first line and walks on from there
+    size_t total = job.snapshot->length();
+    size_t position = job.offset;
+    while (!stopped && position < total) {
+        size_t chunkStart;
+        std::string_view chunk = job.snapshot->chunkAt(position, chunkStart);
+        const char* p = chunk.data() + (position - chunkStart);
+        const char* end = chunk.data() + chunk.size();
+        position = chunkStart + chunk.size();
+        while (!stopped && p < end) {
+            const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+            if (!newline) {
+                line.append(p, end);
+                break;
+            }
+            line.append(p, newline);
+            p = newline + 1;
+            finishLine();
+        }
+    }
+    // The last line has no '\n' after it
+    if (!stopped) {
+        finishLine();
+    }
+    publish(gen, -1, job.state);
+}
+
+bool HighlightWorker::publish(unsigned gen, int line, const LexerState& state) {
+    size_t write = head.load(std::memory_order_relaxed);
+    // Wait for the UI thread to make room
+    while (write - tail.load(std::memory_order_acquire) == Capacity) {
+        if (generation.load(std::memory_order_relaxed) != gen) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (generation.load(std::memory_order_relaxed) != gen) {
+        return false;
+    }
+    Result& slot = ring[write % Capacity];
+    slot.generation = gen;
+    slot.line = line;
+    slot.state = state;
+    head.store(write + 1, std::memory_order_release);
+    return true;
+}
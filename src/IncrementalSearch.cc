@@ -0,0 +1,196 @@
+#include "IncrementalSearch.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+bool matchesAt(const TextSnapshot& text, size_t offset, std::string_view needle) {
+    if (offset + needle.size() > text.length()) {
+        return false;
+    }
+    while (!needle.empty()) {
+        size_t chunkStart;
+        std::string_view chunk = text.chunkAt(offset, chunkStart);
+        size_t n = std::min(needle.size(), chunk.size() - (offset - chunkStart));
+        if (std::memcmp(chunk.data() + (offset - chunkStart), needle.data(), n) != 0) {
+            return false;
+        }
+        needle.remove_prefix(n);
+        offset += n;
+    }
+    return true;
+}
+
+}
+
+IncrementalSearch::IncrementalSearch() : generation(0), running(false), stopping(false) {}
+
+IncrementalSearch::~IncrementalSearch() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        generation++;
+    }
+    wake.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+unsigned IncrementalSearch::start(const Regex& pattern, std::shared_ptr<const TextSnapshot> snapshot,
+                                  size_t origin, bool backward) {
+    unsigned gen;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        gen = ++generation;
+        pending = Job{pattern, std::move(snapshot), origin, backward};
+        ready.reset();
+        if (!thread.joinable()) {
+            thread = std::thread(&IncrementalSearch::run, this);
+        }
+    }
+    wake.notify_one();
+    return gen;
+}
+
+void IncrementalSearch::cancel() {
+    std::lock_guard<std::mutex> lock(mutex);
+    generation++;
+    pending.reset();
+    ready.reset();
+}
+
+bool IncrementalSearch::poll(Result& result) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!ready || ready->generation != generation.load()) {
+        return false;
+    }
+    result = *ready;
+    ready.reset();
+    return true;
+}
+
+bool IncrementalSearch::busy() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return running || pending.has_value();
+}
+
+void IncrementalSearch::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        running = false;
+        wake.wait(lock, [this] { return stopping || pending; });
+        if (stopping) {
+            return;
+        }
+        Job job = std::move(*pending);
+        pending.reset();
+        running = true;
+        unsigned gen = generation.load();
+        lock.unlock();
+
+        search(job, gen);
+
+        lock.lock();
+    }
+}
+
+// Forward, the starts after origin and then those up to it; backward,
+// the starts before origin and then those from it on
+void IncrementalSearch::bounds(const Job& job, int range, size_t& first, size_t& end) {
+    size_t length = job.snapshot->length();
+    if (!job.backward) {
+        first = range == 0 ? job.origin + 1 : 0;
+        end = range == 0 ? length + 1 : job.origin + 1;
+    } else {
+        first = range == 0 ? 0 : job.origin;
+        end = range == 0 ? job.origin : length + 1;
+    }
+}
+
+void IncrementalSearch::search(Job& job, unsigned gen) {
+    const TextSnapshot& text = *job.snapshot;
+    const std::string* literal = job.pattern.literal();
+    Scan next;
+    next.snapshot = job.snapshot;
+    next.origin = job.origin;
+    next.backward = job.backward;
+    next.literal = literal ? *literal : "";
+    bool published = false;
+    auto record = [&](const RegexMatch& match) {
+        if (!published) {
+            publish(gen, true, match);
+            published = true;
+        }
+        next.hits.push_back(match.start);
+    };
+
+    Progress& progress = next.progress;
+    size_t first, end;
+    auto enter = [&](int range) {
+        progress.range = range;
+        if (!progress.done()) {
+            bounds(job, range, first, end);
+            progress.next = job.backward ? end : first;
+        }
+    };
+    enter(0);
+    bool narrowing = literal && !scan.literal.empty() && literal->starts_with(scan.literal) &&
+                     scan.snapshot == job.snapshot && scan.origin == job.origin && scan.backward == job.backward;
+    if (narrowing) {
+        // Only what matched the shorter text can match the longer one
+        for (size_t i = 0; i < scan.hits.size(); i++) {
+            if (i % 4096 == 0 && generation.load(std::memory_order_relaxed) != gen) {
+                return;
+            }
+            if (matchesAt(text, scan.hits[i], *literal)) {
+                record({scan.hits[i], scan.hits[i] + literal->size()});
+            }
+        }
+        progress = scan.progress;
+    }
+
+    while (!progress.done() && (!published || next.hits.size() < MaxHits)) {
+        if (generation.load(std::memory_order_relaxed) != gen) {
+            return;
+        }
+        bounds(job, progress.range, first, end);
+        RegexMatch match;
+        if (!job.backward) {
+            if (progress.next >= end) {
+                enter(progress.range + 1);
+                continue;
+            }
+            size_t last = std::min(end - 1, progress.next + SliceBytes - 1);
+            if (job.pattern.search(text, progress.next, last, false, match)) {
+                record(match);
+                progress.next = match.start + 1;
+            } else {
+                progress.next = last + 1;
+            }
+        } else {
+            if (progress.next <= first) {
+                enter(progress.range + 1);
+                continue;
+            }
+            size_t from = progress.next - std::min(progress.next - first, SliceBytes);
+            if (job.pattern.search(text, from, progress.next - 1, true, match)) {
+                record(match);
+                progress.next = match.start;
+            } else {
+                progress.next = from;
+            }
+        }
+    }
+    if (!published) {
+        publish(gen, false, {});
+    }
+    scan = std::move(next);
+}
+
+void IncrementalSearch::publish(unsigned gen, bool found, const RegexMatch& match) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (generation.load() == gen) {
+        ready = Result{gen, found, match};
+    }
+}
@@ -0,0 +1,248 @@
+#include "LexScanner.h"
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VM_X86 1
+#endif
+
+namespace {
+
+bool isIdentifierByte(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+size_t stringStopScalar(std::string_view text, size_t from, char quote) {
+    while (from < text.size() && text[from] != quote && text[from] != '\\') {
+        from++;
+    }
+    return from;
+}
+
+size_t identifierScalar(std::string_view text, size_t from) {
+    while (from < text.size() && isIdentifierByte(text[from])) {
+        from++;
+    }
+    return from;
+}
+
+size_t blanksScalar(std::string_view text, size_t from) {
+    while (from < text.size() && (text[from] == ' ' || text[from] == '\t')) {
+        from++;
+    }
+    return from;
+}
+
+#ifdef VM_X86
+// Each kernel builds a mask of the bytes that end the run and takes the
+// lowest set bit; whatever is left after the last full block goes to
+// the next narrower kernel. Most runs in source code are short, so the
+// AVX2 kernels hand those straight on without setting up.
+
+__attribute__((target("sse2")))
+inline __m128i load16(const char* p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+// SSE2 only compares signed bytes, so a range check shifts the range
+// down to start at -128
+__attribute__((target("sse2")))
+inline __m128i inRange16(__m128i block, char low, char count) {
+    __m128i shifted = _mm_add_epi8(block, _mm_set1_epi8(static_cast<char>(-128 - low)));
+    return _mm_cmplt_epi8(shifted, _mm_set1_epi8(static_cast<char>(-128 + count)));
+}
+
+__attribute__((target("sse2")))
+inline __m128i identifierBytes16(__m128i block) {
+    __m128i letter = inRange16(_mm_or_si128(block, _mm_set1_epi8(0x20)), 'a', 26);
+    __m128i digit = inRange16(block, '0', 10);
+    __m128i underscore = _mm_cmpeq_epi8(block, _mm_set1_epi8('_'));
+    return _mm_or_si128(_mm_or_si128(letter, digit), underscore);
+}
+
+__attribute__((target("sse2")))
+size_t stringStopSse2(std::string_view text, size_t from, char quote) {
+    const char* data = text.data();
+    const __m128i quotes = _mm_set1_epi8(quote);
+    const __m128i backslash = _mm_set1_epi8('\\');
+    size_t i = from;
+    for (; i + 16 <= text.size(); i += 16) {
+        __m128i block = load16(data + i);
+        uint32_t mask = _mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(block, quotes), _mm_cmpeq_epi8(block, backslash)));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return stringStopScalar(text, i, quote);
+}
+
+__attribute__((target("sse2")))
+size_t identifierSse2(std::string_view text, size_t from) {
+    const char* data = text.data();
+    size_t i = from;
+    for (; i + 16 <= text.size(); i += 16) {
+        uint32_t mask = ~_mm_movemask_epi8(identifierBytes16(load16(data + i))) & 0xffff;
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return identifierScalar(text, i);
+}
+
+__attribute__((target("sse2")))
+size_t blanksSse2(std::string_view text, size_t from) {
+    const char* data = text.data();
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    size_t i = from;
+    for (; i + 16 <= text.size(); i += 16) {
+        __m128i block = load16(data + i);
+        uint32_t blank = _mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(block, space), _mm_cmpeq_epi8(block, tab)));
+        uint32_t mask = ~blank & 0xffff;
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return blanksScalar(text, i);
+}
+
+__attribute__((target("avx2")))
+inline __m256i load32(const char* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+
+__attribute__((target("avx2")))
+inline __m256i inRange32(__m256i block, char low, char count) {
+    __m256i shifted = _mm256_add_epi8(block, _mm256_set1_epi8(static_cast<char>(-128 - low)));
+    return _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(-128 + count)), shifted);
+}
+
+__attribute__((target("avx2")))
+size_t stringStopAvx2(std::string_view text, size_t from, char quote) {
+    if (text.size() - from < 32) {
+        return stringStopSse2(text, from, quote);
+    }
+    const char* data = text.data();
+    const __m256i quotes = _mm256_set1_epi8(quote);
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    size_t i = from;
+    for (; i + 32 <= text.size(); i += 32) {
+        __m256i block = load32(data + i);
+        uint32_t mask = _mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(block, quotes), _mm256_cmpeq_epi8(block, backslash)));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    // The SSE2 kernels are not VEX encoded
+    _mm256_zeroupper();
+    return stringStopSse2(text, i, quote);
+}
+
+__attribute__((target("avx2")))
+size_t identifierAvx2(std::string_view text, size_t from) {
+    if (text.size() - from < 32) {
+        return identifierSse2(text, from);
+    }
+    const char* data = text.data();
+    size_t i = from;
+    for (; i + 32 <= text.size(); i += 32) {
+        __m256i block = load32(data + i);
+        __m256i letter = inRange32(_mm256_or_si256(block, _mm256_set1_epi8(0x20)), 'a', 26);
+        __m256i digit = inRange32(block, '0', 10);
+        __m256i underscore = _mm256_cmpeq_epi8(block, _mm256_set1_epi8('_'));
+        uint32_t mask = ~static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(letter, digit), underscore)));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    // The SSE2 kernels are not VEX encoded
+    _mm256_zeroupper();
+    return identifierSse2(text, i);
+}
+
+__attribute__((target("avx2")))
+size_t blanksAvx2(std::string_view text, size_t from) {
+    if (text.size() - from < 32) {
+        return blanksSse2(text, from);
+    }
+    const char* data = text.data();
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    size_t i = from;
+    for (; i + 32 <= text.size(); i += 32) {
+        __m256i block = load32(data + i);
+        uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(block, space), _mm256_cmpeq_epi8(block, tab))));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    // The SSE2 kernels are not VEX encoded
+    _mm256_zeroupper();
+    return blanksSse2(text, i);
+}
+#endif
+
+}
+
+ScanKernel bestScanKernel() {
+#ifdef VM_X86
+    static const ScanKernel best = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return ScanKernel::Avx2;
+        }
+        if (__builtin_cpu_supports("sse2")) {
+            return ScanKernel::Sse2;
+        }
+        return ScanKernel::Scalar;
+    }();
+    return best;
+#else
+    return ScanKernel::Scalar;
+#endif
+}
+
+const char* scanKernelName(ScanKernel kernel) {
+    switch (kernel) {
+        case ScanKernel::Avx2: return "avx2";
+        case ScanKernel::Sse2: return "sse2";
+        case ScanKernel::Scalar:
+        default:
+            return "scalar";
+    }
+}
+
+size_t findStringStop(ScanKernel kernel, std::string_view text, size_t from, char quote) {
+    switch (kernel) {
+#ifdef VM_X86
+        case ScanKernel::Avx2: return stringStopAvx2(text, from, quote);
+        case ScanKernel::Sse2: return stringStopSse2(text, from, quote);
+#endif
+        default: return stringStopScalar(text, from, quote);
+    }
+}
+
+size_t skipIdentifier(ScanKernel kernel, std::string_view text, size_t from) {
+    switch (kernel) {
+#ifdef VM_X86
+        case ScanKernel::Avx2: return identifierAvx2(text, from);
+        case ScanKernel::Sse2: return identifierSse2(text, from);
+#endif
+        default: return identifierScalar(text, from);
+    }
+}
+
+size_t skipBlanks(ScanKernel kernel, std::string_view text, size_t from) {
+    switch (kernel) {
+#ifdef VM_X86
+        case ScanKernel::Avx2: return blanksAvx2(text, from);
+        case ScanKernel::Sse2: return blanksSse2(text, from);
+#endif
+        default: return blanksScalar(text, from);
+    }
+}
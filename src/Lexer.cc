@@ -1,198 +1,182 @@
 #include "Lexer.h"
-#include <cctype>
 #include <algorithm>
-#include <unordered_map>
 
-Lexer::Lexer() : inMultiLineComment(false) {
-    std::vector<std::string> keywordList = {
-        "alignas", "alignof", "and", "and_eq", "asm", "atomic_cancel",
-        "atomic_commit", "atomic_noexcept", "auto", "bitand", "bitor",
-        "bool", "break", "case", "catch", "char", "char8_t", "char16_t",
-        "char32_t", "class", "compl", "concept", "const", "consteval",
-        "constexpr", "constinit", "const_cast", "continue", "co_await",
-        "co_return", "co_yield", "decltype", "default", "delete", "do",
-        "double", "dynamic_cast", "else", "enum", "explicit", "export",
-        "extern", "false", "float", "for", "friend", "goto", "if",
-        "inline", "int", "long", "mutable", "namespace", "new", "noexcept",
-        "not", "not_eq", "nullptr", "operator", "or", "or_eq", "private",
-        "protected", "public", "reflexpr", "register", "reinterpret_cast",
-        "requires", "return", "short", "signed", "sizeof", "static",
-        "static_assert", "static_cast", "struct", "switch", "synchronized",
-        "template", "this", "thread_local", "throw", "true", "try",
-        "typedef", "typeid", "typename", "union", "unsigned", "using",
-        "virtual", "void", "volatile", "wchar_t", "while", "xor",
-        "xor_eq"
-    };
-    keywords.insert(keywordList.begin(), keywordList.end());
-}
+Lexer::Lexer() : Lexer(nullptr) {}
 
-bool Lexer::isKeyword(const std::string& word) {
-    return keywords.find(word) != keywords.end();
-}
+Lexer::Lexer(const Grammar* grammar) : Lexer(grammar, bestScanKernel()) {}
 
-bool Lexer::isIdentifierChar(char c) {
-    return std::isalnum(c) || c == '_';
-}
+Lexer::Lexer(const Grammar* grammar, ScanKernel kernel) : grammar(grammar), kernel(kernel) {}
 
-bool Lexer::isOperatorChar(char c) {
-    std::string operators = "+-*/%=<>!&|^~?:.";
-    return operators.find(c) != std::string::npos;
+void Lexer::setGrammar(const Grammar* newGrammar) {
+    grammar = newGrammar;
 }
 
-bool Lexer::isPunctuationChar(char c) {
-    std::string punctuation = "();{}[],";
-    return punctuation.find(c) != std::string::npos;
+const Grammar* Lexer::getGrammar() const {
+    return grammar;
 }
 
-std::vector<Token> Lexer::tokenize(const std::string& line) {
-    std::vector<Token> tokens;
-    int i = 0;
+// Index just past the region's end delimiter, or -1 when the line ends
+// first
+int Lexer::regionEnd(const GrammarRule& rule, std::string_view line, int from) const {
     int length = line.length();
-
+    if (!rule.escape) {
+        size_t end = line.find(rule.end, from);
+        return end == std::string_view::npos ? -1 : end + rule.end.size();
+    }
+    int i = from;
     while (i < length) {
-        if (inMultiLineComment) {
-            size_t endComment = line.find("*/", i);
-            if (endComment != std::string::npos) {
-                std::string comment = line.substr(i, endComment + 2 - i);
-                tokens.emplace_back(TokenType::Comment, comment, i);
-                i = endComment + 2;
-                inMultiLineComment = false;
-            }
-            else {
-                std::string comment = line.substr(i);
-                tokens.emplace_back(TokenType::Comment, comment, i);
-                break; 
-            }
-        }
-        else if (line.compare(i, 2, "//") == 0) {
-            std::string comment = line.substr(i);
-            tokens.emplace_back(TokenType::Comment, comment, i);
-            break; 
-        }
-        else if (line.compare(i, 2, "/*") == 0) {
-            size_t endComment = line.find("*/", i + 2);
-            if (endComment != std::string::npos) {
-                std::string comment = line.substr(i, endComment + 2 - i);
-                tokens.emplace_back(TokenType::Comment, comment, i);
-                i = endComment + 2;
-            }
-            else {
-                std::string comment = line.substr(i);
-                tokens.emplace_back(TokenType::Comment, comment, i);
-                inMultiLineComment = true;
-                break; 
-            }
-        }
-        else if (line[i] == '"' || line[i] == '\'') {
-            char quote = line[i];
-            int start = i;
-            i++; 
-            bool escape = false;
-            while (i < length) {
-                if (line[i] == '\\' && !escape) {
-                    escape = true;
-                }
-                else if (line[i] == quote && !escape) {
-                    i++; 
-                    break;
-                }
-                else {
-                    escape = false;
-                }
-                i++;
-            }
-            std::string literal = line.substr(start, i - start);
-            TokenType type = (quote == '"') ? TokenType::StringLiteral : TokenType::StringLiteral; // Treat char literals as string literals for highlighting
-            tokens.emplace_back(type, literal, start);
-        }
-        else if (line[i] == '#') {
-            int start = i;
-            while (i < length && line[i] != '\n') {
+        if (rule.escape == '\\' && rule.end.size() == 1) {
+            i = findStringStop(kernel, line, i, rule.end[0]);
+        } else {
+            while (i < length && line[i] != rule.escape && line[i] != rule.end[0]) {
                 i++;
             }
-            std::string directive = line.substr(start, i - start);
-            tokens.emplace_back(TokenType::PreprocessorDirective, directive, start);
         }
-        else if (std::isdigit(line[i])) {
-            int start = i;
-            while (i < length && (std::isdigit(line[i]) || line[i] == '.' || line[i] == 'x' || line[i] == 'X')) {
-                i++;
-            }
-            std::string number = line.substr(start, i - start);
-            tokens.emplace_back(TokenType::NumericLiteral, number, start);
+        if (i == length) {
+            break;
         }
-        else if (isOperatorChar(line[i])) {
-            int start = i;
-            if (i + 1 < length) {
-                std::string op = line.substr(i, 2);
-                static std::unordered_set<std::string> multiCharOps = {
-                    "==", "!=", "<=", ">=", "++", "--", "&&", "||", "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=", "->", "::"
-                };
-                if (multiCharOps.find(op) != multiCharOps.end()) {
-                    tokens.emplace_back(TokenType::Operator, op, start);
-                    i += 2;
-                    continue;
-                }
-            }
-            tokens.emplace_back(TokenType::Operator, std::string(1, line[i]), i);
+        if (line[i] == rule.escape) {
+            // An escape takes the next character with it
+            i = std::min(i + 2, length);
+        } else if (line.compare(i, rule.end.size(), rule.end) == 0) {
+            return i + rule.end.size();
+        } else {
             i++;
         }
-        else if (isPunctuationChar(line[i])) {
-            std::string punct(1, line[i]);
+    }
+    return -1;
+}
 
-            static std::unordered_map<char, char> matchingDelimiters = {
-                {'}', '{'},
-                {']', '['},
-                {')', '('}
-            };
+int Lexer::runEnd(const GrammarRule& rule, std::string_view line, int from) const {
+    if (rule.identifierRest) {
+        return skipIdentifier(kernel, line, from);
+    }
+    int length = line.length();
+    while (from < length && rule.rest.test(static_cast<unsigned char>(line[from]))) {
+        from++;
+    }
+    return from;
+}
 
-            if (line[i] == '{' || line[i] == '[' || line[i] == '(') {
-                delimiterStack.push(line[i]);
-                tokens.emplace_back(TokenType::Punctuation, punct, i);
-            }
-            else if (line[i] == '}' || line[i] == ']' || line[i] == ')') {
-                if (!delimiterStack.empty() && delimiterStack.top() == matchingDelimiters[line[i]]) {
-                    delimiterStack.pop();
-                    tokens.emplace_back(TokenType::Punctuation, punct, i);
-                }
-                else {
-                    tokens.emplace_back(TokenType::MismatchedBrace, punct, i); 
-                }
-            }
-            else {
-                tokens.emplace_back(TokenType::Punctuation, punct, i);
-            }
-            i++;
+void Lexer::tokenize(std::string_view line, LexerState& state, std::vector<Token>& tokens) {
+    tokens.clear();
+    int i = 0;
+    int length = line.length();
+    if (!grammar) {
+        if (length > 0) {
+            tokens.emplace_back(TokenType::PlainText, 0, length);
         }
-        else if (std::isalpha(line[i]) || line[i] == '_') {
-            int start = i;
-            while (i < length && isIdentifierChar(line[i])) {
-                i++;
+        return;
+    }
+
+    // A region left open on the line above goes on until its end
+    if (state.region) {
+        const GrammarRule& rule = grammar->rules[state.region - 1];
+        int end = regionEnd(rule, line, 0);
+        if (end < 0) {
+            if (length > 0) {
+                tokens.emplace_back(rule.type, 0, length);
             }
-            std::string word = line.substr(start, i - start);
-            bool isKw = isKeyword(word);
+            return;
+        }
+        tokens.emplace_back(rule.type, 0, end);
+        i = end;
+        state.region = 0;
+    }
+
+    // Held locally so appending a token does not make them reload
+    const uint16_t* firstCandidate = grammar->firstCandidate.data();
+    const uint16_t* candidates = grammar->candidates.data();
+    const GrammarRule* rules = grammar->rules.data();
+    bool lineStart = i == 0;
+    while (i < length) {
+        unsigned char c = line[i];
+        TokenType type = TokenType::PlainText;
+        int end = -1;
+        uint16_t openRegion = 0;
+        bool openBracket = false;
+        bool closeBracket = false;
 
-            if (isKw) {
-                if (word == "typename" || word == "concept") {
-                    if (!delimiterStack.empty() && delimiterStack.top() == '<') {
-                        tokens.emplace_back(TokenType::Keyword, word, start);
+        for (int k = firstCandidate[c]; k < firstCandidate[c + 1]; k++) {
+            uint16_t r = candidates[k];
+            const GrammarRule& rule = rules[r];
+            if (rule.lineStart && !lineStart) {
+                continue;
+            }
+            type = rule.type;
+            openRegion = 0;
+            openBracket = closeBracket = false;
+            switch (rule.kind) {
+                case GrammarRule::Kind::Line:
+                    if (line.compare(i, rule.start.size(), rule.start) == 0) {
+                        end = length;
+                    }
+                    break;
+                case GrammarRule::Kind::Region:
+                    if (line.compare(i, rule.start.size(), rule.start) == 0) {
+                        end = regionEnd(rule, line, i + rule.start.size());
+                        if (end < 0) {
+                            end = length;
+                            openRegion = rule.multiline ? r + 1 : 0;
+                        }
+                    }
+                    break;
+                case GrammarRule::Kind::Run:
+                    end = runEnd(rule, line, i + 1);
+                    break;
+                case GrammarRule::Kind::Word:
+                    end = runEnd(rule, line, i + 1);
+                    grammar->lookupWord(line.substr(i, end - i), type);
+                    break;
+                case GrammarRule::Kind::Symbols:
+                    end = i + 1;
+                    break;
+                case GrammarRule::Kind::Pairs:
+                    for (size_t p = 0; i + 1 < length && p < rule.pairs.size(); p += 2) {
+                        if (rule.pairs[p] == line[i] && rule.pairs[p + 1] == line[i + 1]) {
+                            end = i + 2;
+                            break;
+                        }
                     }
-                    else {
-                        tokens.emplace_back(TokenType::Identifier, word, start);
+                    break;
+                case GrammarRule::Kind::Brackets: {
+                    size_t at = rule.brackets.find(c);
+                    end = i + 1;
+                    if (at % 2 == 0) {
+                        openBracket = true;
+                    } else if (!state.delimiters.empty() && state.delimiters.back() == rule.brackets[at - 1]) {
+                        closeBracket = true;
+                    } else {
+                        type = TokenType::MismatchedBrace;
                     }
+                    break;
                 }
-                else {
-                    tokens.emplace_back(TokenType::Keyword, word, start);
+            }
+            if (end >= 0 && !rule.before.empty()) {
+                int next = skipBlanks(kernel, line, end);
+                if (line.compare(next, rule.before.size(), rule.before) != 0) {
+                    end = -1;
                 }
             }
-            else {
-                tokens.emplace_back(TokenType::Identifier, word, start);
+            if (end >= 0) {
+                break;
             }
         }
-        else {
-            tokens.emplace_back(TokenType::PlainText, std::string(1, line[i]), i);
-            i++;
+
+        if (end < 0) {
+            type = TokenType::PlainText;
+            end = c == ' ' || c == '\t' ? skipBlanks(kernel, line, i) : i + 1;
+        } else if (openRegion) {
+            state.region = openRegion;
+        } else if (openBracket) {
+            state.delimiters.push_back(c);
+        } else if (closeBracket) {
+            state.delimiters.pop_back();
+        }
+        if (c != ' ' && c != '\t') {
+            lineStart = false;
         }
+        tokens.emplace_back(type, i, end - i);
+        i = end;
     }
-    return tokens;
 }
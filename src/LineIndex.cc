@@ -0,0 +1,121 @@
+#include "LineIndex.h"
+#include "NewlineScanner.h"
+#include <algorithm>
+
+LineIndex::LineIndex()
+    : data(nullptr), size(0), workerCount(1), nextChunk(0), chunksReady(0), done(true), cancelled(false) {}
+
+LineIndex::~LineIndex() {
+    stop();
+}
+
+void LineIndex::build(const char* text, size_t length, unsigned workers) {
+    stop();
+    data = text;
+    size = length;
+    size_t count = (size + ChunkSize - 1) / ChunkSize;
+    if (workers == 0) {
+        workers = size < ParallelThreshold ? 1 : std::max(1u, std::thread::hardware_concurrency());
+    }
+    workerCount = static_cast<unsigned>(std::min<size_t>(workers, std::max<size_t>(count, 1)));
+    chunks.assign(count, {});
+    finished = std::make_unique<bool[]>(count);
+    firstLine.assign(count + 1, 0);
+    nextChunk.store(0);
+    chunksReady.store(0);
+    done.store(false);
+    cancelled.store(false);
+    coordinator = std::thread(&LineIndex::run, this);
+}
+
+size_t LineIndex::ready() const {
+    return firstLine.empty() ? 0 : firstLine[chunksReady.load(std::memory_order_acquire)];
+}
+
+size_t LineIndex::at(size_t i) const {
+    size_t published = chunksReady.load(std::memory_order_acquire);
+    // Last chunk whose first newline is at or before i
+    auto next = std::upper_bound(firstLine.begin(), firstLine.begin() + published, i);
+    size_t chunk = (next - firstLine.begin()) - 1;
+    return chunks[chunk][i - firstLine[chunk]];
+}
+
+bool LineIndex::complete() const {
+    return done.load(std::memory_order_acquire);
+}
+
+void LineIndex::waitFor(size_t count) {
+    std::unique_lock<std::mutex> lock(mutex);
+    progress.wait(lock, [this, count] { return complete() || ready() >= count; });
+}
+
+std::vector<size_t> LineIndex::take() {
+    if (coordinator.joinable()) {
+        coordinator.join();
+    }
+    // The first chunk grows into the whole list and each later one is
+    // freed as soon as it is copied in, so no more than one chunk is ever
+    // held twice; the pages reserved are only touched as they fill
+    std::vector<size_t> all;
+    if (!cancelled.load(std::memory_order_relaxed) && !chunks.empty()) {
+        all = std::move(chunks[0]);
+        all.reserve(firstLine.back());
+        for (size_t i = 1; i < chunks.size(); i++) {
+            all.insert(all.end(), chunks[i].begin(), chunks[i].end());
+            std::vector<size_t>().swap(chunks[i]);
+        }
+    }
+    chunks.clear();
+    firstLine.clear();
+    chunksReady.store(0);
+    return all;
+}
+
+void LineIndex::run() {
+    std::vector<std::thread> helpers;
+    for (unsigned i = 1; i < workerCount; i++) {
+        helpers.emplace_back(&LineIndex::work, this);
+    }
+    work();
+    for (std::thread& helper : helpers) {
+        helper.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done.store(true, std::memory_order_release);
+    }
+    progress.notify_all();
+}
+
+void LineIndex::work() {
+    while (!cancelled.load(std::memory_order_relaxed)) {
+        size_t chunk = nextChunk.fetch_add(1);
+        if (chunk >= chunks.size()) {
+            return;
+        }
+        size_t start = chunk * ChunkSize;
+        scanNewlines(data + start, std::min(ChunkSize, size - start), start, chunks[chunk]);
+
+        // Publish this chunk and any finished ones after it once
+        // everything before them is in
+        std::lock_guard<std::mutex> lock(mutex);
+        finished[chunk] = true;
+        size_t published = chunksReady.load(std::memory_order_relaxed);
+        if (published != chunk) {
+            continue;
+        }
+        while (published < chunks.size() && finished[published]) {
+            firstLine[published + 1] = firstLine[published] + chunks[published].size();
+            published++;
+        }
+        chunksReady.store(published, std::memory_order_release);
+        progress.notify_all();
+    }
+}
+
+void LineIndex::stop() {
+    cancelled.store(true);
+    if (coordinator.joinable()) {
+        coordinator.join();
+    }
+}
@@ -0,0 +1,57 @@
+#include "LineMarks.h"
+#include <algorithm>
+
+LineMarks::LineMarks(const TextBuffer& textBuffer, std::vector<int> lines)
+    : textBuffer(textBuffer), lines(std::move(lines)), dropped(this->lines.size(), false), ahead(0), shift(0) {
+}
+
+bool LineMarks::next(int& line) {
+    while (ahead < lines.size()) {
+        size_t i = ahead++;
+        if (!dropped[i]) {
+            line = lines[i] + shift;
+            return true;
+        }
+    }
+    return false;
+}
+
+void LineMarks::onInsert(size_t offset, std::string_view text) {
+    int added = std::count(text.begin(), text.end(), '\n');
+    if (added == 0) {
+        return;
+    }
+    // Text put in front of a line pushes that line down too
+    int y = textBuffer.lineAt(offset);
+    moveBelow(offset == textBuffer.lineStart(y) ? y - 1 : y, added);
+}
+
+void LineMarks::onErase(size_t offset, std::string_view removed) {
+    int joined = std::count(removed.begin(), removed.end(), '\n');
+    if (joined == 0) {
+        return;
+    }
+    // From the start of a line, that line and the ones after it go; from
+    // inside one, the lines joined onto it do
+    int y = textBuffer.lineAt(offset);
+    int first = offset == textBuffer.lineStart(y) ? y : y + 1;
+    int last = first + joined - 1;
+    auto from = std::lower_bound(lines.begin() + ahead, lines.end(), first - shift);
+    auto to = std::upper_bound(from, lines.end(), last - shift);
+    for (auto it = from; it != to; ++it) {
+        dropped[it - lines.begin()] = true;
+        *it = first - shift;
+    }
+    moveBelow(last, -joined);
+}
+
+void LineMarks::moveBelow(int y, int delta) {
+    auto below = std::upper_bound(lines.begin() + ahead, lines.end(), y - shift);
+    if (below == lines.begin() + ahead) {
+        shift += delta;
+        return;
+    }
+    for (auto it = below; it != lines.end(); ++it) {
+        *it += delta;
+    }
+}
@@ -0,0 +1,114 @@
+#include "LineRenderer.h"
+#include <algorithm>
+
+attr_t tokenAttributes(TokenType type) {
+    switch (type) {
+        case TokenType::Keyword: return COLOR_PAIR(6);
+        case TokenType::NumericLiteral: return COLOR_PAIR(7);
+        case TokenType::StringLiteral: return COLOR_PAIR(8);
+        case TokenType::Identifier: return COLOR_PAIR(9);
+        case TokenType::Comment: return COLOR_PAIR(10);
+        case TokenType::PreprocessorDirective: return COLOR_PAIR(11);
+        case TokenType::Operator:
+        case TokenType::Punctuation:
+            return COLOR_PAIR(12);
+        case TokenType::Type: return COLOR_PAIR(14);
+        case TokenType::Constant: return COLOR_PAIR(15);
+        case TokenType::Function: return COLOR_PAIR(16);
+        case TokenType::Variable: return COLOR_PAIR(17);
+        case TokenType::Key: return COLOR_PAIR(18);
+        case TokenType::MismatchedBrace:
+        case TokenType::MismatchedBracket:
+        case TokenType::MismatchedParenthesis:
+            return COLOR_PAIR(13) | A_BOLD;
+        case TokenType::PlainText:
+        default:
+            return COLOR_PAIR(2);
+    }
+}
+
+void LineRenderer::begin(int width) {
+    cols = width;
+    cells.clear();
+    spans.clear();
+}
+
+void LineRenderer::add(std::string_view text, attr_t attr) {
+    int length = std::min<int>(text.size(), cols - cells.size());
+    if (length <= 0) {
+        return;
+    }
+    int start = cells.size();
+    for (int i = 0; i < length; i++) {
+        // waddnstr would expand tabs and control characters to several
+        // cells and push the rest of the row out of line with the cursor
+        unsigned char c = text[i];
+        if (c == '\t') {
+            c = ' ';
+        } else if (c < 0x20 || c >= 0x7f) {
+            c = '?';
+        }
+        cells += static_cast<char>(c);
+    }
+    push(spans, attr, start, length);
+}
+
+void LineRenderer::fill(attr_t attr) {
+    int start = cells.size();
+    if (start < cols) {
+        cells.append(cols - start, ' ');
+        push(spans, attr, start, cols - start);
+    }
+}
+
+void LineRenderer::overlay(int from, int to, attr_t attr) {
+    from = std::max(from, 0);
+    to = std::min<int>(to, cells.size());
+    if (from >= to) {
+        return;
+    }
+    scratch.clear();
+    for (const AttrRun& run : spans) {
+        int end = run.start + run.length;
+        if (end <= from || run.start >= to) {
+            push(scratch, run.attr, run.start, run.length);
+            continue;
+        }
+        if (run.start < from) {
+            push(scratch, run.attr, run.start, from - run.start);
+        }
+        int overlapStart = std::max(run.start, from);
+        push(scratch, attr, overlapStart, std::min(end, to) - overlapStart);
+        if (end > to) {
+            push(scratch, run.attr, to, end - to);
+        }
+    }
+    spans.swap(scratch);
+}
+
+const std::vector<AttrRun>& LineRenderer::runs() const {
+    return spans;
+}
+
+const std::string& LineRenderer::text() const {
+    return cells;
+}
+
+int LineRenderer::draw(WINDOW* win, int row) const {
+    int calls = 0;
+    for (const AttrRun& run : spans) {
+        wattrset(win, run.attr);
+        mvwaddnstr(win, row, run.start, cells.data() + run.start, run.length);
+        calls += 2;
+    }
+    wattrset(win, A_NORMAL);
+    return calls + 1;
+}
+
+void LineRenderer::push(std::vector<AttrRun>& out, attr_t attr, int start, int length) {
+    if (!out.empty() && out.back().attr == attr && out.back().start + out.back().length == start) {
+        out.back().length += length;
+    } else {
+        out.push_back({attr, start, length});
+    }
+}
@@ -0,0 +1,84 @@
+#include "MacroRecorder.h"
+#include <cctype>
+#include <ncurses.h>
+
+MacroRecorder::MacroRecorder() : reg(0), appending(false) {
+}
+
+int MacroRecorder::slot(char reg) {
+    if (reg >= 'a' && reg <= 'z') {
+        return reg - 'a';
+    }
+    if (reg >= '0' && reg <= '9') {
+        return 26 + reg - '0';
+    }
+    return -1;
+}
+
+bool MacroRecorder::start(char reg) {
+    appending = reg >= 'A' && reg <= 'Z';
+    if (appending) {
+        reg = std::tolower(reg);
+    }
+    if (slot(reg) < 0) {
+        return false;
+    }
+    this->reg = reg;
+    recorded.clear();
+    return true;
+}
+
+void MacroRecorder::stop() {
+    if (!reg) {
+        return;
+    }
+    if (!recorded.empty() && recorded.back().kind == MacroOp::Keys) {
+        recorded.back().keys.pop_back();
+        if (recorded.back().keys.empty()) {
+            recorded.pop_back();
+        }
+    }
+    std::vector<MacroOp>& target = registers[slot(reg)];
+    if (!appending) {
+        target.clear();
+    }
+    for (MacroOp& op : recorded) {
+        // Appending may continue the text or keys the register ended with
+        if (!target.empty() && target.back().kind == op.kind) {
+            target.back().keys.insert(target.back().keys.end(), op.keys.begin(), op.keys.end());
+            target.back().text += op.text;
+        } else {
+            target.push_back(std::move(op));
+        }
+    }
+    recorded.clear();
+    reg = 0;
+}
+
+bool MacroRecorder::recording() const {
+    return reg != 0;
+}
+
+char MacroRecorder::recordingRegister() const {
+    return reg;
+}
+
+void MacroRecorder::record(int ch, bool inserting) {
+    if (inserting && ch == KEY_ENTER) {
+        ch = '\n';
+    }
+    MacroOp::Kind kind = inserting && (ch == '\n' || (ch < 256 && std::isprint(ch))) ? MacroOp::Text : MacroOp::Keys;
+    if (recorded.empty() || recorded.back().kind != kind) {
+        recorded.push_back(MacroOp{kind, {}, {}});
+    }
+    if (kind == MacroOp::Text) {
+        recorded.back().text += static_cast<char>(ch);
+    } else {
+        recorded.back().keys.push_back(ch);
+    }
+}
+
+const std::vector<MacroOp>* MacroRecorder::ops(char reg) const {
+    int i = slot(reg);
+    return i < 0 ? nullptr : &registers[i];
+}
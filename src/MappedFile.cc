@@ -0,0 +1,49 @@
+#include "MappedFile.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile() : address(nullptr), length(0) {}
+
+MappedFile::~MappedFile() {
+    if (address) {
+        munmap(address, length);
+    }
+}
+
+bool MappedFile::open(const std::string& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return false;
+    }
+
+    // mmap rejects zero-length mappings, an empty file is simply no data
+    length = static_cast<size_t>(info.st_size);
+    if (length > 0) {
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            close(fd);
+            length = 0;
+            return false;
+        }
+        address = mapped;
+    }
+
+    close(fd);
+    return true;
+}
+
+const char* MappedFile::data() const {
+    return static_cast<const char*>(address);
+}
+
+size_t MappedFile::size() const {
+    return length;
+}
@@ -0,0 +1,117 @@
+#include "MatchCache.h"
+#include <algorithm>
+#include <climits>
+
+MatchCache::MatchCache(const TextBuffer& textBuffer)
+    : textBuffer(textBuffer), visibleFirst(0), searched(0) {}
+
+void MatchCache::onInsert(size_t offset, std::string_view text) {
+    int y = textBuffer.lineAt(offset);
+    int added = std::count(text.begin(), text.end(), '\n');
+    forget(pattern.spansLines() ? INT_MIN : y, y, added);
+}
+
+void MatchCache::onErase(size_t offset, std::string_view removed) {
+    int y = textBuffer.lineAt(offset);
+    int joined = std::count(removed.begin(), removed.end(), '\n');
+    forget(pattern.spansLines() ? INT_MIN : y, y + joined, -joined);
+}
+
+void MatchCache::setPattern(const Regex& next) {
+    if (next.pattern() != pattern.pattern()) {
+        pattern = next;
+        lines.clear();
+    }
+}
+
+bool MatchCache::update(int first, int last, int& from, int& to) {
+    bool restyled = false;
+    last = std::min(last, textBuffer.lineCount() - 1);
+    std::vector<std::vector<MatchSpan>> next(std::max(last - first + 1, 0));
+    // The end of a match running on from a line above
+    size_t carry = 0;
+    for (int y = first; y <= last; y++) {
+        row.clear();
+        if (!pattern.empty()) {
+            size_t begin = textBuffer.lineStart(y);
+            size_t cells = textBuffer.lineLength(y) + 1; // a match over the line break shows past the end
+            if (carry > begin) {
+                row.push_back({0, static_cast<int>(std::min(carry - begin, cells))});
+            }
+            for (const Hit& hit : hits(y)) {
+                row.push_back({static_cast<int>(hit.start), static_cast<int>(std::min(hit.end, cells))});
+                carry = std::max(carry, begin + hit.end);
+            }
+        }
+        static const std::vector<MatchSpan> none;
+        int old = y - visibleFirst;
+        const std::vector<MatchSpan>& drawn =
+            old >= 0 && old < static_cast<int>(visible.size()) ? visible[old] : none;
+        bool same = drawn.size() == row.size() &&
+                    std::equal(row.begin(), row.end(), drawn.begin(), [](const MatchSpan& a, const MatchSpan& b) {
+                        return a.start == b.start && a.end == b.end;
+                    });
+        if (!same) {
+            from = restyled ? std::min(from, y) : y;
+            to = restyled ? std::max(to, y) : y;
+            restyled = true;
+        }
+        next[y - first] = row;
+    }
+    visibleFirst = first;
+    visible.swap(next);
+
+    // Far from the viewport lines are dropped rather than kept forever
+    if (lines.size() > MaxLines) {
+        int keep = MaxLines / 4;
+        lines.erase(lines.begin(), lines.lower_bound(first - keep));
+        lines.erase(lines.upper_bound(last + keep), lines.end());
+    }
+    return restyled;
+}
+
+const std::vector<MatchSpan>& MatchCache::spans(int y) const {
+    return visible[y - visibleFirst];
+}
+
+void MatchCache::clear() {
+    lines.clear();
+}
+
+unsigned long MatchCache::linesSearched() const {
+    return searched;
+}
+
+const std::vector<MatchCache::Hit>& MatchCache::hits(int y) {
+    auto [it, added] = lines.try_emplace(y);
+    if (!added) {
+        return it->second;
+    }
+    searched++;
+    size_t begin = textBuffer.lineStart(y);
+    size_t end = begin + std::min<size_t>(textBuffer.lineLength(y), MaxColumns);
+    RegexMatch match;
+    for (size_t at = begin; at <= end && pattern.search(textBuffer, at, end, false, match);) {
+        // An empty match has nothing to draw
+        if (match.end > match.start) {
+            it->second.push_back({match.start - begin, match.end - begin});
+        }
+        at = std::max(match.end, match.start + 1);
+    }
+    return it->second;
+}
+
+void MatchCache::forget(int from, int to, int delta) {
+    auto it = lines.erase(lines.lower_bound(from), lines.upper_bound(to));
+    if (delta == 0) {
+        return;
+    }
+    std::vector<decltype(lines)::node_type> moved;
+    while (it != lines.end()) {
+        moved.push_back(lines.extract(it++));
+        moved.back().key() += delta;
+    }
+    for (auto& node : moved) {
+        lines.insert(lines.end(), std::move(node));
+    }
+}
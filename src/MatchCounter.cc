@@ -0,0 +1,111 @@
+#include "MatchCounter.h"
+#include <algorithm>
+
+MatchCounter::MatchCounter() : version(0), capped(false), done(false), stopping(false), generation(0) {}
+
+MatchCounter::~MatchCounter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        generation++;
+    }
+    wake.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void MatchCounter::count(const Regex& next, std::shared_ptr<const TextSnapshot> snapshot,
+                         unsigned long textVersion) {
+    if (next.pattern() == pattern && textVersion == version) {
+        return;
+    }
+    pattern = next.pattern();
+    version = textVersion;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        generation++;
+        pending = Job{next, std::move(snapshot)};
+        done = false;
+        if (!thread.joinable()) {
+            thread = std::thread(&MatchCounter::run, this);
+        }
+    }
+    wake.notify_one();
+}
+
+void MatchCounter::cancel() {
+    pattern.clear();
+    std::lock_guard<std::mutex> lock(mutex);
+    generation++;
+    pending.reset();
+    done = false;
+}
+
+bool MatchCounter::result(size_t offset, size_t& index, size_t& total, bool& more) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!done) {
+        return false;
+    }
+    auto it = std::lower_bound(starts.begin(), starts.end(), offset);
+    index = it != starts.end() && *it == offset ? it - starts.begin() + 1 : 0;
+    total = starts.size();
+    more = capped;
+    return true;
+}
+
+bool MatchCounter::busy() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return !pattern.empty() && !done;
+}
+
+void MatchCounter::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return stopping || pending; });
+        if (stopping) {
+            return;
+        }
+        Job job = std::move(*pending);
+        pending.reset();
+        unsigned gen = generation.load();
+        lock.unlock();
+
+        scan(job, gen);
+
+        lock.lock();
+    }
+}
+
+void MatchCounter::scan(Job& job, unsigned gen) {
+    const TextSnapshot& text = *job.snapshot;
+    size_t length = text.length();
+    std::vector<size_t> found;
+    bool more = false;
+    RegexMatch match;
+    // Each match is looked for one byte after the last one starts, as n
+    // steps through them
+    for (size_t at = 0; at <= length;) {
+        if (generation.load() != gen) {
+            return;
+        }
+        size_t last = std::min(at + SliceBytes, length);
+        if (!job.pattern.search(text, at, last, false, match)) {
+            at = last + 1;
+            continue;
+        }
+        if (found.size() == MaxCount) {
+            more = true;
+            break;
+        }
+        found.push_back(match.start);
+        at = match.start + 1;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (generation.load() == gen) {
+        starts.swap(found);
+        capped = more;
+        done = true;
+    }
+}
@@ -1,21 +1,37 @@
 #include "MotionCommand.h"
 #include "Editor.h"
+#include <algorithm>
 
 MotionCommand::MotionCommand(Editor& editor, char type, int numOfTimes)
     : editor(editor), type(type), numOfTimes(numOfTimes) {
 }
 
 void MotionCommand::execute() {
+    // Counted steps along or across lines land in one move; moveCursor
+    // clamps the same way a step at a time would
+    if (type == 'h') {
+        editor.moveCursor(0, -numOfTimes);
+        return;
+    } else if (type == 'l') {
+        int room = editor.textBuffer->lineLength(editor.cursorY) - editor.cursorX;
+        editor.moveCursor(0, std::min(numOfTimes, std::max(room, 1)));
+        return;
+    } else if (type == 'j') {
+        editor.moveCursor(numOfTimes, 0);
+        return;
+    } else if (type == 'k') {
+        editor.moveCursor(-numOfTimes, 0);
+        return;
+    } else if (type == '$') {
+        editor.moveCursor(numOfTimes - 1, 0);
+        dollarSign();
+        return;
+    }
     for (int cnt = 0; cnt < numOfTimes; cnt++) {
         if (type == 'b') {
             editor.moveCursorBackWord();
         } else if (type == 'w') {
             w();
-        } else if (type == '$') {
-            if (cnt >= 1) {
-                editor.moveCursor(1, 0);
-            }
-            dollarSign();
         }
         else if (type == ('b' & 0x1F)) {
             editor.moveCursorBackwardFrame();
@@ -29,18 +45,6 @@ void MotionCommand::execute() {
         else if (type == ('f' & 0x1F)) {
             editor.moveCursorForwardFrame();
         }
-        else if (type == 'h') {
-            editor.moveCursor(0, -1);
-        }
-        else if (type == 'j') {
-            editor.moveCursor(1, 0);
-        }
-        else if (type == 'k') {
-            editor.moveCursor(-1, 0);
-        }
-        else if (type == 'l') {
-            editor.moveCursor(0, 1);
-        }
     }
 }
 
@@ -55,17 +59,11 @@ std::string MotionCommand::getType() const {
 // may also have to change it so that w moves to the start of 
 // ';', ':', '/', '\', 
 void MotionCommand::w() {
-    if (editor.textBuffer.empty()) {
-        editor.setStatusMessage("Buffer is empty.", true);
-        beep();
-        return;
-    }
-
-    int maxY = editor.textBuffer.size();
+    int maxY = editor.textBuffer->lineCount();
     bool flag = false;
     bool newLine = false;
     while (editor.cursorY < maxY && !flag) {
-        std::string& currentLine = editor.textBuffer[editor.cursorY];
+        std::string currentLine = editor.textBuffer->line(editor.cursorY);
         int lineLength = currentLine.length();
 
         int pos = editor.cursorX;
@@ -97,6 +95,5 @@ void MotionCommand::w() {
 }
 
 void MotionCommand::dollarSign() {
-    const std::string& currentLine = editor.textBuffer[editor.cursorY];
-    editor.setCursorPosition(editor.cursorY, currentLine.size() - 1);
+    editor.setCursorPosition(editor.cursorY, editor.textBuffer->lineLength(editor.cursorY) - 1);
 }
\ No newline at end of file
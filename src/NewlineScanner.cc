@@ -0,0 +1,108 @@
+#include "NewlineScanner.h"
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VM_X86 1
+#endif
+
+namespace {
+
+void scanScalar(const char* data, size_t size, size_t base, std::vector<size_t>& out) {
+    const char* end = data + size;
+    for (const char* p = data; p < end; p++) {
+        p = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (!p) {
+            break;
+        }
+        out.push_back(base + (p - data));
+    }
+}
+
+#ifdef VM_X86
+// Compare a block against '\n' and walk the set bits of the match mask
+__attribute__((target("sse2")))
+void scanSse2(const char* data, size_t size, size_t base, std::vector<size_t>& out) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline)));
+        while (mask) {
+            out.push_back(base + i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+    scanScalar(data + i, size - i, base + i, out);
+}
+
+__attribute__((target("avx2")))
+void scanAvx2(const char* data, size_t size, size_t base, std::vector<size_t>& out) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 32));
+        uint64_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, newline))) |
+                        static_cast<uint64_t>(static_cast<uint32_t>(
+                            _mm256_movemask_epi8(_mm256_cmpeq_epi8(high, newline)))) << 32;
+        while (mask) {
+            out.push_back(base + i + __builtin_ctzll(mask));
+            mask &= mask - 1;
+        }
+    }
+    scanSse2(data + i, size - i, base + i, out);
+}
+#endif
+
+}
+
+NewlineKernel bestNewlineKernel() {
+#ifdef VM_X86
+    static const NewlineKernel best = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return NewlineKernel::Avx2;
+        }
+        if (__builtin_cpu_supports("sse2")) {
+            return NewlineKernel::Sse2;
+        }
+        return NewlineKernel::Scalar;
+    }();
+    return best;
+#else
+    return NewlineKernel::Scalar;
+#endif
+}
+
+const char* newlineKernelName(NewlineKernel kernel) {
+    switch (kernel) {
+        case NewlineKernel::Avx2: return "avx2";
+        case NewlineKernel::Sse2: return "sse2";
+        case NewlineKernel::Scalar:
+        default:
+            return "scalar";
+    }
+}
+
+void scanNewlines(const char* data, size_t size, size_t base, std::vector<size_t>& out) {
+    scanNewlinesWith(bestNewlineKernel(), data, size, base, out);
+}
+
+void scanNewlinesWith(NewlineKernel kernel, const char* data, size_t size, size_t base,
+                      std::vector<size_t>& out) {
+    switch (kernel) {
+#ifdef VM_X86
+        case NewlineKernel::Avx2:
+            scanAvx2(data, size, base, out);
+            return;
+        case NewlineKernel::Sse2:
+            scanSse2(data, size, base, out);
+            return;
+#endif
+        default:
+            scanScalar(data, size, base, out);
+            return;
+    }
+}
@@ -0,0 +1,280 @@
+#include "ParallelSearch.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fnmatch.h>
+#include <unordered_set>
+
+namespace {
+
+// Smallest piece of a buffer worth a task of its own
+constexpr size_t MinPieceBytes = 1 << 20;
+// Longest line text a hit keeps
+constexpr size_t MaxHitText = 256;
+
+// Where the pieces of [first, end) searched as tasks of their own start.
+// Pieces start at line starts, so no line is counted twice; a pattern
+// that may span lines gets the whole range as one piece.
+std::vector<size_t> pieceStarts(const Regex& pattern, const TextSnapshot& text, size_t first, size_t end,
+                                ThreadPool& pool) {
+    std::vector<size_t> starts{first};
+    if (!pattern.spansLines()) {
+        size_t pieceBytes = std::max(MinPieceBytes, (end - first) / (pool.size() * 8));
+        while (starts.back() + pieceBytes < end) {
+            size_t next = text.lineEnd(starts.back() + pieceBytes) + 1;
+            if (next >= end) {
+                break;
+            }
+            starts.push_back(next);
+        }
+    }
+    return starts;
+}
+
+// Counts the matches starting in [first, last], a whole number of lines
+MatchTally countPiece(const Regex& pattern, const TextSnapshot& text, size_t first, size_t last,
+                      bool everyMatch) {
+    MatchTally tally;
+    RegexMatch match;
+    size_t at = first;
+    while (at <= last && pattern.search(text, at, last, false, match)) {
+        size_t end = std::min(text.lineEnd(match.start), last);
+        tally.lines++;
+        tally.matches++;
+        if (everyMatch) {
+            at = std::max(match.end, match.start + 1);
+            while (at <= end && pattern.search(text, at, end, false, match)) {
+                tally.matches++;
+                at = std::max(match.end, match.start + 1);
+            }
+        }
+        at = end + 1;
+    }
+    return tally;
+}
+
+// The line breaks in [from, to)
+int countBreaks(const TextSnapshot& text, size_t from, size_t to) {
+    int breaks = 0;
+    while (from < to) {
+        size_t chunkStart;
+        std::string_view chunk = text.chunkAt(from, chunkStart);
+        const char* begin = chunk.data() + (from - chunkStart);
+        size_t n = std::min(chunkStart + chunk.size(), to) - from;
+        breaks += std::count(begin, begin + n, '\n');
+        from += n;
+    }
+    return breaks;
+}
+
+// The lines holding a match that starts in [first, last], counted from
+// the line of first
+void markPiece(const Regex& pattern, const TextSnapshot& text, size_t first, size_t last,
+               std::vector<int>& lines) {
+    RegexMatch match;
+    size_t at = first;
+    int line = 0;
+    while (at <= last && pattern.search(text, at, last, false, match)) {
+        line += countBreaks(text, at, match.start);
+        lines.push_back(line);
+        at = text.lineEnd(match.start) + 1;
+        line++;
+    }
+}
+
+bool hasWildcard(const std::string& text) {
+    return text.find_first_of("*?[") != std::string::npos;
+}
+
+std::vector<std::string> split(const std::string& path) {
+    std::vector<std::string> parts;
+    size_t start = 0;
+    while (start <= path.size()) {
+        size_t slash = std::min(path.find('/', start), path.size());
+        if (slash > start) {
+            parts.push_back(path.substr(start, slash - start));
+        }
+        start = slash + 1;
+    }
+    return parts;
+}
+
+bool matchParts(const std::vector<std::string>& glob, size_t i, const std::vector<std::string>& parts, size_t j) {
+    if (i == glob.size()) {
+        return j == parts.size();
+    }
+    if (glob[i] == "**") {
+        for (size_t k = j; k < parts.size(); k++) {
+            if (matchParts(glob, i + 1, parts, k)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    return j < parts.size() && fnmatch(glob[i].c_str(), parts[j].c_str(), FNM_PERIOD) == 0 &&
+           matchParts(glob, i + 1, parts, j + 1);
+}
+
+// The files under one glob, sorted
+void expandGlob(const std::string& glob, std::vector<std::string>& out) {
+    namespace fs = std::filesystem;
+    std::vector<std::string> segments = split(glob);
+    // Walking starts below the segments that have no wildcards
+    std::string base = glob[0] == '/' ? "/" : "";
+    size_t fixed = 0;
+    while (fixed + 1 < segments.size() && !hasWildcard(segments[fixed])) {
+        base += segments[fixed++] + "/";
+    }
+    std::vector<std::string> rest(segments.begin() + fixed, segments.end());
+    bool anyDepth = std::find(rest.begin(), rest.end(), "**") != rest.end();
+
+    std::error_code error;
+    fs::recursive_directory_iterator it(base.empty() ? "." : base,
+                                        fs::directory_options::skip_permission_denied, error);
+    std::vector<std::string> found;
+    for (; !error && it != fs::recursive_directory_iterator(); it.increment(error)) {
+        std::string name = it->path().filename().string();
+        // A dangling link is skipped rather than ending the walk
+        std::error_code entryError;
+        if (it->is_directory(entryError)) {
+            if ((anyDepth && name[0] == '.') || (!anyDepth && it.depth() + 2 > static_cast<int>(rest.size()))) {
+                it.disable_recursion_pending();
+            }
+            continue;
+        }
+        if (!it->is_regular_file(entryError)) {
+            continue;
+        }
+        std::string relative = it->path().lexically_relative(base.empty() ? "." : base).string();
+        if (matchParts(rest, 0, split(relative), 0)) {
+            found.push_back(base + relative);
+        }
+    }
+    std::sort(found.begin(), found.end());
+    out.insert(out.end(), found.begin(), found.end());
+}
+
+void grepFile(const Regex& pattern, const std::string& file, bool everyMatch, std::vector<GrepHit>& hits) {
+    MappedFile mapped;
+    if (!mapped.open(file) || mapped.size() == 0) {
+        return;
+    }
+    std::string_view data(mapped.data(), mapped.size());
+    int line = 0;
+    size_t lineStart = 0;
+    size_t counted = 0; // newlines before here are in line
+    RegexMatch match;
+    for (size_t at = 0; at <= data.size() && pattern.search(data, at, data.size(), false, match);) {
+        const char* from = data.data() + counted;
+        size_t span = match.start - counted;
+        line += std::count(from, from + span, '\n');
+        const void* lastBreak = memrchr(from, '\n', span);
+        if (lastBreak) {
+            lineStart = static_cast<const char*>(lastBreak) - data.data() + 1;
+        }
+        counted = match.start;
+        size_t end = data.find('\n', match.start);
+        end = end == std::string_view::npos ? data.size() : end;
+        hits.push_back({file, line, static_cast<int>(match.start - lineStart),
+                        std::string(data.substr(lineStart, std::min(end - lineStart, MaxHitText)))});
+        at = everyMatch ? std::max(match.end, match.start + 1) : end + 1;
+    }
+}
+
+}
+
+MatchTally countMatches(const Regex& pattern, const TextSnapshot& text, size_t first, size_t end,
+                        bool everyMatch, ThreadPool& pool) {
+    std::vector<size_t> starts = pieceStarts(pattern, text, first, end, pool);
+    std::vector<Regex> patterns(pool.size(), pattern);
+    std::vector<MatchTally> tallies(starts.size());
+    pool.run(starts.size(), [&](size_t piece, unsigned worker) {
+        // A piece's matches may start on the '\n' that ends it, for $
+        size_t last = piece + 1 < starts.size() ? starts[piece + 1] - 1 : end;
+        tallies[piece] = countPiece(patterns[worker], text, starts[piece], last, everyMatch);
+    });
+    MatchTally total;
+    for (const MatchTally& tally : tallies) {
+        total.matches += tally.matches;
+        total.lines += tally.lines;
+    }
+    return total;
+}
+
+std::vector<int> markLines(const Regex& pattern, const TextSnapshot& text, size_t first, size_t end,
+                           int firstLine, bool invert, ThreadPool& pool) {
+    std::vector<size_t> starts = pieceStarts(pattern, text, first, end, pool);
+    std::vector<Regex> patterns(pool.size(), pattern);
+    std::vector<std::vector<int>> found(starts.size());
+    // How many lines each piece holds, to number the next one's from
+    std::vector<int> breaks(starts.size());
+    pool.run(starts.size(), [&](size_t piece, unsigned worker) {
+        size_t last = piece + 1 < starts.size() ? starts[piece + 1] - 1 : end;
+        markPiece(patterns[worker], text, starts[piece], last, found[piece]);
+        breaks[piece] = countBreaks(text, starts[piece], last);
+    });
+
+    std::vector<int> lines;
+    int pieceLine = firstLine;
+    for (size_t piece = 0; piece < starts.size(); piece++) {
+        for (int line : found[piece]) {
+            lines.push_back(pieceLine + line);
+        }
+        pieceLine += breaks[piece] + 1;
+    }
+    if (!invert) {
+        return lines;
+    }
+    // Every line in between the matches
+    std::vector<int> unmarked;
+    int y = firstLine;
+    for (int line : lines) {
+        for (; y < line; y++) {
+            unmarked.push_back(y);
+        }
+        y = line + 1;
+    }
+    for (; y < pieceLine; y++) {
+        unmarked.push_back(y);
+    }
+    return unmarked;
+}
+
+bool expandGlobs(const std::vector<std::string>& globs, std::vector<std::string>& files,
+                 std::string& error) {
+    std::vector<std::string> all;
+    for (const std::string& glob : globs) {
+        if (hasWildcard(glob)) {
+            expandGlob(glob, all);
+        } else if (std::filesystem::is_regular_file(glob)) {
+            all.push_back(glob);
+        }
+    }
+    std::unordered_set<std::string> seen;
+    for (std::string& file : all) {
+        if (seen.insert(file).second) {
+            files.push_back(std::move(file));
+        }
+    }
+    if (files.empty()) {
+        error = "E480: No match:";
+        for (const std::string& glob : globs) {
+            error += " " + glob;
+        }
+        return false;
+    }
+    return true;
+}
+
+void grepFiles(const Regex& pattern, const std::vector<std::string>& files, bool everyMatch,
+               ThreadPool& pool, std::vector<GrepHit>& hits) {
+    std::vector<Regex> patterns(pool.size(), pattern);
+    std::vector<std::vector<GrepHit>> perFile(files.size());
+    pool.run(files.size(), [&](size_t i, unsigned worker) {
+        grepFile(patterns[worker], files[i], everyMatch, perFile[i]);
+    });
+    for (std::vector<GrepHit>& found : perFile) {
+        hits.insert(hits.end(), std::make_move_iterator(found.begin()), std::make_move_iterator(found.end()));
+    }
+}
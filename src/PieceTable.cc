@@ -0,0 +1,475 @@
+#include "PieceTable.h"
+#include "MappedFile.h"
+#include "NewlineScanner.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+// Pieces point into buffers that are only ever appended to, so holding
+// the buffers alive is enough to keep the spans valid and unchanged
+class PieceSnapshot : public TextSnapshot {
+public:
+    std::vector<std::shared_ptr<const void>> owners;
+    std::vector<std::pair<const char*, size_t>> spans;
+    std::vector<size_t> starts; // offset of each span
+    size_t total = 0;
+
+    size_t length() const override {
+        return total;
+    }
+
+    void forEachChunk(const std::function<void(const char*, size_t)>& fn) const override {
+        for (const auto& span : spans) {
+            fn(span.first, span.second);
+        }
+    }
+
+    std::string_view chunkAt(size_t offset, size_t& chunkStart) const override {
+        if (offset >= total) {
+            chunkStart = total;
+            return {};
+        }
+        size_t i = std::upper_bound(starts.begin(), starts.end(), offset) - starts.begin() - 1;
+        chunkStart = starts[i];
+        return {spans[i].first, spans[i].second};
+    }
+};
+
+}
+
+PieceTable::PieceTable() : root(-1), seed(0x9E3779B9u), editVersion(0) {
+    reset(nullptr);
+}
+
+PieceTable::~PieceTable() {}
+
+size_t PieceTable::length() const {
+    return subLength(root);
+}
+
+int PieceTable::lineCount() const {
+    if (pendingIndex) {
+        return static_cast<int>(pendingIndex->ready()) + 1;
+    }
+    return static_cast<int>(subLineFeeds(root)) + 1;
+}
+
+size_t PieceTable::lineStart(int y) const {
+    if (y <= 0) {
+        return 0;
+    }
+    if (y >= lineCount()) {
+        return length();
+    }
+    if (pendingIndex) {
+        // Nothing has been edited yet, offsets are those of the original
+        return pendingIndex->at(y - 1) + 1;
+    }
+
+    // Descend to the piece holding the y-th newline
+    size_t remaining = y;
+    size_t base = 0;
+    int t = root;
+    while (t >= 0) {
+        const Node& node = nodes[t];
+        size_t leftLineFeeds = subLineFeeds(node.left);
+        if (remaining <= leftLineFeeds) {
+            t = node.left;
+            continue;
+        }
+        remaining -= leftLineFeeds;
+        size_t leftLength = subLength(node.left);
+        if (remaining <= node.piece.lineFeeds) {
+            const std::vector<size_t>& lineFeeds = buffers[node.piece.buffer]->lineFeeds;
+            auto first = std::lower_bound(lineFeeds.begin(), lineFeeds.end(), node.piece.start);
+            size_t newline = *(first + (remaining - 1));
+            return base + leftLength + (newline - node.piece.start) + 1;
+        }
+        remaining -= node.piece.lineFeeds;
+        base += leftLength + node.piece.length;
+        t = node.right;
+    }
+    return length();
+}
+
+int PieceTable::lineAt(size_t offset) const {
+    offset = std::min(offset, length());
+    if (pendingIndex) {
+        // Newlines before offset among those found so far
+        size_t low = 0, high = pendingIndex->ready();
+        while (low < high) {
+            size_t mid = (low + high) / 2;
+            if (pendingIndex->at(mid) < offset) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return static_cast<int>(low);
+    }
+
+    size_t lineFeeds = 0;
+    int t = root;
+    while (t >= 0) {
+        const Node& node = nodes[t];
+        size_t leftLength = subLength(node.left);
+        if (offset < leftLength) {
+            t = node.left;
+        } else if (offset < leftLength + node.piece.length) {
+            lineFeeds += subLineFeeds(node.left) +
+                         countLineFeeds(node.piece.buffer, node.piece.start, offset - leftLength);
+            break;
+        } else {
+            lineFeeds += subLineFeeds(node.left) + node.piece.lineFeeds;
+            offset -= leftLength + node.piece.length;
+            t = node.right;
+        }
+    }
+    return static_cast<int>(lineFeeds);
+}
+
+char PieceTable::byteAt(size_t offset) const {
+    int t = root;
+    while (t >= 0) {
+        const Node& node = nodes[t];
+        size_t leftLength = subLength(node.left);
+        if (offset < leftLength) {
+            t = node.left;
+        } else if (offset < leftLength + node.piece.length) {
+            return buffers[node.piece.buffer]->data[node.piece.start + offset - leftLength];
+        } else {
+            offset -= leftLength + node.piece.length;
+            t = node.right;
+        }
+    }
+    return '\0';
+}
+
+void PieceTable::copy(size_t offset, size_t count, std::string& out) const {
+    out.clear();
+    size_t end = std::min(length(), offset + count);
+    if (offset < end) {
+        out.reserve(end - offset);
+        collect(root, offset, end, 0, out);
+    }
+}
+
+void PieceTable::insertBytes(size_t offset, std::string_view text) {
+    waitForLines(std::numeric_limits<int>::max());
+    int left, right;
+    split(root, offset, left, right);
+
+    // Consecutive typing lands right after the previous append, so the
+    // piece before the cursor can usually just grow instead of a new node
+    int last = rightmost(left);
+    Piece piece = append(text);
+    if (last >= 0 && nodes[last].piece.buffer == piece.buffer &&
+        nodes[last].piece.start + nodes[last].piece.length == piece.start) {
+        extendRightmost(left, piece.length, piece.lineFeeds);
+    } else {
+        left = merge(left, newNode(piece));
+    }
+    root = merge(left, right);
+    editVersion++;
+}
+
+void PieceTable::eraseBytes(size_t offset, size_t count) {
+    waitForLines(std::numeric_limits<int>::max());
+    int left, rest, middle, right;
+    split(root, offset, left, rest);
+    split(rest, count, middle, right);
+    freeTree(middle);
+    root = merge(left, right);
+    editVersion++;
+}
+
+void PieceTable::forEachChunk(const std::function<void(const char*, size_t)>& fn) const {
+    std::vector<int> stack;
+    int t = root;
+    while (t >= 0 || !stack.empty()) {
+        while (t >= 0) {
+            stack.push_back(t);
+            t = nodes[t].left;
+        }
+        t = stack.back();
+        stack.pop_back();
+        const Piece& piece = nodes[t].piece;
+        fn(buffers[piece.buffer]->data + piece.start, piece.length);
+        t = nodes[t].right;
+    }
+}
+
+std::string_view PieceTable::chunkAt(size_t offset, size_t& chunkStart) const {
+    chunkStart = 0;
+    int t = root;
+    while (t >= 0) {
+        const Node& node = nodes[t];
+        size_t leftLength = subLength(node.left);
+        if (offset < leftLength) {
+            t = node.left;
+        } else if (offset < leftLength + node.piece.length) {
+            chunkStart += leftLength;
+            return {buffers[node.piece.buffer]->data + node.piece.start, node.piece.length};
+        } else {
+            offset -= leftLength + node.piece.length;
+            chunkStart += leftLength + node.piece.length;
+            t = node.right;
+        }
+    }
+    return {};
+}
+
+std::shared_ptr<const TextSnapshot> PieceTable::snapshot() const {
+    auto copy = std::make_shared<PieceSnapshot>();
+    copy->owners.assign(buffers.begin(), buffers.end());
+    forEachChunk([&copy](const char* data, size_t size) {
+        copy->starts.push_back(copy->total);
+        copy->spans.emplace_back(data, size);
+        copy->total += size;
+    });
+    return copy;
+}
+
+void PieceTable::reset(std::shared_ptr<const MappedFile> original) {
+    pendingIndex.reset();
+    nodes.clear();
+    freeNodes.clear();
+    buffers.clear();
+    root = -1;
+
+    auto buffer = std::make_shared<Buffer>();
+    if (original && original->size() > 0) {
+        buffer->data = original->data();
+        buffer->size = original->size();
+        // The newline ending the last line is implied, not part of the text
+        if (buffer->data[buffer->size - 1] == '\n') {
+            buffer->size--;
+        }
+        if (buffer->size > BackgroundIndexThreshold) {
+            pendingIndex = std::make_unique<LineIndex>();
+            pendingIndex->build(buffer->data, buffer->size);
+        } else {
+            scanNewlines(buffer->data, buffer->size, 0, buffer->lineFeeds);
+        }
+        buffer->capacity = buffer->size;
+        buffer->mapping = original;
+    }
+    buffers.push_back(buffer);
+
+    if (buffer->size > 0) {
+        root = newNode({0, 0, buffer->size, buffer->lineFeeds.size()});
+    }
+    editVersion++;
+}
+
+unsigned long PieceTable::version() const {
+    return editVersion;
+}
+
+bool PieceTable::isIndexing() const {
+    return pendingIndex != nullptr;
+}
+
+void PieceTable::waitForLines(int count) {
+    if (!pendingIndex) {
+        return;
+    }
+    if (count > 1) {
+        pendingIndex->waitFor(count - 1);
+    }
+    if (pendingIndex->complete()) {
+        adoptIndex();
+    }
+}
+
+void PieceTable::adoptIndex() {
+    // Until now the tree is the single untouched original piece, whose
+    // newline count was left at zero
+    buffers[0]->lineFeeds = pendingIndex->take();
+    pendingIndex.reset();
+    nodes[root].piece.lineFeeds = buffers[0]->lineFeeds.size();
+    update(root);
+    editVersion++;
+}
+
+int PieceTable::newNode(const Piece& piece) {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    Node node{piece, seed, -1, -1, piece.length, piece.lineFeeds};
+
+    if (!freeNodes.empty()) {
+        int t = freeNodes.back();
+        freeNodes.pop_back();
+        nodes[t] = node;
+        return t;
+    }
+    nodes.push_back(node);
+    return static_cast<int>(nodes.size()) - 1;
+}
+
+void PieceTable::freeTree(int t) {
+    if (t < 0) {
+        return;
+    }
+    freeTree(nodes[t].left);
+    freeTree(nodes[t].right);
+    freeNodes.push_back(t);
+}
+
+void PieceTable::update(int t) {
+    Node& node = nodes[t];
+    node.subLength = subLength(node.left) + node.piece.length + subLength(node.right);
+    node.subLineFeeds = subLineFeeds(node.left) + node.piece.lineFeeds + subLineFeeds(node.right);
+}
+
+size_t PieceTable::subLength(int t) const {
+    return t < 0 ? 0 : nodes[t].subLength;
+}
+
+size_t PieceTable::subLineFeeds(int t) const {
+    return t < 0 ? 0 : nodes[t].subLineFeeds;
+}
+
+size_t PieceTable::countLineFeeds(int buffer, size_t start, size_t length) const {
+    const std::vector<size_t>& lineFeeds = buffers[buffer]->lineFeeds;
+    auto first = std::lower_bound(lineFeeds.begin(), lineFeeds.end(), start);
+    auto last = std::lower_bound(first, lineFeeds.end(), start + length);
+    return last - first;
+}
+
+void PieceTable::split(int t, size_t offset, int& left, int& right) {
+    // A piece cut in two leaves its tail in a fresh node. Merged in only
+    // up here, its random priority cannot end up below a lower one.
+    int tail = -1;
+    cut(t, offset, left, right, tail);
+    right = merge(tail, right);
+}
+
+void PieceTable::cut(int t, size_t offset, int& left, int& right, int& tail) {
+    if (t < 0) {
+        left = right = -1;
+        return;
+    }
+
+    size_t leftLength = subLength(nodes[t].left);
+    size_t pieceLength = nodes[t].piece.length;
+    if (offset <= leftLength) {
+        int a, b;
+        cut(nodes[t].left, offset, a, b, tail);
+        nodes[t].left = b;
+        update(t);
+        left = a;
+        right = t;
+    } else if (offset >= leftLength + pieceLength) {
+        int a, b;
+        cut(nodes[t].right, offset - leftLength - pieceLength, a, b, tail);
+        nodes[t].right = a;
+        update(t);
+        left = t;
+        right = b;
+    } else {
+        // The cut falls inside this piece: keep the head here and hand the
+        // tail back in a node of its own
+        size_t head = offset - leftLength;
+        Piece rest = nodes[t].piece;
+        rest.start += head;
+        rest.length -= head;
+        rest.lineFeeds = countLineFeeds(rest.buffer, rest.start, rest.length);
+
+        Piece& kept = nodes[t].piece;
+        kept.length = head;
+        kept.lineFeeds -= rest.lineFeeds;
+
+        tail = newNode(rest);
+        right = nodes[t].right;
+        nodes[t].right = -1;
+        update(t);
+        left = t;
+    }
+}
+
+int PieceTable::merge(int left, int right) {
+    if (left < 0) {
+        return right;
+    }
+    if (right < 0) {
+        return left;
+    }
+    if (nodes[left].priority > nodes[right].priority) {
+        int merged = merge(nodes[left].right, right);
+        nodes[left].right = merged;
+        update(left);
+        return left;
+    }
+    int merged = merge(left, nodes[right].left);
+    nodes[right].left = merged;
+    update(right);
+    return right;
+}
+
+int PieceTable::rightmost(int t) const {
+    while (t >= 0 && nodes[t].right >= 0) {
+        t = nodes[t].right;
+    }
+    return t;
+}
+
+void PieceTable::extendRightmost(int t, size_t length, size_t lineFeeds) {
+    while (t >= 0) {
+        nodes[t].subLength += length;
+        nodes[t].subLineFeeds += lineFeeds;
+        if (nodes[t].right < 0) {
+            nodes[t].piece.length += length;
+            nodes[t].piece.lineFeeds += lineFeeds;
+            return;
+        }
+        t = nodes[t].right;
+    }
+}
+
+PieceTable::Piece PieceTable::append(std::string_view text) {
+    if (buffers.size() < 2 || buffers.back()->capacity - buffers.back()->size < text.size()) {
+        auto block = std::make_shared<Buffer>();
+        block->capacity = std::max(AddBlockSize, text.size());
+        block->storage = std::make_unique<char[]>(block->capacity);
+        block->data = block->storage.get();
+        buffers.push_back(block);
+    }
+
+    int index = static_cast<int>(buffers.size()) - 1;
+    Buffer& block = *buffers.back();
+    size_t start = block.size;
+    size_t lineFeedsBefore = block.lineFeeds.size();
+    memcpy(block.storage.get() + start, text.data(), text.size());
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '\n') {
+            block.lineFeeds.push_back(start + i);
+        }
+    }
+    block.size += text.size();
+    return {index, start, text.size(), block.lineFeeds.size() - lineFeedsBefore};
+}
+
+void PieceTable::collect(int t, size_t from, size_t to, size_t base, std::string& out) const {
+    if (t < 0) {
+        return;
+    }
+    const Node& node = nodes[t];
+    size_t pieceStart = base + subLength(node.left);
+    size_t pieceEnd = pieceStart + node.piece.length;
+
+    if (from < pieceStart) {
+        collect(node.left, from, to, base, out);
+    }
+    if (from < pieceEnd && to > pieceStart) {
+        size_t begin = std::max(from, pieceStart);
+        size_t end = std::min(to, pieceEnd);
+        out.append(buffers[node.piece.buffer]->data + node.piece.start + (begin - pieceStart), end - begin);
+    }
+    if (to > pieceEnd) {
+        collect(node.right, from, to, pieceEnd, out);
+    }
+}
@@ -0,0 +1,1255 @@
+#include "Regex.h"
+#include "SubstringSearch.h"
+#include "TextBuffer.h"
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+using ByteSet = std::bitset<256>;
+
+// Zero-width conditions, satisfied or not by the bytes either side
+enum Assertion : uint8_t {
+    LineStart = 1,
+    LineEnd = 2,
+    WordStart = 4,
+    WordEnd = 8
+};
+
+// What the byte just passed tells the next assertion
+enum PrevFlags : uint8_t {
+    PrevLineBreak = 1, // a '\n' or the edge of the text
+    PrevWord = 2
+};
+
+constexpr size_t MaxInstructions = 1 << 16;
+constexpr int MaxCount = 10000;
+// Past this the DFA cache starts over, and a search that needs it to
+// start over too often finishes on the NFA
+constexpr size_t CacheBytes = 8 << 20;
+constexpr int MaxCacheClears = 4;
+
+bool isWordByte(int c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+uint8_t flagsAfter(int byte) {
+    return (byte < 0 || byte == '\n' ? PrevLineBreak : 0) | (isWordByte(byte) ? PrevWord : 0);
+}
+
+// The assertions that hold between a byte with prevFlags and next (-1
+// past either end of the text)
+uint8_t satisfied(uint8_t prevFlags, int next) {
+    bool prevWord = prevFlags & PrevWord;
+    bool nextWord = isWordByte(next);
+    return (prevFlags & PrevLineBreak ? LineStart : 0) | (next < 0 || next == '\n' ? LineEnd : 0) |
+           (!prevWord && nextWord ? WordStart : 0) | (prevWord && !nextWord ? WordEnd : 0);
+}
+
+ByteSet range(int low, int high) {
+    ByteSet set;
+    for (int c = low; c <= high; c++) {
+        set.set(c);
+    }
+    return set;
+}
+
+struct Node {
+    enum class Kind {
+        Empty,
+        Set,
+        Assert,
+        Concat,
+        Alternate,
+        Repeat
+    };
+    Kind kind = Kind::Empty;
+    ByteSet set;
+    uint8_t assertion = 0;
+    int min = 0;
+    int max = -1; // -1 for no limit
+    bool greedy = true;
+    std::vector<Node> children;
+};
+
+class Parser {
+public:
+    explicit Parser(std::string_view pattern) : text(pattern) {}
+
+    bool ignoreCase = false;
+    bool matchCase = false;
+
+    bool parse(Node& root, std::string& error) {
+        if (!alternation(root, 0)) {
+            error = message;
+            return false;
+        }
+        if (i < text.size()) {
+            error = "E55: Unmatched \\)";
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::string_view text;
+    size_t i = 0;
+    std::string message;
+
+    bool fail(const std::string& why) {
+        message = why;
+        return false;
+    }
+
+    bool at(std::string_view s) const {
+        return text.substr(i, s.size()) == s;
+    }
+
+    bool atBranchEnd(size_t j) const {
+        std::string_view rest = text.substr(j);
+        return rest.empty() || rest.starts_with("\\|") || rest.starts_with("\\)");
+    }
+
+    bool alternation(Node& out, int depth) {
+        Node alternate;
+        alternate.kind = Node::Kind::Alternate;
+        while (true) {
+            Node branch;
+            if (!concatenation(branch, depth)) {
+                return false;
+            }
+            alternate.children.push_back(std::move(branch));
+            if (!at("\\|")) {
+                break;
+            }
+            i += 2;
+        }
+        if (alternate.children.size() == 1) {
+            out = std::move(alternate.children[0]);
+        } else {
+            out = std::move(alternate);
+        }
+        return true;
+    }
+
+    bool concatenation(Node& out, int depth) {
+        out = Node();
+        out.kind = Node::Kind::Concat;
+        bool start = true;
+        while (i < text.size() && !at("\\|") && !at("\\)")) {
+            // ^ and $ are anchors only at the ends of a branch
+            if (start && text[i] == '^') {
+                out.children.push_back(assertion(LineStart));
+                i++;
+                continue;
+            }
+            if (text[i] == '$' && atBranchEnd(i + 1)) {
+                out.children.push_back(assertion(LineEnd));
+                i++;
+                continue;
+            }
+            Node node;
+            bool isAtom = true;
+            if (!atom(node, depth, isAtom)) {
+                return false;
+            }
+            if (!isAtom) {
+                continue;
+            }
+            if (!multi(node)) {
+                return false;
+            }
+            out.children.push_back(std::move(node));
+            start = false;
+        }
+        return true;
+    }
+
+    static Node assertion(uint8_t which) {
+        Node node;
+        node.kind = Node::Kind::Assert;
+        node.assertion = which;
+        return node;
+    }
+
+    static Node literal(ByteSet set) {
+        Node node;
+        node.kind = Node::Kind::Set;
+        node.set = set;
+        return node;
+    }
+
+    // \s and the like, without their newline
+    static bool classSet(char name, ByteSet& set) {
+        ByteSet word = range('0', '9') | range('a', 'z') | range('A', 'Z');
+        word.set('_');
+        ByteSet blank;
+        blank.set(' ');
+        blank.set('\t');
+        switch (name) {
+            case 's': set = blank; break;
+            case 'd': set = range('0', '9'); break;
+            case 'w': set = word; break;
+            case 'a': set = range('a', 'z') | range('A', 'Z'); break;
+            case 'l': set = range('a', 'z'); break;
+            case 'u': set = range('A', 'Z'); break;
+            case 'x': set = range('0', '9') | range('a', 'f') | range('A', 'F'); break;
+            case 'h': set = range('a', 'z') | range('A', 'Z'); set.set('_'); break;
+            case 'o': set = range('0', '7'); break;
+            default: {
+                char lower = name | 0x20;
+                if (name < 'A' || name > 'Z' || !classSet(lower, set)) {
+                    return false;
+                }
+                set.flip();
+                set.reset('\n');
+                break;
+            }
+        }
+        return true;
+    }
+
+    static bool posixClass(std::string_view name, ByteSet& set) {
+        if (name == "alpha") set = range('a', 'z') | range('A', 'Z');
+        else if (name == "digit") set = range('0', '9');
+        else if (name == "alnum") set = range('a', 'z') | range('A', 'Z') | range('0', '9');
+        else if (name == "lower") set = range('a', 'z');
+        else if (name == "upper") set = range('A', 'Z');
+        else if (name == "xdigit") set = range('0', '9') | range('a', 'f') | range('A', 'F');
+        else if (name == "space") set = range('\t', '\r') | range(' ', ' ');
+        else if (name == "blank") set = range('\t', '\t') | range(' ', ' ');
+        else if (name == "punct") set = range('!', '/') | range(':', '@') | range('[', '`') | range('{', '~');
+        else if (name == "print") set = range(' ', '~');
+        else if (name == "graph") set = range('!', '~');
+        else if (name == "cntrl") set = range(0, 31) | range(127, 127);
+        else return false;
+        return true;
+    }
+
+    static int escaped(char c) {
+        switch (c) {
+            case 't': return '\t';
+            case 'e': return 27;
+            case 'r': return '\r';
+            case 'n': return '\n';
+            default: return -1;
+        }
+    }
+
+    // [...] from text[i]; false with i unmoved when there is no ']'
+    bool bracket(ByteSet& set) {
+        size_t j = i + 1;
+        bool negate = j < text.size() && text[j] == '^';
+        j += negate;
+        set.reset();
+        bool first = true;
+        while (j < text.size() && (text[j] != ']' || first)) {
+            first = false;
+            if (text.substr(j, 2) == "[:") {
+                size_t close = text.find(":]", j + 2);
+                ByteSet named;
+                if (close != std::string_view::npos && posixClass(text.substr(j + 2, close - j - 2), named)) {
+                    set |= named;
+                    j = close + 2;
+                    continue;
+                }
+            }
+            int low = element(j);
+            if (j + 1 < text.size() && text[j] == '-' && text[j + 1] != ']') {
+                j++;
+                int high = element(j);
+                if (high < low) {
+                    return fail("E944: Reverse range in character class");
+                }
+                set |= range(low, high);
+            } else {
+                set.set(low);
+            }
+        }
+        if (j >= text.size()) {
+            return false;
+        }
+        if (negate) {
+            set.flip();
+            set.reset('\n');
+        }
+        i = j + 1;
+        return true;
+    }
+
+    // One byte of a bracket expression, advancing j past it
+    int element(size_t& j) {
+        unsigned char c = text[j];
+        if (c == '\\' && j + 1 < text.size()) {
+            char next = text[j + 1];
+            int special = escaped(next);
+            if (special >= 0 || next == '\\' || next == ']' || next == '^' || next == '-') {
+                j += 2;
+                return special >= 0 ? special : static_cast<unsigned char>(next);
+            }
+        }
+        j++;
+        return c;
+    }
+
+    bool group(Node& node, int depth) {
+        if (!alternation(node, depth + 1)) {
+            return false;
+        }
+        if (!at("\\)")) {
+            return fail("E54: Unmatched \\(");
+        }
+        i += 2;
+        return true;
+    }
+
+    // A '*' that reaches here has nothing to repeat and is itself
+    bool atom(Node& node, int depth, bool& isAtom) {
+        unsigned char c = text[i];
+        if (c == '[') {
+            ByteSet set;
+            if (bracket(set)) {
+                node = literal(set);
+                return true;
+            }
+            if (!message.empty()) {
+                return false;
+            }
+            // Without a closing ']' the '[' is itself
+        } else if (c == '.') {
+            i++;
+            node = literal(~range('\n', '\n'));
+            return true;
+        } else if (c == '\\' && i + 1 < text.size()) {
+            char e = text[i + 1];
+            i += 2;
+            ByteSet set;
+            switch (e) {
+                case '(':
+                    return group(node, depth);
+                case '%':
+                    if (at("(")) {
+                        i++;
+                        return group(node, depth);
+                    }
+                    return fail("E71: Invalid character after \\%");
+                case '<':
+                    node = assertion(WordStart);
+                    return true;
+                case '>':
+                    node = assertion(WordEnd);
+                    return true;
+                case 'c':
+                case 'C':
+                    (e == 'c' ? ignoreCase : matchCase) = true;
+                    isAtom = false;
+                    return true;
+                case '+':
+                case '=':
+                case '?':
+                case '{':
+                    return fail(std::string("E64: \\") + e + " follows nothing");
+                case '_':
+                    // \_x is x or a line break
+                    if (at(".")) {
+                        i++;
+                        node = literal(~ByteSet());
+                        return true;
+                    }
+                    if (at("[") && bracket(set)) {
+                        set.set('\n');
+                        node = literal(set);
+                        return true;
+                    }
+                    if (i < text.size() && classSet(text[i], set)) {
+                        i++;
+                        set.set('\n');
+                        node = literal(set);
+                        return true;
+                    }
+                    return message.empty() ? fail("E63: Invalid use of \\_") : false;
+                default:
+                    if (escaped(e) >= 0) {
+                        node = literal(range(escaped(e), escaped(e)));
+                    } else if (classSet(e, set)) {
+                        node = literal(set);
+                    } else {
+                        node = literal(range(static_cast<unsigned char>(e), static_cast<unsigned char>(e)));
+                    }
+                    return true;
+            }
+        }
+        i++;
+        node = literal(range(c, c));
+        return true;
+    }
+
+    bool multi(Node& node) {
+        int min, max;
+        bool greedy = true;
+        if (at("*")) {
+            i++;
+            min = 0;
+            max = -1;
+        } else if (at("\\+")) {
+            i += 2;
+            min = 1;
+            max = -1;
+        } else if (at("\\=") || at("\\?")) {
+            i += 2;
+            min = 0;
+            max = 1;
+        } else if (at("\\{")) {
+            i += 2;
+            if (!braces(min, max, greedy)) {
+                return false;
+            }
+        } else {
+            return true;
+        }
+        if (at("*") || at("\\+") || at("\\=") || at("\\?") || at("\\{")) {
+            return fail("E61: Nested multi");
+        }
+        Node repeat;
+        repeat.kind = Node::Kind::Repeat;
+        repeat.min = min;
+        repeat.max = max;
+        repeat.greedy = greedy;
+        repeat.children.push_back(std::move(node));
+        node = std::move(repeat);
+        return true;
+    }
+
+    // The inside of \{...}, after the brace
+    bool braces(int& min, int& max, bool& greedy) {
+        greedy = !at("-");
+        i += !greedy;
+        auto number = [&](int& value) {
+            size_t begin = i;
+            value = 0;
+            while (i < text.size() && text[i] >= '0' && text[i] <= '9') {
+                value = std::min(value * 10 + (text[i] - '0'), MaxCount + 1);
+                i++;
+            }
+            return i > begin;
+        };
+        bool hasMin = number(min);
+        max = min;
+        if (at(",")) {
+            i++;
+            if (!number(max)) {
+                max = -1;
+            }
+        } else if (!hasMin) {
+            max = -1;
+        }
+        if (!hasMin) {
+            min = 0;
+        }
+        if (at("\\}")) {
+            i++;
+        }
+        if (!at("}")) {
+            return fail("E554: Syntax error in \\{...}");
+        }
+        i++;
+        if (min > MaxCount || max > MaxCount) {
+            return fail("E60: Too many complex \\{...}s");
+        }
+        if (max >= 0 && min > max) {
+            std::swap(min, max);
+        }
+        return true;
+    }
+};
+
+void foldCase(Node& node) {
+    if (node.kind == Node::Kind::Set) {
+        for (int c = 'a'; c <= 'z'; c++) {
+            if (node.set.test(c) || node.set.test(c - 32)) {
+                node.set.set(c);
+                node.set.set(c - 32);
+            }
+        }
+    }
+    for (Node& child : node.children) {
+        foldCase(child);
+    }
+}
+
+// The pattern as a plain string, when it is one
+bool literalText(const Node& node, std::string& out) {
+    auto single = [](const Node& n, std::string& s) {
+        if (n.kind != Node::Kind::Set || n.set.count() != 1) {
+            return false;
+        }
+        for (int c = 0; c < 256; c++) {
+            if (n.set.test(c)) {
+                s += static_cast<char>(c);
+            }
+        }
+        return true;
+    };
+    if (node.kind == Node::Kind::Concat) {
+        for (const Node& child : node.children) {
+            if (!single(child, out)) {
+                return false;
+            }
+        }
+        return !out.empty();
+    }
+    return single(node, out);
+}
+
+struct Inst {
+    enum class Op : uint8_t {
+        Set,
+        Split,
+        Assert,
+        Match
+    };
+    Op op;
+    uint8_t assertion;
+    int set;
+    int out;
+    int out1;
+};
+
+struct Nfa {
+    std::vector<Inst> insts;
+    int start = 0; // for a search: tries the pattern at every position
+    int anchored = 0; // the pattern at one position only
+};
+
+// Thompson construction, from the end of the pattern back to its start.
+// Split prefers out to out1, which is what makes the NFA leftmost-first.
+class Builder {
+public:
+    Builder(Nfa& nfa, std::vector<ByteSet>& sets, bool reverse) : nfa(nfa), sets(sets), reverse(reverse) {}
+
+    bool tooLong = false;
+
+    int add(Inst inst) {
+        if (nfa.insts.size() >= MaxInstructions) {
+            tooLong = true;
+            return 0;
+        }
+        nfa.insts.push_back(inst);
+        return static_cast<int>(nfa.insts.size()) - 1;
+    }
+
+    int emit(const Node& node, int next) {
+        if (tooLong) {
+            return 0;
+        }
+        switch (node.kind) {
+            case Node::Kind::Empty:
+                return next;
+            case Node::Kind::Set:
+                return add({Inst::Op::Set, 0, setIndex(node.set), next, -1});
+            case Node::Kind::Assert: {
+                uint8_t which = node.assertion;
+                if (reverse) {
+                    // Read backwards, the start of a line or word is its end
+                    which = which == LineStart ? LineEnd : which == LineEnd ? LineStart
+                          : which == WordStart ? WordEnd : WordStart;
+                }
+                return add({Inst::Op::Assert, which, -1, next, -1});
+            }
+            case Node::Kind::Concat:
+                if (reverse) {
+                    for (const Node& child : node.children) {
+                        next = emit(child, next);
+                    }
+                } else {
+                    for (auto it = node.children.rbegin(); it != node.children.rend(); ++it) {
+                        next = emit(*it, next);
+                    }
+                }
+                return next;
+            case Node::Kind::Alternate: {
+                std::vector<int> entries;
+                for (const Node& child : node.children) {
+                    entries.push_back(emit(child, next));
+                }
+                int entry = entries.back();
+                for (size_t k = entries.size() - 1; k-- > 0;) {
+                    entry = add({Inst::Op::Split, 0, -1, entries[k], entry});
+                }
+                return entry;
+            }
+            case Node::Kind::Repeat: {
+                const Node& child = node.children[0];
+                int entry;
+                if (node.max < 0) {
+                    int loop = add({Inst::Op::Split, 0, -1, -1, -1});
+                    int body = emit(child, loop);
+                    if (tooLong) {
+                        return 0;
+                    }
+                    nfa.insts[loop].out = node.greedy ? body : next;
+                    nfa.insts[loop].out1 = node.greedy ? next : body;
+                    entry = loop;
+                } else {
+                    entry = next;
+                    for (int k = node.min; k < node.max; k++) {
+                        int body = emit(child, entry);
+                        entry = node.greedy ? add({Inst::Op::Split, 0, -1, body, next})
+                                            : add({Inst::Op::Split, 0, -1, next, body});
+                    }
+                }
+                for (int k = 0; k < node.min; k++) {
+                    entry = emit(child, entry);
+                }
+                return entry;
+            }
+        }
+        return next;
+    }
+
+private:
+    Nfa& nfa;
+    std::vector<ByteSet>& sets;
+    bool reverse;
+
+    int setIndex(const ByteSet& set) {
+        auto it = std::find(sets.begin(), sets.end(), set);
+        if (it != sets.end()) {
+            return static_cast<int>(it - sets.begin());
+        }
+        sets.push_back(set);
+        return static_cast<int>(sets.size()) - 1;
+    }
+};
+
+bool hasAssertion(const Node& node) {
+    if (node.kind == Node::Kind::Assert) {
+        return true;
+    }
+    return std::any_of(node.children.begin(), node.children.end(), hasAssertion);
+}
+
+}
+
+struct Regex::Program {
+    std::vector<ByteSet> sets;
+    Nfa forward;
+    Nfa reverse;
+    bool assertions = false;
+    bool lineBreaks = false; // some set holds '\n'
+    // Bytes no set, assertion or line break tells apart share a class
+    std::array<uint8_t, 256> classOf{};
+    std::vector<int> classByte;
+    int classes = 0;
+    std::optional<SubstringSearch> literal;
+};
+
+// The bytes searched: a buffer or snapshot read a piece at a time, or
+// one string
+struct Regex::Input {
+    const TextBuffer* buffer = nullptr;
+    const TextSnapshot* snapshot = nullptr;
+    std::string_view text;
+    size_t size = 0;
+    mutable std::string_view chunk;
+    mutable size_t chunkStart = 0;
+
+    std::string_view chunkAt(size_t offset, size_t& start) const {
+        if (buffer) {
+            return buffer->chunkAt(offset, start);
+        }
+        if (snapshot) {
+            return snapshot->chunkAt(offset, start);
+        }
+        start = 0;
+        return text;
+    }
+
+    // -1 outside the text
+    int byteAt(size_t offset) const {
+        if (offset >= size) {
+            return -1;
+        }
+        if (offset < chunkStart || offset - chunkStart >= chunk.size()) {
+            chunk = chunkAt(offset, chunkStart);
+        }
+        return static_cast<unsigned char>(chunk[offset - chunkStart]);
+    }
+};
+
+// Lazily built DFAs for the forward and the reverse NFA. A DFA state is
+// the ordered list of NFA instructions the threads go on from, plus what
+// the previous byte says about lines and words. Their closure is taken
+// only once the next byte is known, so assertions are settled in the
+// same order the NFA would settle them. A transition also reports
+// whether a match ended just before its byte.
+struct Regex::Cache {
+    struct Dfa {
+        std::vector<int> pool;
+        std::vector<std::pair<uint32_t, uint32_t>> spans; // each state's instructions in pool
+        std::vector<uint8_t> flags;
+        // Per state and class, -1 until known: the next state's row in
+        // this table, shifted left past whether a match ended here
+        std::vector<int32_t> next;
+        std::vector<int32_t> withoutRestart;
+        std::array<int32_t, 4> starts;
+        std::unordered_map<std::string, int> ids;
+        size_t bytes = 0;
+    };
+
+    const Program& program;
+    int stride;
+    Dfa dfas[2];
+    std::vector<int> list;
+    std::vector<int> stepped;
+    std::vector<int> stack;
+    std::vector<uint32_t> marks;
+    uint32_t mark = 0;
+    std::string key;
+
+    explicit Cache(const Program& program)
+        : program(program), stride(program.classes + 1),
+          marks(std::max(program.forward.insts.size(), program.reverse.insts.size()), 0) {
+        clear(0);
+        clear(1);
+    }
+
+    void clear(int dir) {
+        Dfa& dfa = dfas[dir];
+        dfa = Dfa();
+        dfa.starts.fill(-1);
+        // State 0 is dead: no instructions, every transition back to itself
+        dfa.spans.emplace_back(0, 0);
+        dfa.flags.push_back(0);
+        dfa.next.assign(stride, 0);
+        dfa.withoutRestart.push_back(0);
+    }
+
+    const Nfa& nfa(int dir) const {
+        return dir ? program.reverse : program.forward;
+    }
+
+    // Appends what is reachable from inst without reading a byte, in
+    // priority order, passing only the assertions in holds
+    void follow(const Nfa& machine, int inst, uint8_t holds, std::vector<int>& out) {
+        stack.push_back(inst);
+        while (!stack.empty()) {
+            int i = stack.back();
+            stack.pop_back();
+            if (marks[i] == mark) {
+                continue;
+            }
+            marks[i] = mark;
+            const Inst& in = machine.insts[i];
+            switch (in.op) {
+                case Inst::Op::Set:
+                case Inst::Op::Match:
+                    out.push_back(i);
+                    break;
+                case Inst::Op::Split:
+                    stack.push_back(in.out1);
+                    stack.push_back(in.out);
+                    break;
+                case Inst::Op::Assert:
+                    if ((in.assertion & ~holds) == 0) {
+                        stack.push_back(in.out);
+                    }
+                    break;
+            }
+        }
+    }
+
+    int addState(int dir, const std::vector<int>& insts, uint8_t flags) {
+        if (insts.empty()) {
+            return 0;
+        }
+        Dfa& dfa = dfas[dir];
+        key.assign(1, static_cast<char>(flags));
+        key.append(reinterpret_cast<const char*>(insts.data()), insts.size() * sizeof(int));
+        auto [it, added] = dfa.ids.try_emplace(key, static_cast<int>(dfa.spans.size()));
+        if (added) {
+            dfa.spans.emplace_back(dfa.pool.size(), insts.size());
+            dfa.pool.insert(dfa.pool.end(), insts.begin(), insts.end());
+            dfa.flags.push_back(flags);
+            dfa.next.resize(dfa.next.size() + stride, -1);
+            dfa.withoutRestart.push_back(-1);
+            dfa.bytes += key.size() * 2 + stride * sizeof(int32_t) + 64;
+        }
+        return it->second;
+    }
+
+    int start(int dir, uint8_t flags) {
+        Dfa& dfa = dfas[dir];
+        if (dfa.starts[flags] < 0) {
+            stepped.assign(1, nfa(dir).start);
+            dfa.starts[flags] = addState(dir, stepped, program.assertions ? flags : 0);
+        }
+        return dfa.starts[flags];
+    }
+
+    // The same threads, but none starting any later
+    int stopRestarting(int state) {
+        Dfa& dfa = dfas[0];
+        if (dfa.withoutRestart[state] < 0) {
+            auto [offset, count] = dfa.spans[state];
+            stepped.clear();
+            for (uint32_t k = 0; k < count; k++) {
+                int root = dfa.pool[offset + k];
+                stepped.push_back(root == program.forward.start ? program.forward.anchored : root);
+            }
+            int id = addState(0, stepped, dfa.flags[state]);
+            dfas[0].withoutRestart[state] = id;
+        }
+        return dfa.withoutRestart[state];
+    }
+
+    int32_t compute(int dir, int state, int cls) {
+        Dfa& dfa = dfas[dir];
+        const Nfa& machine = nfa(dir);
+        int byte = cls == program.classes ? -1 : program.classByte[cls];
+        uint8_t holds = satisfied(dfa.flags[state], byte);
+
+        mark++;
+        list.clear();
+        auto [offset, count] = dfa.spans[state];
+        for (uint32_t k = 0; k < count; k++) {
+            follow(machine, dfa.pool[offset + k], holds, list);
+        }
+
+        // Threads after a match have lower priority than it and can
+        // never win; the reverse DFA wants every start, so keeps them
+        bool matched = false;
+        for (size_t k = 0; k < list.size(); k++) {
+            if (machine.insts[list[k]].op == Inst::Op::Match) {
+                matched = true;
+                if (dir == 0) {
+                    list.resize(k);
+                }
+                break;
+            }
+        }
+        if (byte < 0) {
+            return matched;
+        }
+
+        mark++;
+        stepped.clear();
+        for (int i : list) {
+            const Inst& in = machine.insts[i];
+            if (in.op == Inst::Op::Set && program.sets[in.set].test(byte) && marks[in.out] != mark) {
+                marks[in.out] = mark;
+                stepped.push_back(in.out);
+            }
+        }
+        int next = addState(dir, stepped, program.assertions ? flagsAfter(byte) : 0);
+        return next * stride << 1 | matched;
+    }
+
+    int32_t transition(int dir, int state, int cls) {
+        int32_t& slot = dfas[dir].next[static_cast<size_t>(state) * stride + cls];
+        if (slot < 0) {
+            int32_t result = compute(dir, state, cls);
+            // compute may have grown the table under slot
+            dfas[dir].next[static_cast<size_t>(state) * stride + cls] = result;
+            return result;
+        }
+        return slot;
+    }
+
+    bool full(int dir) const {
+        return dfas[dir].bytes > CacheBytes;
+    }
+
+    // Starts the cache over, keeping one state; returns its new number
+    int restartWith(int dir, int state) {
+        if (state == 0) {
+            clear(dir);
+            return 0;
+        }
+        Dfa& dfa = dfas[dir];
+        auto [offset, count] = dfa.spans[state];
+        std::vector<int> insts(dfa.pool.begin() + offset, dfa.pool.begin() + offset + count);
+        uint8_t flags = dfa.flags[state];
+        clear(dir);
+        return addState(dir, insts, flags);
+    }
+};
+
+Regex::Regex() {}
+
+Regex::Regex(const Regex& other) : source(other.source), program(other.program) {
+    if (program) {
+        cache = std::make_unique<Cache>(*program);
+    }
+}
+
+Regex& Regex::operator=(const Regex& other) {
+    if (this != &other) {
+        source = other.source;
+        program = other.program;
+        cache = program ? std::make_unique<Cache>(*program) : nullptr;
+    }
+    return *this;
+}
+
+Regex::~Regex() {}
+
+bool Regex::compile(std::string_view pattern, std::string& error) {
+    if (pattern.empty()) {
+        error = "E35: No previous regular expression";
+        return false;
+    }
+    Parser parser(pattern);
+    Node root;
+    if (!parser.parse(root, error)) {
+        return false;
+    }
+    bool ignoreCase = parser.ignoreCase;
+    if (ignoreCase) {
+        foldCase(root);
+    }
+
+    auto compiled = std::make_shared<Program>();
+    compiled->assertions = hasAssertion(root);
+    std::string text;
+    if (!ignoreCase && literalText(root, text)) {
+        compiled->literal.emplace(text);
+    }
+
+    Builder forward(compiled->forward, compiled->sets, false);
+    int match = forward.add({Inst::Op::Match, 0, -1, -1, -1});
+    compiled->forward.anchored = forward.emit(root, match);
+    // Tries the pattern first, then steps on a byte and tries again
+    int restartSplit = forward.add({Inst::Op::Split, 0, -1, compiled->forward.anchored, -1});
+    Node any;
+    any.kind = Node::Kind::Set;
+    any.set.set();
+    compiled->forward.insts[restartSplit].out1 = forward.emit(any, restartSplit);
+    compiled->forward.start = restartSplit;
+
+    Builder reverse(compiled->reverse, compiled->sets, true);
+    match = reverse.add({Inst::Op::Match, 0, -1, -1, -1});
+    compiled->reverse.anchored = compiled->reverse.start = reverse.emit(root, match);
+    if (forward.tooLong || reverse.tooLong) {
+        error = "E339: Pattern too long";
+        return false;
+    }
+    // The reverse program has no restart loop, so its sets are the pattern's own
+    for (const Inst& inst : compiled->reverse.insts) {
+        if (inst.op == Inst::Op::Set && compiled->sets[inst.set].test('\n')) {
+            compiled->lineBreaks = true;
+        }
+    }
+
+    // Byte classes
+    std::unordered_map<std::string, int> signatures;
+    std::string signature;
+    for (int c = 0; c < 256; c++) {
+        signature.clear();
+        for (const ByteSet& set : compiled->sets) {
+            signature += set.test(c) ? '1' : '0';
+        }
+        signature += c == '\n' ? '1' : '0';
+        signature += isWordByte(c) ? '1' : '0';
+        auto [it, added] = signatures.try_emplace(signature, compiled->classes);
+        if (added) {
+            compiled->classByte.push_back(c);
+            compiled->classes++;
+        }
+        compiled->classOf[c] = it->second;
+    }
+
+    source = std::string(pattern);
+    program = std::move(compiled);
+    cache = std::make_unique<Cache>(*program);
+    return true;
+}
+
+bool Regex::empty() const {
+    return !program;
+}
+
+const std::string& Regex::pattern() const {
+    return source;
+}
+
+const std::string* Regex::literal() const {
+    return program && program->literal ? &program->literal->needle() : nullptr;
+}
+
+bool Regex::spansLines() const {
+    return program && program->lineBreaks;
+}
+
+bool Regex::search(const TextBuffer& buffer, size_t first, size_t last, bool backward,
+                   RegexMatch& match) const {
+    Input input;
+    input.buffer = &buffer;
+    input.size = buffer.length();
+    return run(input, first, last, backward, match);
+}
+
+bool Regex::search(const TextSnapshot& snapshot, size_t first, size_t last, bool backward,
+                   RegexMatch& match) const {
+    Input input;
+    input.snapshot = &snapshot;
+    input.size = snapshot.length();
+    return run(input, first, last, backward, match);
+}
+
+bool Regex::search(std::string_view text, size_t first, size_t last, bool backward,
+                   RegexMatch& match) const {
+    Input input;
+    input.text = text;
+    input.size = text.size();
+    return run(input, first, last, backward, match);
+}
+
+bool Regex::searchNfa(std::string_view text, size_t first, size_t last, RegexMatch& match) const {
+    Input input;
+    input.text = text;
+    input.size = text.size();
+    if (!program || first > last || first > input.size) {
+        return false;
+    }
+    return pike(input, first, std::min(last, input.size), match);
+}
+
+bool Regex::run(const Input& input, size_t first, size_t last, bool backward, RegexMatch& match) const {
+    if (!program || first > last || first > input.size) {
+        return false;
+    }
+    last = std::min(last, input.size);
+    if (program->literal) {
+        const SubstringSearch& literal = *program->literal;
+        size_t found;
+        if (input.buffer) {
+            found = literal.find(*input.buffer, first, last, backward);
+        } else if (input.snapshot) {
+            found = literal.find(*input.snapshot, first, last, backward);
+        } else {
+            found = backward ? literal.rfind(input.text, last) : literal.find(input.text, first);
+        }
+        if (found == SubstringSearch::npos || found < first || found > last) {
+            return false;
+        }
+        match = {found, found + literal.size()};
+        return true;
+    }
+    return backward ? this->backward(input, first, last, match) : forward(input, first, last, false, match);
+}
+
+// The forward DFA finds where the leftmost-first match ends, and the
+// reverse DFA, run back from there, where it starts
+bool Regex::forward(const Input& input, size_t first, size_t last, bool earliest, RegexMatch& match) const {
+    Cache& c = *cache;
+    const Program& p = *program;
+    const int stride = c.stride;
+    int clears = 0;
+    // States are tracked by their row in the transition table; this is
+    // the way through the cache for transitions not known yet
+    auto step = [&](int dir, int32_t row, int cls) {
+        int32_t t = c.transition(dir, row / stride, cls);
+        if (c.full(dir)) {
+            clears++;
+            t = c.restartWith(dir, (t >> 1) / stride) * stride << 1 | (t & 1);
+        }
+        return t;
+    };
+
+    int32_t row = c.start(0, flagsAfter(first ? input.byteAt(first - 1) : -1)) * stride;
+    size_t end = SubstringSearch::npos;
+    bool restarting = true;
+    size_t pos = first;
+    while (pos < input.size && row != 0) {
+        if (restarting && pos >= last) {
+            // Matches may start at last but no later
+            row = c.stopRestarting(row / stride) * stride;
+            restarting = false;
+        }
+        size_t chunkStart;
+        std::string_view chunk = input.chunkAt(pos, chunkStart);
+        size_t stop = chunkStart + chunk.size();
+        if (restarting) {
+            stop = std::min(stop, last);
+        }
+        const unsigned char* data = reinterpret_cast<const unsigned char*>(chunk.data());
+        const unsigned char* bytes = data + (pos - chunkStart);
+        const unsigned char* limit = data + (stop - chunkStart);
+        const int32_t* table = c.dfas[0].next.data();
+        for (; bytes < limit; bytes++) {
+            int cls = p.classOf[*bytes];
+            int32_t t = table[row + cls];
+            // Nearly every byte has its transition known, live and with
+            // no match
+            if (t <= 1 || (t & 1)) {
+                t = step(0, row, cls);
+                table = c.dfas[0].next.data();
+                if (t & 1) {
+                    end = chunkStart + (bytes - data);
+                }
+                if (t >> 1 == 0 || (earliest && end != SubstringSearch::npos)) {
+                    row = 0;
+                    break;
+                }
+            }
+            row = t >> 1;
+        }
+        pos = chunkStart + (bytes - data);
+        if (clears > MaxCacheClears) {
+            return pike(input, first, last, match);
+        }
+    }
+    if (row != 0 && (step(0, row, p.classes) & 1)) {
+        end = input.size;
+    }
+    if (end == SubstringSearch::npos) {
+        return false;
+    }
+
+    int32_t reverse = c.start(1, flagsAfter(input.byteAt(end))) * stride;
+    size_t start = SubstringSearch::npos;
+    pos = end;
+    while (pos > first && reverse != 0) {
+        size_t chunkStart;
+        std::string_view chunk = input.chunkAt(pos - 1, chunkStart);
+        const unsigned char* data = reinterpret_cast<const unsigned char*>(chunk.data());
+        size_t bottom = std::max(chunkStart, first);
+        for (; pos > bottom; pos--) {
+            int32_t t = step(1, reverse, p.classOf[data[pos - 1 - chunkStart]]);
+            if (t & 1) {
+                start = pos;
+            }
+            reverse = t >> 1;
+            if (reverse == 0) {
+                break;
+            }
+        }
+        if (clears > MaxCacheClears) {
+            return pike(input, first, last, match);
+        }
+    }
+    if (pos == first && reverse != 0) {
+        int before = first ? input.byteAt(first - 1) : -1;
+        if (step(1, reverse, before < 0 ? p.classes : p.classOf[before]) & 1) {
+            start = first;
+        }
+    }
+    if (start == SubstringSearch::npos) {
+        return pike(input, first, last, match);
+    }
+    match = {start, end};
+    return true;
+}
+
+// The last match starting in [first, last], over blocks that grow
+// backwards from last until one holds a match. Starts are stepped
+// through with matches cut short at the first end reached, so a match
+// that runs on for megabytes is not run to its end once per start; only
+// the last start gets its full leftmost-first match.
+bool Regex::backward(const Input& input, size_t first, size_t last, RegexMatch& match) const {
+    size_t span = 4096;
+    while (true) {
+        size_t blockFirst = last - first > span ? last - span : first;
+        bool found = false;
+        RegexMatch candidate;
+        // No start in the block is passed over: each one found is at or
+        // before the last start, and the next search begins after it
+        for (size_t from = blockFirst; from <= last && forward(input, from, last, true, candidate);) {
+            found = true;
+            from = candidate.start + 1;
+        }
+        if (found) {
+            return forward(input, candidate.start, candidate.start, false, match);
+        }
+        if (blockFirst == first) {
+            return false;
+        }
+        last = blockFirst - 1;
+        span *= 2;
+    }
+}
+
+// Runs every thread of the forward NFA side by side, each remembering
+// where it started: slower than the DFA but needs no cache
+bool Regex::pike(const Input& input, size_t first, size_t last, RegexMatch& match) const {
+    const Nfa& machine = program->forward;
+    struct Thread {
+        int inst;
+        size_t start;
+    };
+    std::vector<Thread> current, next;
+    std::vector<std::pair<int, size_t>> stack;
+    std::vector<uint32_t> marks(machine.insts.size(), 0);
+    uint32_t mark = 0;
+
+    auto add = [&](std::vector<Thread>& list, int inst, size_t start, uint8_t holds) {
+        stack.emplace_back(inst, start);
+        while (!stack.empty()) {
+            auto [i, from] = stack.back();
+            stack.pop_back();
+            if (marks[i] == mark) {
+                continue;
+            }
+            marks[i] = mark;
+            const Inst& in = machine.insts[i];
+            switch (in.op) {
+                case Inst::Op::Set:
+                case Inst::Op::Match:
+                    list.push_back({i, from});
+                    break;
+                case Inst::Op::Split:
+                    stack.emplace_back(in.out1, from);
+                    stack.emplace_back(in.out, from);
+                    break;
+                case Inst::Op::Assert:
+                    if ((in.assertion & ~holds) == 0) {
+                        stack.emplace_back(in.out, from);
+                    }
+                    break;
+            }
+        }
+    };
+
+    bool found = false;
+    size_t pos = first;
+    int byte = input.byteAt(pos);
+    mark++;
+    add(current, machine.anchored, first, satisfied(flagsAfter(first ? input.byteAt(first - 1) : -1), byte));
+    while (true) {
+        int after = input.byteAt(pos + 1);
+        uint8_t holds = satisfied(flagsAfter(byte), after);
+        mark++;
+        for (const Thread& thread : current) {
+            const Inst& in = machine.insts[thread.inst];
+            if (in.op == Inst::Op::Match) {
+                match = {thread.start, pos};
+                found = true;
+                break;
+            }
+            if (byte >= 0 && program->sets[in.set].test(byte)) {
+                add(next, in.out, thread.start, holds);
+            }
+        }
+        if (byte < 0) {
+            break;
+        }
+        if (!found && pos + 1 <= last) {
+            add(next, machine.anchored, pos + 1, holds);
+        }
+        current.swap(next);
+        next.clear();
+        pos++;
+        byte = after;
+        if (current.empty() && (found || pos > last)) {
+            break;
+        }
+    }
+    return found;
+}
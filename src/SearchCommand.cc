@@ -1,8 +1,10 @@
 #include "SearchCommand.h"
+#include "IncrementalSearch.h"
 #include <ncurses.h>
 #include <algorithm>
 #include <cctype>
-#include <sstream>
+#include <limits>
+#include <optional>
 #include <fstream>
 #include <ncurses.h>
 
@@ -11,79 +13,155 @@ SearchCommand::SearchCommand(Editor& editor, int numOfTimes)
 
 SearchCommand::~SearchCommand() {}
 
-void SearchCommand::execute(const std::string& wordStr, char direction) {
-
-    std::istringstream iss(wordStr);
-    std::string word;
-    iss >> word;
-    int foundY = -1, foundX = -1;
+void SearchCommand::execute(const std::string& word, char direction) {
+    // An empty pattern searches for the last one again
+    Regex& pattern = editor.searchPattern;
+    if (!word.empty() && word != pattern.pattern()) {
+        std::string error;
+        Regex compiled;
+        if (!compiled.compile(word, error)) {
+            beep();
+            editor.setStatusMessage(error, true);
+            return;
+        }
+        pattern = compiled;
+    }
+    if (pattern.empty()) {
+        beep();
+        editor.setStatusMessage("E35: No previous regular expression", true);
+        return;
+    }
+    TextBuffer& buffer = *editor.textBuffer;
+    buffer.waitForLines(std::numeric_limits<int>::max());
+    size_t offset = buffer.offsetOf(editor.cursorY, editor.cursorX);
+    bool wrapped = false;
     for (int i = 0; i < numOfTimes; i++) {
-        if (performSearch(word, direction, foundY, foundX)) {
-            editor.setCursorPosition(foundY, foundX);
-            ungetch('\n');
-        } else {
+        if (!performSearch(pattern, direction, offset, wrapped)) {
             beep();
-            editor.setStatusMessage("E486: Pattern not found: " + word, true);
-            break;
+            editor.setStatusMessage("E486: Pattern not found: " + pattern.pattern(), true);
+            return;
         }
     }
+    int foundY = buffer.lineAt(offset);
+    editor.setCursorPosition(foundY, static_cast<int>(offset - buffer.lineStart(foundY)));
+    editor.highlightSearch(true);
+    ungetch('\n');
+    if (wrapped) {
+        editor.showMatchCount(direction == '/' ? "search hit BOTTOM, continuing at TOP"
+                                               : "search hit TOP, continuing at BOTTOM", true);
+    } else {
+        editor.showMatchCount((direction == '/' ? "Found next: " : "Found previous: ") + pattern.pattern(),
+                              true);
+    }
 }
 
-bool SearchCommand::performSearch(const std::string& query, char direction, int& foundY, int& foundX) {
-    if (query.empty())
-        return false;
-
+// Moves offset to the start of the next match in the direction, going
+// around the end of the buffer at most once
+bool SearchCommand::performSearch(const Regex& pattern, char direction, size_t& offset, bool& wrapped) {
+    const TextBuffer& buffer = *editor.textBuffer;
+    size_t length = buffer.length();
+    RegexMatch match;
+    bool found = false;
     if (direction == '/') {
         // Forward search
-        for (int y = editor.cursorY; y < static_cast<int>(editor.textBuffer.size()); ++y) {
-            int startX = (y == editor.cursorY) ? editor.cursorX + 1 : 0;
-            size_t pos = editor.textBuffer[y].find(query, startX);
-            if (pos != std::string::npos) {
-                foundY = y;
-                foundX = static_cast<int>(pos);
-                editor.setStatusMessage("Found next: " + query, true);
-                return true;
-            }
-        }
-        for (int y = 0; y < editor.cursorY; ++y) {
-            int startX = (y == editor.cursorY) ? editor.cursorX + 1 : 0;
-            size_t pos = editor.textBuffer[y].find(query, startX);
-            if (pos != std::string::npos) {
-                foundY = y;
-                foundX = static_cast<int>(pos);
-                editor.setStatusMessage("search hit BOTTOM, continuing at TOP", true);
-                return true;
-            }
+        found = pattern.search(buffer, offset + 1, length, false, match);
+        if (!found) {
+            found = pattern.search(buffer, 0, offset, false, match);
+            wrapped = wrapped || found;
         }
     }
     else if (direction == '?') {
         // Backward search
-        for (int y = editor.cursorY; y >= 0; --y) {
-            int endX = (y == editor.cursorY) ? editor.cursorX - 1 : editor.textBuffer[y].size() - 1;
-            if (endX < 0)
-                continue;
-            size_t pos = editor.textBuffer[y].rfind(query, endX);
-            if (pos != std::string::npos) {
-                foundY = y;
-                foundX = static_cast<int>(pos);
-                editor.setStatusMessage("Found previous: " + query, true);
-                return true;
+        if (offset > 0) {
+            found = pattern.search(buffer, 0, offset - 1, true, match);
+        }
+        if (!found) {
+            found = pattern.search(buffer, offset, length, true, match);
+            wrapped = wrapped || found;
+        }
+    }
+    if (!found) {
+        return false;
+    }
+    offset = match.start;
+    return true;
+}
+
+bool SearchCommand::captureSearchInput(char direction, std::string& query) {
+    TextBuffer& buffer = *editor.textBuffer;
+    int originY = editor.cursorY;
+    int originX = editor.cursorX;
+    int originView = editor.getViewOffsetY();
+    size_t origin = buffer.offsetOf(originY, originX);
+    // The text cannot change under the prompt, so one snapshot serves
+    // every prefix
+    std::shared_ptr<const TextSnapshot> snapshot = buffer.snapshot();
+    IncrementalSearch incremental;
+    std::optional<IncrementalSearch::Result> preview;
+
+    auto moveBack = [&] {
+        editor.setCursorPosition(originY, originX);
+        editor.setViewOffsetY(originView);
+    };
+    query.clear();
+    editor.setPrompt(std::string(1, direction));
+    editor.render();
+    bool accepted = false;
+    while (true) {
+        // Only wake up without a key while a scan may still report
+        timeout(incremental.busy() || preview ? PreviewPollMs : -1);
+        int ch = editor.readKey();
+        timeout(-1);
+        bool changed = true;
+        if (ch == 27) {
+            break;
+        } else if (ch == '\n' || ch == '\r' || ch == KEY_ENTER) {
+            accepted = true;
+            break;
+        } else if (ch == KEY_BACKSPACE || ch == 127 || ch == 8) {
+            if (query.empty()) {
+                break;
             }
+            query.pop_back();
+        } else if ((ch >= 32 && ch < 256) || ch == '\t') {
+            query += static_cast<char>(ch);
+        } else {
+            changed = false;
         }
-        for (int y = static_cast<int>(editor.textBuffer.size()); y > editor.cursorY; --y) {
-            int endX = (y == editor.cursorY) ? editor.cursorX - 1 : editor.textBuffer[y].size() - 1;
-            if (endX < 0)
-                continue;
-            size_t pos = editor.textBuffer[y].rfind(query, endX);
-            if (pos != std::string::npos) {
-                foundY = y;
-                foundX = static_cast<int>(pos);
-                editor.setStatusMessage("search hit TOP, continuing at BOTTOM", true);
-                return true;
+
+        if (changed) {
+            // A new prefix: its scan replaces the last one's, and the cursor
+            // stays put until the result is in
+            Regex pattern;
+            std::string error;
+            preview.reset();
+            if (!query.empty() && pattern.compile(query, error)) {
+                incremental.start(pattern, snapshot, origin, direction == '?');
+            } else {
+                incremental.cancel();
+                moveBack();
             }
+            editor.setPrompt(direction + query);
         }
+        IncrementalSearch::Result result;
+        if (incremental.poll(result)) {
+            preview = result;
+        }
+        // Offsets only map to lines once the lines there are indexed
+        if (preview && !buffer.isIndexing()) {
+            if (preview->found) {
+                size_t offset = preview->match.start;
+                int y = buffer.lineAt(offset);
+                editor.setCursorPosition(y, static_cast<int>(offset - buffer.lineStart(y)));
+            } else {
+                moveBack();
+            }
+            preview.reset();
+        }
+        editor.render();
     }
-
-    return false; 
+    incremental.cancel();
+    moveBack();
+    editor.setPrompt("");
+    return accepted;
 }
-
@@ -44,6 +44,4 @@ void StatusBar::render(WINDOW* window, int rows, int cols) {
     wattron(window, COLOR_PAIR(leftColorPair));
     mvwprintw(window, rows - 1, cols - rightText.length(), "%s", rightText.c_str());
     wattroff(window, COLOR_PAIR(leftColorPair));
-
-    wrefresh(window);
 }
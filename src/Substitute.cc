@@ -0,0 +1,149 @@
+#include "Substitute.h"
+#include <algorithm>
+
+bool Replacement::parse(const std::string& text, const std::string& previous, std::string& error) {
+    // ~ goes first, so the previous replacement's own & and \r still count
+    expanded.clear();
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '\\' && i + 1 < text.size()) {
+            expanded += text[i++];
+            expanded += text[i];
+        } else if (text[i] == '~') {
+            expanded += previous;
+        } else {
+            expanded += text[i];
+        }
+    }
+
+    parts.clear();
+    auto literal = [this](char c) {
+        if (parts.empty() || parts.back().match) {
+            parts.push_back({"", false});
+        }
+        parts.back().text += c;
+    };
+    for (size_t i = 0; i < expanded.size(); i++) {
+        char c = expanded[i];
+        if (c == '&') {
+            parts.push_back({"", true});
+            continue;
+        }
+        if (c != '\\' || i + 1 == expanded.size()) {
+            literal(c);
+            continue;
+        }
+        c = expanded[++i];
+        switch (c) {
+            case '0': parts.push_back({"", true}); break;
+            case 'r': literal('\n'); break;
+            case 'n': literal('\0'); break;
+            case 't': literal('\t'); break;
+            default:
+                // Patterns report no submatches, only the whole match
+                if (c >= '1' && c <= '9') {
+                    error = "E65: Illegal back reference";
+                    return false;
+                }
+                literal(c);
+        }
+    }
+    return true;
+}
+
+const std::string& Replacement::source() const {
+    return expanded;
+}
+
+void Replacement::expand(const TextSnapshot& text, size_t start, size_t end, std::string& out) const {
+    for (const Part& part : parts) {
+        if (part.match) {
+            text.append(start, end - start, out);
+        } else {
+            out += part.text;
+        }
+    }
+}
+
+namespace {
+
+// Applies the edits of one stretch of the old text, [first, end], to the
+// buffer, where an old offset is shift bytes further on. Returns where
+// in the old text the last replaced match ends.
+size_t substituteIn(TextBuffer& buffer, const TextSnapshot& text, const Regex& pattern,
+                  const Replacement& replacement, size_t first, size_t end, bool everyMatch,
+                  long& shift, std::string& changed, size_t& lastEdit, SubstituteResult& result) {
+    RegexMatch match;
+    size_t at = first;
+    size_t replaced = first;
+    while (at <= end && pattern.search(text, at, end, false, match)) {
+        size_t lineEnd = std::min(text.lineEnd(match.start), end);
+        size_t from = match.start;
+        size_t copied = match.start;
+        changed.clear();
+        while (true) {
+            text.append(copied, match.start - copied, changed);
+            replacement.expand(text, match.start, match.end, changed);
+            copied = match.end;
+            result.substitutions++;
+            // An empty match keeps the character after it
+            size_t next = std::max(match.end, match.start + 1);
+            if (!everyMatch || next > lineEnd || !pattern.search(text, next, lineEnd, false, match)) {
+                break;
+            }
+        }
+        size_t offset = from + shift;
+        buffer.eraseAt(offset, copied - from);
+        buffer.insertAt(offset, changed);
+        shift += static_cast<long>(changed.size()) - static_cast<long>(copied - from);
+        lastEdit = offset;
+        result.lines++;
+        replaced = copied;
+        at = std::max(lineEnd + 1, copied);
+    }
+    return replaced;
+}
+
+}
+
+SubstituteResult substituteLines(TextBuffer& buffer, const Regex& pattern, const Replacement& replacement,
+                                 int first, int last, bool everyMatch) {
+    SubstituteResult result;
+    std::shared_ptr<const TextSnapshot> before = buffer.snapshot();
+    long shift = 0;
+    size_t lastEdit = 0;
+    std::string changed; // a line's text from its first match to its last
+    substituteIn(buffer, *before, pattern, replacement, buffer.lineStart(first),
+                 buffer.lineStart(last) + buffer.lineLength(last), everyMatch, shift, changed, lastEdit,
+                 result);
+    if (result.lines > 0) {
+        result.lastLine = buffer.lineAt(lastEdit);
+    }
+    return result;
+}
+
+SubstituteResult substituteLines(TextBuffer& buffer, const Regex& pattern, const Replacement& replacement,
+                                 const std::vector<int>& lines, bool everyMatch) {
+    SubstituteResult result;
+    std::shared_ptr<const TextSnapshot> before = buffer.snapshot();
+    // Where each line is in the old text, before anything moves
+    std::vector<std::pair<size_t, size_t>> spans;
+    spans.reserve(lines.size());
+    for (int y : lines) {
+        size_t start = buffer.lineStart(y);
+        spans.push_back({start, start + buffer.lineLength(y)});
+    }
+    long shift = 0;
+    size_t lastEdit = 0;
+    size_t done = 0; // a match over a line break may take in the next lines
+    std::string changed;
+    for (const auto& [start, end] : spans) {
+        if (start >= done) {
+            done = substituteIn(buffer, *before, pattern, replacement, start, end, everyMatch, shift,
+                                changed, lastEdit, result);
+        }
+    }
+    if (result.lines > 0) {
+        result.lastLine = buffer.lineAt(lastEdit);
+    }
+    return result;
+}
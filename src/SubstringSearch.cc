@@ -0,0 +1,310 @@
+#include "SubstringSearch.h"
+#include "TextBuffer.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VM_X86 1
+#endif
+
+namespace {
+
+size_t horspool(std::string_view text, size_t from, std::string_view needle,
+                const std::array<uint32_t, 256>& skip) {
+    size_t m = needle.size();
+    const char* data = text.data();
+    char last = needle[m - 1];
+    for (size_t s = from; s + m <= text.size();) {
+        char c = data[s + m - 1];
+        if (c == last && std::memcmp(data + s, needle.data(), m - 1) == 0) {
+            return s;
+        }
+        s += skip[static_cast<unsigned char>(c)];
+    }
+    return SubstringSearch::npos;
+}
+
+// Horspool mirrored: the window slides left by the shift of its first byte
+size_t horspoolBack(std::string_view text, size_t from, std::string_view needle,
+                    const std::array<uint32_t, 256>& backSkip) {
+    size_t m = needle.size();
+    const char* data = text.data();
+    char first = needle[0];
+    size_t s = std::min(from, text.size() - m);
+    while (true) {
+        char c = data[s];
+        if (c == first && std::memcmp(data + s + 1, needle.data() + 1, m - 1) == 0) {
+            return s;
+        }
+        size_t shift = backSkip[static_cast<unsigned char>(c)];
+        if (s < shift) {
+            return SubstringSearch::npos;
+        }
+        s -= shift;
+    }
+}
+
+#ifdef VM_X86
+// The filter kernels build a mask of the positions in a block where both
+// the first and the last needle byte line up, then compare the middle of
+// the needle at each one. Whatever does not fill a block goes to the
+// next narrower kernel, and to Horspool after SSE2.
+
+__attribute__((target("sse2")))
+inline uint32_t candidates16(const char* p, size_t m, __m128i first, __m128i last) {
+    __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + m - 1));
+    return _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last)));
+}
+
+__attribute__((target("sse2")))
+size_t filterSse2(std::string_view text, size_t from, std::string_view needle,
+                  const std::array<uint32_t, 256>& skip) {
+    size_t m = needle.size();
+    const char* data = text.data();
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[m - 1]);
+    size_t s = from;
+    for (; s + 16 + m - 1 <= text.size(); s += 16) {
+        uint32_t mask = candidates16(data + s, m, first, last);
+        while (mask) {
+            size_t k = __builtin_ctz(mask);
+            if (std::memcmp(data + s + k + 1, needle.data() + 1, m - 2) == 0) {
+                return s + k;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return horspool(text, s, needle, skip);
+}
+
+// Blocks of start positions [top - 16, top), highest first
+__attribute__((target("sse2")))
+size_t filterBackSse2(std::string_view text, size_t top, std::string_view needle,
+                      const std::array<uint32_t, 256>& backSkip) {
+    size_t m = needle.size();
+    const char* data = text.data();
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[m - 1]);
+    for (; top >= 16; top -= 16) {
+        size_t s = top - 16;
+        uint32_t mask = candidates16(data + s, m, first, last);
+        while (mask) {
+            size_t k = 31 - __builtin_clz(mask);
+            if (std::memcmp(data + s + k + 1, needle.data() + 1, m - 2) == 0) {
+                return s + k;
+            }
+            mask &= ~(1u << k);
+        }
+    }
+    return top ? horspoolBack(text, top - 1, needle, backSkip) : SubstringSearch::npos;
+}
+
+__attribute__((target("avx2")))
+inline uint32_t candidates32(const char* p, size_t m, __m256i first, __m256i last) {
+    __m256i head = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i tail = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + m - 1));
+    return _mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(head, first), _mm256_cmpeq_epi8(tail, last)));
+}
+
+__attribute__((target("avx2")))
+size_t filterAvx2(std::string_view text, size_t from, std::string_view needle,
+                  const std::array<uint32_t, 256>& skip) {
+    size_t m = needle.size();
+    const char* data = text.data();
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[m - 1]);
+    size_t s = from;
+    for (; s + 32 + m - 1 <= text.size(); s += 32) {
+        uint32_t mask = candidates32(data + s, m, first, last);
+        while (mask) {
+            size_t k = __builtin_ctz(mask);
+            if (std::memcmp(data + s + k + 1, needle.data() + 1, m - 2) == 0) {
+                return s + k;
+            }
+            mask &= mask - 1;
+        }
+    }
+    // The SSE2 kernels are not VEX encoded
+    _mm256_zeroupper();
+    return filterSse2(text, s, needle, skip);
+}
+
+__attribute__((target("avx2")))
+size_t filterBackAvx2(std::string_view text, size_t top, std::string_view needle,
+                      const std::array<uint32_t, 256>& backSkip) {
+    size_t m = needle.size();
+    const char* data = text.data();
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[m - 1]);
+    for (; top >= 32; top -= 32) {
+        size_t s = top - 32;
+        uint32_t mask = candidates32(data + s, m, first, last);
+        while (mask) {
+            size_t k = 31 - __builtin_clz(mask);
+            if (std::memcmp(data + s + k + 1, needle.data() + 1, m - 2) == 0) {
+                return s + k;
+            }
+            mask &= ~(1u << k);
+        }
+    }
+    // The SSE2 kernels are not VEX encoded
+    _mm256_zeroupper();
+    return filterBackSse2(text, top, needle, backSkip);
+}
+#endif
+
+}
+
+SubstringSearch::SubstringSearch(std::string_view needle) : SubstringSearch(needle, bestScanKernel()) {}
+
+SubstringSearch::SubstringSearch(std::string_view needle, ScanKernel kernel)
+    : pattern(needle), kernel(kernel), filter(needle.size() <= MaxFilterLength) {
+    size_t m = pattern.size();
+    skip.fill(m);
+    backSkip.fill(m);
+    for (size_t i = 0; i + 1 < m; i++) {
+        skip[static_cast<unsigned char>(pattern[i])] = m - 1 - i;
+    }
+    for (size_t i = m; i-- > 1;) {
+        backSkip[static_cast<unsigned char>(pattern[i])] = i;
+    }
+}
+
+const std::string& SubstringSearch::needle() const {
+    return pattern;
+}
+
+size_t SubstringSearch::size() const {
+    return pattern.size();
+}
+
+size_t SubstringSearch::find(std::string_view text, size_t from) const {
+    size_t m = pattern.size();
+    if (m == 0 || from > text.size() || text.size() - from < m) {
+        return npos;
+    }
+    if (m == 1) {
+        const void* hit = std::memchr(text.data() + from, pattern[0], text.size() - from);
+        return hit ? static_cast<const char*>(hit) - text.data() : npos;
+    }
+    if (filter) {
+        switch (kernel) {
+#ifdef VM_X86
+            case ScanKernel::Avx2: return filterAvx2(text, from, pattern, skip);
+            case ScanKernel::Sse2: return filterSse2(text, from, pattern, skip);
+#endif
+            default: break;
+        }
+    }
+    return horspool(text, from, pattern, skip);
+}
+
+size_t SubstringSearch::rfind(std::string_view text, size_t from) const {
+    size_t m = pattern.size();
+    if (m == 0 || text.size() < m) {
+        return npos;
+    }
+    from = std::min(from, text.size() - m);
+    if (m == 1) {
+        const void* hit = memrchr(text.data(), pattern[0], from + 1);
+        return hit ? static_cast<const char*>(hit) - text.data() : npos;
+    }
+    if (filter) {
+        switch (kernel) {
+#ifdef VM_X86
+            case ScanKernel::Avx2: return filterBackAvx2(text, from + 1, pattern, backSkip);
+            case ScanKernel::Sse2: return filterBackSse2(text, from + 1, pattern, backSkip);
+#endif
+            default: break;
+        }
+    }
+    return horspoolBack(text, from, pattern, backSkip);
+}
+
+namespace {
+
+template <typename Text>
+void copyBytes(const Text& text, size_t offset, size_t count, std::string& out) {
+    out.clear();
+    size_t end = std::min(offset + count, text.length());
+    while (offset < end) {
+        size_t chunkStart;
+        std::string_view chunk = text.chunkAt(offset, chunkStart);
+        size_t n = std::min(chunkStart + chunk.size(), end) - offset;
+        out.append(chunk.data() + (offset - chunkStart), n);
+        offset += n;
+    }
+}
+
+// Buffers and snapshots alike, read a stored chunk at a time
+template <typename Text>
+size_t findIn(const SubstringSearch& search, const Text& buffer, size_t first, size_t last, bool backward) {
+    size_t m = search.size();
+    size_t length = buffer.length();
+    if (m == 0 || length < m || first > last || first > length - m) {
+        return SubstringSearch::npos;
+    }
+    // Every byte a match in range can touch
+    size_t end = std::min(last, length - m) + m;
+    std::string seam;
+
+    // Each chunk is searched in place; a match that crosses into the
+    // next chunk starts in the last m - 1 bytes before the seam, so those
+    // are copied out with what follows and searched on their own
+    if (!backward) {
+        for (size_t at = first; at < end;) {
+            size_t chunkStart;
+            std::string_view chunk = buffer.chunkAt(at, chunkStart);
+            size_t chunkEnd = std::min(chunkStart + chunk.size(), end);
+            size_t hit = search.find(chunk.substr(0, chunkEnd - chunkStart), at - chunkStart);
+            if (hit != SubstringSearch::npos) {
+                return chunkStart + hit;
+            }
+            if (chunkEnd == end) {
+                break;
+            }
+            size_t from = std::max(at, chunkEnd - std::min(chunkEnd, m - 1));
+            copyBytes(buffer, from, std::min(chunkEnd + m - 1, end) - from, seam);
+            hit = search.find(seam);
+            if (hit != SubstringSearch::npos) {
+                return from + hit;
+            }
+            at = chunkEnd;
+        }
+        return SubstringSearch::npos;
+    }
+
+    for (size_t top = end; top > first;) {
+        size_t chunkStart;
+        std::string_view chunk = buffer.chunkAt(top - 1, chunkStart);
+        size_t bottom = std::max(chunkStart, first);
+        size_t hit = search.rfind(chunk.substr(bottom - chunkStart, top - bottom));
+        if (hit != SubstringSearch::npos) {
+            return bottom + hit;
+        }
+        if (bottom == first) {
+            break;
+        }
+        size_t from = std::max(first, bottom - std::min(bottom, m - 1));
+        copyBytes(buffer, from, std::min(bottom + m - 1, top) - from, seam);
+        hit = search.rfind(seam);
+        if (hit != SubstringSearch::npos) {
+            return from + hit;
+        }
+        top = bottom;
+    }
+    return SubstringSearch::npos;
+}
+
+}
+
+size_t SubstringSearch::find(const TextBuffer& buffer, size_t first, size_t last, bool backward) const {
+    return findIn(*this, buffer, first, last, backward);
+}
+
+size_t SubstringSearch::find(const TextSnapshot& snapshot, size_t first, size_t last, bool backward) const {
+    return findIn(*this, snapshot, first, last, backward);
+}
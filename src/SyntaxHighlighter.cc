@@ -4,13 +4,15 @@ SyntaxHighlighter::SyntaxHighlighter() {}
 
 SyntaxHighlighter::~SyntaxHighlighter() {}
 
-std::vector<std::pair<TokenType, std::string>> SyntaxHighlighter::highlight(const std::string& line) {
-    std::vector<std::pair<TokenType, std::string>> highlightedTokens;
-    std::vector<Token> tokens = lexer.tokenize(line);
+void SyntaxHighlighter::setGrammar(const Grammar* grammar) {
+    lexer.setGrammar(grammar);
+}
 
-    for (const auto& token : tokens) {
-        highlightedTokens.emplace_back(std::make_pair(token.type, token.text));
-    }
+void SyntaxHighlighter::highlight(std::string_view line, std::vector<Token>& tokens) {
+    LexerState state;
+    highlight(line, state, tokens);
+}
 
-    return highlightedTokens;
+void SyntaxHighlighter::highlight(std::string_view line, LexerState& state, std::vector<Token>& tokens) {
+    lexer.tokenize(line, state, tokens);
 }
@@ -0,0 +1,218 @@
+#include "TextBuffer.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+std::string joinLines(const std::vector<std::string>& lines) {
+    size_t total = lines.size();
+    for (const auto& line : lines) {
+        total += line.size();
+    }
+    std::string joined;
+    joined.reserve(total);
+    for (size_t i = 0; i < lines.size(); i++) {
+        if (i > 0) {
+            joined += '\n';
+        }
+        joined += lines[i];
+    }
+    return joined;
+}
+
+// Scans the chunks from offset for the next '\n'
+template <typename Text>
+size_t findLineEnd(const Text& text, size_t offset) {
+    size_t total = text.length();
+    while (offset < total) {
+        size_t chunkStart;
+        std::string_view chunk = text.chunkAt(offset, chunkStart);
+        const char* from = chunk.data() + (offset - chunkStart);
+        const void* found = std::memchr(from, '\n', chunk.size() - (offset - chunkStart));
+        if (found) {
+            return offset + (static_cast<const char*>(found) - from);
+        }
+        offset = chunkStart + chunk.size();
+    }
+    return total;
+}
+
+}
+
+void TextSnapshot::append(size_t offset, size_t count, std::string& out) const {
+    size_t end = std::min(offset + count, length());
+    while (offset < end) {
+        size_t chunkStart;
+        std::string_view chunk = chunkAt(offset, chunkStart);
+        size_t n = std::min(chunkStart + chunk.size(), end) - offset;
+        out.append(chunk.data() + (offset - chunkStart), n);
+        offset += n;
+    }
+}
+
+size_t TextSnapshot::lineEnd(size_t offset) const {
+    return findLineEnd(*this, offset);
+}
+
+void TextBuffer::insertAt(size_t offset, std::string_view text) {
+    offset = std::min(offset, length());
+    if (text.empty()) {
+        return;
+    }
+    insertBytes(offset, text);
+    for (TextBufferListener* listener : listeners) {
+        listener->onInsert(offset, text);
+    }
+}
+
+void TextBuffer::eraseAt(size_t offset, size_t count) {
+    if (offset >= length() || count == 0) {
+        return;
+    }
+    count = std::min(count, length() - offset);
+    if (listeners.empty()) {
+        eraseBytes(offset, count);
+        return;
+    }
+    std::string removed = substr(offset, count);
+    eraseBytes(offset, count);
+    for (TextBufferListener* listener : listeners) {
+        listener->onErase(offset, removed);
+    }
+}
+
+void TextBuffer::addListener(TextBufferListener* listener) {
+    listeners.push_back(listener);
+}
+
+void TextBuffer::removeListener(TextBufferListener* listener) {
+    listeners.erase(std::remove(listeners.begin(), listeners.end(), listener), listeners.end());
+}
+
+std::string TextBuffer::substr(size_t offset, size_t count) const {
+    std::string out;
+    copy(offset, count, out);
+    return out;
+}
+
+std::string TextBuffer::line(int y) const {
+    std::string out;
+    line(y, out);
+    return out;
+}
+
+void TextBuffer::line(int y, std::string& out) const {
+    copy(lineStart(y), lineLength(y), out);
+}
+
+int TextBuffer::lineLength(int y) const {
+    size_t start = lineStart(y);
+    size_t end;
+    if (y + 1 < lineCount()) {
+        end = lineStart(y + 1) - 1;
+    } else if (isIndexing()) {
+        // The last line found so far ends at the next '\n', which the
+        // index may not have reached yet; it is not the rest of the file
+        end = lineEnd(start);
+    } else {
+        end = length();
+    }
+    return static_cast<int>(end - start);
+}
+
+size_t TextBuffer::lineEnd(size_t offset) const {
+    return findLineEnd(*this, offset);
+}
+
+char TextBuffer::charAt(int y, int x) const {
+    if (y < 0 || y >= lineCount() || x < 0 || x >= lineLength(y)) {
+        return '\0';
+    }
+    return byteAt(lineStart(y) + x);
+}
+
+size_t TextBuffer::offsetOf(int y, int x) const {
+    return lineStart(y) + x;
+}
+
+void TextBuffer::insert(int y, int x, std::string_view text) {
+    insertAt(offsetOf(y, std::clamp(x, 0, lineLength(y))), text);
+}
+
+void TextBuffer::erase(int y, int x, size_t count) {
+    size_t offset = offsetOf(y, x);
+    if (offset >= length()) {
+        return;
+    }
+    eraseAt(offset, std::min(count, length() - offset));
+}
+
+void TextBuffer::insertLines(int y, const std::vector<std::string>& lines) {
+    if (lines.empty()) {
+        return;
+    }
+    std::string joined = joinLines(lines);
+    if (y < lineCount()) {
+        joined += '\n';
+        insertAt(lineStart(y), joined);
+    } else {
+        insertAt(length(), "\n" + joined);
+    }
+}
+
+void TextBuffer::eraseLines(int y, int count) {
+    int total = lineCount();
+    if (count <= 0 || y < 0 || y >= total) {
+        return;
+    }
+    int last = std::min(y + count, total);
+    if (last < total) {
+        size_t start = lineStart(y);
+        eraseAt(start, lineStart(last) - start);
+    } else if (y > 0) {
+        // Erasing through the final line also takes the newline before it
+        size_t start = lineStart(y) - 1;
+        eraseAt(start, length() - start);
+    } else {
+        eraseAt(0, length());
+    }
+}
+
+void TextBuffer::eraseLines(const std::vector<int>& lines) {
+    for (size_t i = lines.size(); i > 0;) {
+        size_t runEnd = i--;
+        while (i > 0 && lines[i - 1] + 1 == lines[i]) {
+            i--;
+        }
+        eraseLines(lines[i], lines[runEnd - 1] - lines[i] + 1);
+    }
+}
+
+void TextBuffer::replaceLine(int y, std::string_view text) {
+    size_t start = lineStart(y);
+    eraseAt(start, lineLength(y));
+    insertAt(start, text);
+}
+
+std::vector<std::string> TextBuffer::lines() const {
+    std::vector<std::string> result(1);
+    forEachChunk([&result](const char* data, size_t size) {
+        const char* end = data + size;
+        while (data < end) {
+            const char* newline = static_cast<const char*>(memchr(data, '\n', end - data));
+            if (!newline) {
+                result.back().append(data, end);
+                break;
+            }
+            result.back().append(data, newline);
+            result.emplace_back();
+            data = newline + 1;
+        }
+    });
+    return result;
+}
+
+void TextBuffer::assign(const std::vector<std::string>& lines) {
+    reset(nullptr);
+    insertAt(0, joinLines(lines));
+}
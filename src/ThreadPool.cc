@@ -0,0 +1,129 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threads) : job(nullptr), jobs(0), busy(0), stopping(false) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned i = 0; i < threads; i++) {
+        shares.push_back(std::make_unique<Share>());
+    }
+    for (unsigned i = 1; i < threads; i++) {
+        this->threads.emplace_back(&ThreadPool::helper, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+unsigned ThreadPool::size() const {
+    return shares.size();
+}
+
+void ThreadPool::run(size_t count, const std::function<void(size_t, unsigned)>& task) {
+    std::lock_guard<std::mutex> serial(runMutex);
+    size_t workers = shares.size();
+    for (size_t i = 0; i < workers; i++) {
+        std::lock_guard<std::mutex> lock(shares[i]->mutex);
+        shares[i]->next = count * i / workers;
+        shares[i]->end = count * (i + 1) / workers;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &task;
+        jobs++;
+        busy = threads.size();
+    }
+    wake.notify_all();
+    work(0, task);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return busy == 0; });
+    job = nullptr;
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::helper(unsigned worker) {
+    unsigned long seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [&] { return stopping || jobs != seen; });
+        if (stopping) {
+            return;
+        }
+        seen = jobs;
+        const std::function<void(size_t, unsigned)>& task = *job;
+        lock.unlock();
+
+        work(worker, task);
+
+        lock.lock();
+        if (--busy == 0) {
+            finished.notify_one();
+        }
+    }
+}
+
+void ThreadPool::work(unsigned worker, const std::function<void(size_t, unsigned)>& task) {
+    size_t i;
+    while (take(worker, i) || (steal(worker) && take(worker, i))) {
+        task(i, worker);
+    }
+}
+
+bool ThreadPool::take(unsigned worker, size_t& task) {
+    Share& own = *shares[worker];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (own.next == own.end) {
+        return false;
+    }
+    task = own.next++;
+    return true;
+}
+
+bool ThreadPool::steal(unsigned worker) {
+    while (true) {
+        // The longest run left
+        size_t victim = worker;
+        size_t longest = 0;
+        for (size_t i = 0; i < shares.size(); i++) {
+            std::lock_guard<std::mutex> lock(shares[i]->mutex);
+            if (shares[i]->end - shares[i]->next > longest) {
+                longest = shares[i]->end - shares[i]->next;
+                victim = i;
+            }
+        }
+        if (longest == 0) {
+            return false;
+        }
+        size_t from, to;
+        {
+            std::lock_guard<std::mutex> lock(shares[victim]->mutex);
+            Share& other = *shares[victim];
+            if (other.next == other.end) {
+                continue; // taken in the meantime, look again
+            }
+            // A run of one is taken whole
+            from = other.next + (other.end - other.next) / 2;
+            to = other.end;
+            other.end = from;
+        }
+        Share& own = *shares[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        own.next = from;
+        own.end = to;
+        return true;
+    }
+}
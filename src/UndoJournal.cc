@@ -0,0 +1,216 @@
+#include "UndoJournal.h"
+#include <algorithm>
+
+UndoJournal::UndoJournal() : current(0), pending{}, replaying(false) {
+    nodes.push_back(root());
+}
+
+void UndoJournal::onInsert(size_t offset, std::string_view text) {
+    if (replaying) {
+        return;
+    }
+    std::vector<EditDelta>& deltas = pending.deltas;
+    if (!deltas.empty()) {
+        // Typing continues right where the previous insert ended
+        EditDelta& last = deltas.back();
+        if (offset == last.offset + last.inserted.size()) {
+            last.inserted.append(text);
+            return;
+        }
+    }
+    deltas.push_back({offset, "", std::string(text)});
+}
+
+void UndoJournal::onErase(size_t offset, std::string_view removed) {
+    if (replaying) {
+        return;
+    }
+    std::vector<EditDelta>& deltas = pending.deltas;
+    if (!deltas.empty()) {
+        EditDelta& last = deltas.back();
+        size_t insertedEnd = last.offset + last.inserted.size();
+        if (offset >= last.offset && offset + removed.size() == insertedEnd) {
+            // Backspacing over text typed in this same step
+            last.inserted.erase(offset - last.offset);
+            if (last.inserted.empty() && last.removed.empty()) {
+                deltas.pop_back();
+            }
+            return;
+        }
+        if (last.inserted.empty()) {
+            if (offset + removed.size() == last.offset) {
+                // Repeated backspace
+                last.removed.insert(0, removed);
+                last.offset = offset;
+                return;
+            }
+            if (offset == last.offset) {
+                // Repeated delete at the same spot
+                last.removed.append(removed);
+                return;
+            }
+        }
+    }
+    deltas.push_back({offset, std::string(removed), ""});
+}
+
+void UndoJournal::beginStep(int cursorY, int cursorX) {
+    if (pending.deltas.empty()) {
+        pending.cursorYBefore = cursorY;
+        pending.cursorXBefore = cursorX;
+    }
+}
+
+void UndoJournal::commit(int cursorY, int cursorX, std::time_t when) {
+    if (pending.deltas.empty()) {
+        return;
+    }
+    long index = static_cast<long>(nodes.size());
+    pending.cursorYAfter = cursorY;
+    pending.cursorXAfter = cursorX;
+    pending.seq = index;
+    // Keep times ordered by seq even if the clock steps backwards
+    if (nodes.size() == 1) {
+        nodes[0].time = std::min(nodes[0].time, when);
+    }
+    pending.time = std::max(when, nodes.back().time);
+    pending.parent = current;
+    pending.depth = nodes[current].depth + 1;
+    pending.redoChild = -1;
+    nodes[current].children.push_back(index);
+    nodes[current].redoChild = index;
+    nodes.push_back(std::move(pending));
+    current = index;
+    pending = UndoRecord{};
+}
+
+bool UndoJournal::hasPending() const {
+    return !pending.deltas.empty();
+}
+
+bool UndoJournal::undo(TextBuffer& textBuffer, int& cursorY, int& cursorX) {
+    commit(cursorY, cursorX);
+    if (current == 0) {
+        return false;
+    }
+    const UndoRecord& record = nodes[current];
+    apply(textBuffer, record, false);
+    cursorY = record.cursorYBefore;
+    cursorX = record.cursorXBefore;
+    nodes[record.parent].redoChild = current;
+    current = record.parent;
+    return true;
+}
+
+bool UndoJournal::redo(TextBuffer& textBuffer, int& cursorY, int& cursorX) {
+    commit(cursorY, cursorX);
+    long next = nodes[current].redoChild;
+    if (next < 0) {
+        return false;
+    }
+    const UndoRecord& record = nodes[next];
+    apply(textBuffer, record, true);
+    cursorY = record.cursorYBefore;
+    cursorX = record.cursorXBefore;
+    current = next;
+    return true;
+}
+
+bool UndoJournal::stepChronological(TextBuffer& textBuffer, long steps, int& cursorY, int& cursorX) {
+    commit(cursorY, cursorX);
+    long target = std::clamp(current + steps, 0L, static_cast<long>(nodes.size()) - 1);
+    return gotoSeq(textBuffer, target, cursorY, cursorX);
+}
+
+bool UndoJournal::stepTime(TextBuffer& textBuffer, long seconds, int& cursorY, int& cursorX) {
+    commit(cursorY, cursorX);
+    std::time_t when = nodes[current].time + seconds;
+    // Times only grow with seq, so the newest state at or before `when`
+    // is found by binary search
+    auto after = std::upper_bound(nodes.begin(), nodes.end(), when,
+        [](std::time_t t, const UndoRecord& node) { return t < node.time; });
+    long target = std::max(static_cast<long>(after - nodes.begin()) - 1, 0L);
+    return gotoSeq(textBuffer, target, cursorY, cursorX);
+}
+
+bool UndoJournal::gotoSeq(TextBuffer& textBuffer, unsigned long seq, int& cursorY, int& cursorX) {
+    commit(cursorY, cursorX);
+    long target = static_cast<long>(seq);
+    if (target >= static_cast<long>(nodes.size()) || target == current) {
+        return false;
+    }
+
+    // Undo up to the common ancestor, then redo down to the target
+    std::vector<long> down;
+    long up = current;
+    long to = target;
+    while (nodes[to].depth > nodes[up].depth) {
+        down.push_back(to);
+        to = nodes[to].parent;
+    }
+    while (nodes[up].depth > nodes[to].depth) {
+        up = nodes[up].parent;
+    }
+    while (up != to) {
+        down.push_back(to);
+        up = nodes[up].parent;
+        to = nodes[to].parent;
+    }
+    while (current != up) {
+        undo(textBuffer, cursorY, cursorX);
+    }
+    for (auto it = down.rbegin(); it != down.rend(); ++it) {
+        nodes[current].redoChild = *it;
+        redo(textBuffer, cursorY, cursorX);
+    }
+    return true;
+}
+
+unsigned long UndoJournal::currentSeq() const {
+    return nodes[current].seq;
+}
+
+unsigned long UndoJournal::lastSeq() const {
+    return nodes.size() - 1;
+}
+
+std::vector<const UndoRecord*> UndoJournal::leaves() const {
+    std::vector<const UndoRecord*> result;
+    for (size_t i = 1; i < nodes.size(); i++) {
+        if (nodes[i].children.empty()) {
+            result.push_back(&nodes[i]);
+        }
+    }
+    return result;
+}
+
+void UndoJournal::clear() {
+    nodes.clear();
+    nodes.push_back(root());
+    current = 0;
+    pending = UndoRecord{};
+}
+
+void UndoJournal::apply(TextBuffer& textBuffer, const UndoRecord& record, bool forward) {
+    replaying = true;
+    if (forward) {
+        for (const EditDelta& delta : record.deltas) {
+            textBuffer.eraseAt(delta.offset, delta.removed.size());
+            textBuffer.insertAt(delta.offset, delta.inserted);
+        }
+    } else {
+        for (auto it = record.deltas.rbegin(); it != record.deltas.rend(); ++it) {
+            textBuffer.eraseAt(it->offset, it->inserted.size());
+            textBuffer.insertAt(it->offset, it->removed);
+        }
+    }
+    replaying = false;
+}
+
+UndoRecord UndoJournal::root() const {
+    UndoRecord record{};
+    record.time = std::time(nullptr);
+    record.parent = -1;
+    record.redoChild = -1;
+    return record;
+}
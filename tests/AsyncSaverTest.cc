@@ -0,0 +1,60 @@
+#include "AsyncSaver.h"
+#include "PieceTable.h"
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static std::string readAll(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    std::stringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+int main() {
+    auto fileManager = std::make_shared<FileManager>();
+    PieceTable buffer;
+    buffer.assign({"first"});
+
+    // A snapshot keeps the contents it was taken with
+    auto first = buffer.snapshot();
+    buffer.insertAt(buffer.length(), "\nsecond");
+    assert(first->length() == 5);
+
+    std::string filename = "test_async.txt";
+    {
+        AsyncSaver saver(fileManager);
+        saver.save(filename, first, 1);
+        // Queued saves of the same file land in order, newest last
+        for (unsigned long tag = 2; tag <= 20; tag++) {
+            buffer.insertAt(buffer.length(), "x");
+            saver.save(filename, buffer.snapshot(), tag);
+        }
+        saver.wait();
+        assert(!saver.busy());
+        std::vector<AsyncSaver::Result> results = saver.takeResults();
+        assert(!results.empty() && results.size() <= 20);
+        for (size_t i = 1; i < results.size(); i++) {
+            assert(results[i].tag > results[i - 1].tag);
+        }
+        assert(results.back().ok && results.back().tag == 20);
+        assert(readAll(filename) == buffer.substr(0, buffer.length()) + "\n");
+
+        // Failures are reported, not thrown
+        saver.save("no_such_directory/file.txt", buffer.snapshot(), 21);
+        saver.wait();
+        results = saver.takeResults();
+        assert(results.size() == 1 && !results[0].ok);
+
+        // The destructor finishes what is still queued
+        buffer.insertAt(0, "last ");
+        saver.save(filename, buffer.snapshot(), 22);
+    }
+    assert(readAll(filename) == buffer.substr(0, buffer.length()) + "\n");
+    std::remove(filename.c_str());
+
+    std::cout << "AsyncSaverTest passed.\n";
+    return 0;
+}
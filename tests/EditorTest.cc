@@ -0,0 +1,55 @@
+#include "ColonCommands.h"
+#include "CommandParser.h"
+#include "Editor.h"
+#include <cassert>
+#include <iostream>
+#include <string>
+
+// Records keys into reg as readKey would hand them over while q records
+static void record(Editor& editor, char reg, const std::string& keys, const std::string& insertMode) {
+    assert(editor.macros.start(reg));
+    for (size_t i = 0; i < keys.size(); i++) {
+        editor.macros.record(static_cast<unsigned char>(keys[i]), insertMode[i] == 'i');
+    }
+    editor.macros.record('q', false);
+    editor.macros.stop();
+}
+
+int main() {
+    // No terminal: nothing is drawn while keys run, so none is needed
+    Editor editor;
+    CommandParser commandParser(editor);
+    editor.setCommandParser(commandParser);
+    editor.textBuffer->assign({"a", "b", "c", "d"});
+
+    // qqA!<Esc>j.jq: the macro's own change is the one . repeats
+    record(editor, 'q', "A!\x1bj.j", "cii ccc");
+    editor.playMacro('q', 1);
+    assert((editor.textBuffer->lines() == std::vector<std::string>{"a!", "b!", "c", "d"}));
+    assert(editor.cursorY == 2);
+    editor.playMacro('@', 1);
+    assert((editor.textBuffer->lines() == std::vector<std::string>{"a!", "b!", "c!", "d!"}));
+
+    // And it stays the last change after the macro
+    editor.repeatLastChange();
+    assert(editor.textBuffer->lines().back() == "d!!");
+
+    // :g/pat/normal . repeats the last change on every marked line
+    editor.textBuffer->assign({"x", "y", "x"});
+    editor.setCursorPosition(0, 0);
+    editor.runKeys("A?\x1b");
+    ColonCommands(editor).execute("g/x/normal .");
+    assert((editor.textBuffer->lines() == std::vector<std::string>{"x??", "y", "x?"}));
+
+    // An entry that can't be reached leaves the current one where it was
+    assert(editor.getIsModified());
+    editor.setQuickfix({{"", 0, 0, "x??"}, {"other.txt", 0, 0, "z"}, {"", 2, 0, "x?"}}, true);
+    editor.stepQuickfix(1);
+    editor.stepQuickfix(1);
+    assert(editor.cursorY == 0);
+    editor.stepQuickfix(2);
+    assert(editor.cursorY == 2);
+
+    std::cout << "EditorTest passed." << std::endl;
+    return 0;
+}
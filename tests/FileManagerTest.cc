@@ -1,16 +1,21 @@
 #include "FileManager.h"
+#include "PieceTable.h"
+#include <cassert>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <sys/stat.h>
 
 int main() {
     FileManager fileManager;
-    std::vector<std::string> textBuffer;
+    PieceTable textBuffer;
 
     // Test Loading a File
     std::string filename = "test.txt";
     std::cout << "Loading file: " << filename << "\n";
     if (fileManager.loadFile(filename, textBuffer)) {
         std::cout << "File loaded successfully. Contents:\n";
-        for (const auto& line : textBuffer) {
+        for (const auto& line : textBuffer.lines()) {
             std::cout << line << "\n";
         }
     } else {
@@ -18,7 +23,7 @@ int main() {
     }
 
     // Modify the text buffer
-    textBuffer.emplace_back("This line was added during the test.");
+    textBuffer.insertLines(textBuffer.lineCount(), {"This line was added during the test."});
 
     // Test Saving the File
     std::string saveFilename = "test_saved.txt";
@@ -29,5 +34,18 @@ int main() {
         std::cout << "Failed to save file.\n";
     }
 
+    // Saving over a file keeps its permissions
+    std::string permFilename = "test_permissions.txt";
+    std::ofstream(permFilename) << "old\n";
+    chmod(permFilename.c_str(), 0640);
+    assert(fileManager.saveFile(permFilename, textBuffer));
+    struct stat info;
+    assert(stat(permFilename.c_str(), &info) == 0);
+    assert((info.st_mode & 07777) == 0640);
+    PieceTable reloaded;
+    assert(fileManager.loadFile(permFilename, reloaded));
+    assert(reloaded.lines() == textBuffer.lines());
+    std::remove(permFilename.c_str());
+
     return 0;
 }
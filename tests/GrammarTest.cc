@@ -0,0 +1,131 @@
+#include "GrammarRegistry.h"
+#include "Lexer.h"
+#include <cassert>
+#include <iostream>
+
+static GrammarRegistry grammars;
+
+// The type of the token starting at column x
+static TokenType typeAt(const std::vector<Token>& tokens, int x) {
+    for (const Token& token : tokens) {
+        if (token.position == x) {
+            return token.type;
+        }
+    }
+    assert(false);
+    return TokenType::PlainText;
+}
+
+static std::vector<Token> lex(const char* language, std::string_view line, LexerState& state) {
+    Lexer lexer(grammars.byName(language));
+    std::vector<Token> tokens;
+    lexer.tokenize(line, state, tokens);
+    return tokens;
+}
+
+static std::vector<Token> lex(const char* language, std::string_view line) {
+    LexerState state;
+    return lex(language, line, state);
+}
+
+int main() {
+    // Every built-in grammar compiles
+    for (std::string_view source : builtinGrammars()) {
+        Grammar grammar;
+        std::string error;
+        assert(grammar.compile(source, error));
+    }
+
+    // Picked by name, then extension, then #! line
+    const Grammar* cpp = grammars.byName("cpp");
+    const Grammar* python = grammars.byName("python");
+    const Grammar* shell = grammars.byName("shell");
+    assert(cpp && python && shell);
+    assert(grammars.forFile("src/Editor.cc", "") == cpp);
+    assert(grammars.forFile("include/Editor.hpp", "") == cpp);
+    assert(grammars.forFile("tool.py", "") == python);
+    assert(grammars.forFile("config.json", "")->name == "json");
+    assert(grammars.forFile(".github/ci.yml", "")->name == "yaml");
+    assert(grammars.forFile("build/Makefile", "")->name == "makefile");
+    assert(grammars.forFile("run", "#!/usr/bin/env python3") == python);
+    assert(grammars.forFile("run", "#!/usr/bin/env -S python3.12 -u") == python);
+    assert(grammars.forFile("run", "#!/bin/bash -e") == shell);
+    assert(grammars.forFile("notes.txt", "") == nullptr);
+    assert(grammars.forFile("run", "#!/usr/bin/perl") == nullptr);
+
+    // Python: strings in triple quotes run across lines
+    LexerState state;
+    std::vector<Token> tokens = lex("python", "def f(self): return \"\"\"doc", state);
+    assert(typeAt(tokens, 0) == TokenType::Keyword);
+    assert(typeAt(tokens, 6) == TokenType::Type);
+    assert(typeAt(tokens, 20) == TokenType::StringLiteral);
+    assert(state.region != 0);
+    tokens = lex("python", "more\"\"\" + len(x) # done", state);
+    assert(state.region == 0);
+    assert(tokens[0].type == TokenType::StringLiteral && tokens[0].length == 7);
+    assert(typeAt(tokens, 10) == TokenType::Function);
+    assert(typeAt(tokens, 17) == TokenType::Comment);
+
+    // JSON: a string before ':' is a key
+    tokens = lex("json", "{\"name\": \"vm\", \"n\": -1.5e3, \"ok\": true}");
+    assert(typeAt(tokens, 1) == TokenType::Key);
+    assert(typeAt(tokens, 9) == TokenType::StringLiteral);
+    assert(typeAt(tokens, 15) == TokenType::Key);
+    assert(typeAt(tokens, 20) == TokenType::NumericLiteral);
+    assert(typeAt(tokens, 34) == TokenType::Constant);
+
+    // YAML keys, values and comments
+    tokens = lex("yaml", "  build-type: release # why");
+    assert(typeAt(tokens, 2) == TokenType::Key);
+    assert(typeAt(tokens, 14) == TokenType::Identifier);
+    assert(typeAt(tokens, 22) == TokenType::Comment);
+
+    // Makefile variables and targets only at the start of a line
+    tokens = lex("makefile", "CXXFLAGS := -O3");
+    assert(typeAt(tokens, 0) == TokenType::Variable);
+    tokens = lex("makefile", "vm: $(OBJECTS)");
+    assert(typeAt(tokens, 0) == TokenType::Key);
+    assert(typeAt(tokens, 4) == TokenType::Variable);
+    tokens = lex("makefile", "\t$(CXX) -o vm: x");
+    assert(typeAt(tokens, 1) == TokenType::Variable);
+    assert(typeAt(tokens, 11) != TokenType::Key);
+
+    // Shell
+    tokens = lex("shell", "if [ -n \"$HOME\" ]; then echo $1; fi");
+    assert(typeAt(tokens, 0) == TokenType::Keyword);
+    assert(typeAt(tokens, 8) == TokenType::StringLiteral);
+    assert(typeAt(tokens, 19) == TokenType::Keyword);
+    assert(typeAt(tokens, 24) == TokenType::Function);
+    assert(typeAt(tokens, 29) == TokenType::Variable);
+
+    // Mistakes are reported with their line
+    Grammar grammar;
+    std::string error;
+    assert(!grammar.compile("language x\nshiny words a b\n", error));
+    assert(error.starts_with("line 2:"));
+    assert(!grammar.compile("language x\noperator symbols +-*\n", error));
+    assert(!grammar.compile("language x\nstring region \"\n", error));
+    assert(!grammar.compile("keyword words a\n", error));
+
+    // A grammar loaded later takes over an extension
+    GrammarRegistry custom;
+    assert(custom.load("language notes\nextensions txt py\n; a comment\ncomment line >\n", error));
+    assert(custom.forFile("a.txt", "")->name == "notes");
+    assert(custom.forFile("a.py", "")->name == "notes");
+    assert(custom.forFile("a.cc", "")->name == "cpp");
+    Lexer lexer(custom.byName("notes"));
+    state = LexerState();
+    lexer.tokenize("x > y", state, tokens);
+    assert(typeAt(tokens, 2) == TokenType::Comment);
+
+    // Words of one length that differ only in the middle get slots of their own
+    assert(grammar.compile("language gl\nkeyword words GL_COLOR_X_ATTACHMENT GL_COLOR_Y_ATTACHMENT\n"
+                           "type words GL_COLOR_Z_ATTACHMENT\n", error));
+    TokenType type;
+    assert(grammar.lookupWord("GL_COLOR_Y_ATTACHMENT", type) && type == TokenType::Keyword);
+    assert(grammar.lookupWord("GL_COLOR_Z_ATTACHMENT", type) && type == TokenType::Type);
+    assert(!grammar.lookupWord("GL_COLOR_W_ATTACHMENT", type));
+
+    std::cout << "GrammarTest passed.\n";
+    return 0;
+}
@@ -0,0 +1,161 @@
+#include "GrammarRegistry.h"
+#include "HighlightCache.h"
+#include "PieceTable.h"
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+static TokenType firstType(const HighlightCache& cache, int y) {
+    return cache.tokens(y).front().type;
+}
+
+// Brings lines first to last up to date, waiting for the worker
+static void settle(HighlightCache& cache, int first, int last) {
+    int from, to;
+    cache.update(first, last, from, to);
+    while (cache.busy()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        cache.update(first, last, from, to);
+    }
+}
+
+// Checks lines first to last against lexing the whole buffer from scratch
+static void checkFresh(const HighlightCache& cache, const TextBuffer& buffer, const Grammar* grammar,
+                       int first, int last) {
+    Lexer lexer(grammar);
+    LexerState state;
+    std::vector<Token> expected;
+    for (int y = 0; y <= last; y++) {
+        lexer.tokenize(buffer.line(y), state, expected);
+        if (y >= first) {
+            assert(cache.tokens(y).size() == expected.size());
+            for (size_t i = 0; i < expected.size(); i++) {
+                assert(cache.tokens(y)[i].type == expected[i].type);
+                assert(cache.tokens(y)[i].position == expected[i].position);
+                assert(cache.tokens(y)[i].length == expected[i].length);
+            }
+        }
+    }
+}
+
+int main() {
+    PieceTable buffer;
+    buffer.assign({"int a;", "/* start", "still comment", "end */ int b;", "int c;"});
+    GrammarRegistry grammars;
+    HighlightCache cache(buffer);
+    cache.setGrammar(grammars.byName("cpp"));
+    buffer.addListener(&cache);
+    int from, to;
+
+    // Comments spanning lines are known from the lines above
+    assert(cache.update(0, 4, from, to));
+    assert(from == 0 && to == 4);
+    assert(firstType(cache, 0) == TokenType::Keyword);
+    assert(firstType(cache, 2) == TokenType::Comment);
+    assert(firstType(cache, 3) == TokenType::Comment);
+    assert(cache.tokens(3).back().type == TokenType::Punctuation);
+    assert(firstType(cache, 4) == TokenType::Keyword);
+
+    // Lexing again gives the same answer instead of depending on history
+    assert(!cache.update(0, 4, from, to));
+    assert(firstType(cache, 2) == TokenType::Comment);
+
+    // An edit that keeps the line's end state re-lexes only that line
+    buffer.replaceLine(0, "long a;");
+    assert(cache.update(0, 4, from, to));
+    assert(from == 0 && to == 0);
+    assert(cache.tokens(0).front().length == 4);
+
+    // Opening a comment restyles the untouched lines below it
+    buffer.replaceLine(0, "/* int a;");
+    assert(cache.update(0, 4, from, to));
+    assert(from == 0 && to == 1);
+    assert(firstType(cache, 1) == TokenType::Comment);
+    assert(cache.tokens(1).size() == 1);
+
+    // Inserted and removed lines keep the cache in step with the buffer
+    buffer.replaceLine(0, "int a;");
+    buffer.insertLines(1, {"int x;", "int y;"});
+    cache.update(0, 6, from, to);
+    assert(firstType(cache, 1) == TokenType::Keyword);
+    assert(firstType(cache, 4) == TokenType::Comment);
+    buffer.eraseLines(1, 2);
+    cache.update(0, 4, from, to);
+    assert(buffer.lineCount() == 5);
+    assert(firstType(cache, 2) == TokenType::Comment);
+    assert(firstType(cache, 4) == TokenType::Keyword);
+
+    // Far from what has been lexed, lines are guessed until the worker
+    // has been through everything above them
+    std::vector<std::string> big(20000, "int x;");
+    big[0] = "/* never closed";
+    buffer.assign(big);
+    cache.clear();
+    cache.update(15000, 15009, from, to);
+    assert(firstType(cache, 15000) == TokenType::Keyword);
+    while (cache.busy()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        cache.update(15000, 15009, from, to);
+    }
+    assert(firstType(cache, 15000) == TokenType::Comment);
+    assert(firstType(cache, 15009) == TokenType::Comment);
+
+    // Past the lines lexed so far, guesses start from the last state known
+    cache.clear();
+    cache.update(0, 9, from, to);
+    while (cache.busy()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        cache.update(0, 9, from, to);
+    }
+    cache.update(19990, 19999, from, to);
+    assert(firstType(cache, 19990) == TokenType::Comment);
+
+    // Closing the comment is picked up by the same path
+    buffer.replaceLine(0, "/* closed */");
+    cache.update(15000, 15009, from, to);
+    while (cache.busy()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        cache.update(15000, 15009, from, to);
+    }
+    assert(firstType(cache, 15000) == TokenType::Keyword);
+
+    // Deleting scattered lines with everything cached, as :g/pat/d does,
+    // leaves the lines below lexed as from scratch
+    for (int y = 0; y < 20000; y += 7) {
+        big[y] = y % 2 ? "/* open" : "close */ int x;";
+    }
+    buffer.assign(big);
+    cache.clear();
+    settle(cache, 19990, 19999);
+    std::vector<int> doomed;
+    for (int y = 3; y < 20000; y += 10) {
+        doomed.push_back(y);
+    }
+    buffer.eraseLines(doomed);
+    settle(cache, 0, 49);
+    checkFresh(cache, buffer, grammars.byName("cpp"), 0, 49);
+    settle(cache, 17950, 17999);
+    checkFresh(cache, buffer, grammars.byName("cpp"), 17950, 17999);
+
+    // Edits landing while the worker runs end up lexed as from scratch
+    const char* pieces[] = {"/*", "*/", "{", "}", "int", " ", "\n", "x"};
+    unsigned seed = 1;
+    for (int round = 0; round < 300; round++) {
+        seed = seed * 1103515245 + 12345;
+        size_t offset = (seed >> 8) % (buffer.length() + 1);
+        if (seed % 3 == 0 && offset < buffer.length()) {
+            buffer.eraseAt(offset, 1 + (seed >> 4) % 8);
+        } else {
+            buffer.insertAt(offset, pieces[(seed >> 12) % 8]);
+        }
+        int top = (seed >> 16) % buffer.lineCount();
+        cache.update(top, top + 20, from, to);
+    }
+    int top = buffer.lineCount() - 10;
+    settle(cache, top, top + 9);
+    checkFresh(cache, buffer, grammars.byName("cpp"), top, top + 9);
+
+    std::cout << "HighlightCacheTest passed.\n";
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include "IncrementalSearch.h"
+#include "PieceTable.h"
+#include <cassert>
+#include <iostream>
+#include <random>
+#include <string>
+
+static Regex compile(const std::string& pattern) {
+    Regex regex;
+    std::string error;
+    assert(regex.compile(pattern, error));
+    return regex;
+}
+
+// Waits out the latest start and returns where it matched, or -1
+static long wait(IncrementalSearch& search) {
+    IncrementalSearch::Result result;
+    while (!search.poll(result)) {
+        std::this_thread::yield();
+    }
+    return result.found ? static_cast<long>(result.match.start) : -1;
+}
+
+// What / and ? find from origin, wrapping round, by plain string search
+static long expected(const std::string& text, const std::string& needle, size_t origin, bool backward) {
+    size_t at = backward ? (origin > 0 ? text.rfind(needle, origin - 1) : std::string::npos)
+                         : text.find(needle, origin + 1);
+    if (at == std::string::npos) {
+        at = backward ? text.rfind(needle) : text.find(needle);
+    }
+    return at == std::string::npos ? -1 : static_cast<long>(at);
+}
+
+int main() {
+    PieceTable buffer;
+    buffer.insertAt(0, "one two\nthree two\nfour");
+    auto snapshot = buffer.snapshot();
+    IncrementalSearch search;
+
+    search.start(compile("two"), snapshot, 0, false);
+    assert(wait(search) == 4);
+    search.start(compile("two"), snapshot, 4, false);
+    assert(wait(search) == 14);
+    search.start(compile("two"), snapshot, 14, false);
+    assert(wait(search) == 4);
+    search.start(compile("two"), snapshot, 14, true);
+    assert(wait(search) == 4);
+    search.start(compile("two"), snapshot, 4, true);
+    assert(wait(search) == 14);
+    search.start(compile("^f"), snapshot, 0, false);
+    assert(wait(search) == 18);
+    search.start(compile("five"), snapshot, 0, false);
+    assert(wait(search) == -1);
+
+    // Only the latest start reports back
+    search.start(compile("one"), snapshot, 0, false);
+    unsigned gen = search.start(compile("three"), snapshot, 0, false);
+    IncrementalSearch::Result result;
+    while (!search.poll(result)) {
+        std::this_thread::yield();
+    }
+    assert(result.generation == gen && result.match.start == 8);
+
+    // Typing a pattern a letter at a time, where each search narrows the
+    // last one's hits, finds what a fresh search over the text would
+    std::mt19937 rng(18);
+    for (int round = 0; round < 200; round++) {
+        std::string text(rng() % 400, 'a');
+        for (char& c : text) {
+            c = "aab\n"[rng() % 4];
+        }
+        PieceTable pieces;
+        for (size_t at = 0; at < text.size();) {
+            size_t n = 1 + rng() % 30;
+            pieces.insertAt(at, text.substr(at, n));
+            at += n;
+        }
+        auto shot = pieces.snapshot();
+        size_t origin = text.empty() ? 0 : rng() % text.size();
+        bool backward = rng() % 2;
+        std::string typed;
+        for (int i = 0; i < 6; i++) {
+            typed += "ab"[rng() % 2];
+            search.start(compile(typed), shot, origin, backward);
+            assert(wait(search) == expected(text, typed, origin, backward));
+        }
+    }
+
+    std::cout << "IncrementalSearchTest passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include "LexScanner.h"
+#include <cassert>
+#include <iostream>
+#include <random>
+#include <string>
+
+static bool identifierByte(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+int main() {
+    std::mt19937 rng(11);
+    ScanKernel best = bestScanKernel();
+    // Mostly bytes that keep a run going, so runs cross block boundaries
+    const std::string common = "aZ_9 \t*/\"'\\";
+    const std::string rare = "\x80\xff@[`{/*.-";
+
+    for (int round = 0; round < 2000; round++) {
+        std::string text(rng() % 120, ' ');
+        unsigned run = rng() % 4;
+        for (char& c : text) {
+            c = rng() % 16 == 0 ? rare[rng() % rare.size()] : common[(run + rng() % 3) % common.size()];
+        }
+        size_t from = text.empty() ? 0 : rng() % (text.size() + 1);
+
+        size_t stop = from;
+        while (stop < text.size() && text[stop] != '"' && text[stop] != '\\') {
+            stop++;
+        }
+        size_t identifier = from;
+        while (identifier < text.size() && identifierByte(text[identifier])) {
+            identifier++;
+        }
+        size_t blanks = from;
+        while (blanks < text.size() && (text[blanks] == ' ' || text[blanks] == '\t')) {
+            blanks++;
+        }
+
+        for (ScanKernel kernel : {ScanKernel::Scalar, ScanKernel::Sse2, ScanKernel::Avx2}) {
+            if (kernel > best) {
+                continue;
+            }
+            assert(findStringStop(kernel, text, from, '"') == stop);
+            assert(skipIdentifier(kernel, text, from) == identifier);
+            assert(skipBlanks(kernel, text, from) == blanks);
+        }
+    }
+
+    std::cout << "LexScannerTest passed.\n";
+    return 0;
+}
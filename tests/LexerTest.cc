@@ -0,0 +1,68 @@
+#include "GrammarRegistry.h"
+#include "Lexer.h"
+#include <cassert>
+#include <iostream>
+
+static GrammarRegistry grammars;
+static const Grammar& cpp = *grammars.byName("cpp");
+
+static std::vector<Token> lex(std::string_view line) {
+    Lexer lexer(&cpp);
+    LexerState state;
+    std::vector<Token> tokens;
+    lexer.tokenize(line, state, tokens);
+    return tokens;
+}
+
+int main() {
+    // Every keyword hashes to its own slot, and words close to one do not
+    TokenType type;
+    for (std::string_view word : {"do", "if", "or", "int", "char8_t", "char16_t", "char32_t",
+                                  "consteval", "constinit", "const_cast", "atomic_cancel",
+                                  "atomic_commit", "reinterpret_cast", "xor_eq", "co_await"}) {
+        assert(cpp.lookupWord(word, type) && type == TokenType::Keyword);
+    }
+    for (std::string_view word : {"", "d", "du", "iff", "char24_t", "constxnit", "Int", "reinterpret_casts",
+                                  "atomic_cancal", "co_awaiu"}) {
+        assert(!cpp.lookupWord(word, type));
+    }
+
+    std::vector<Token> tokens = lex("x->y += 0x10; a::b");
+    TokenType expected[] = {TokenType::Identifier, TokenType::Operator, TokenType::Identifier,
+                            TokenType::Operator, TokenType::NumericLiteral, TokenType::Punctuation,
+                            TokenType::Identifier, TokenType::Operator, TokenType::Identifier};
+    int lengths[] = {1, 2, 1, 2, 4, 1, 1, 2, 1};
+    // Blanks come out as plain text
+    std::vector<Token> words;
+    for (const Token& token : tokens) {
+        if (token.type != TokenType::PlainText) {
+            words.push_back(token);
+        }
+    }
+    assert(words.size() == std::size(expected));
+    for (size_t i = 0; i < words.size(); i++) {
+        assert(words[i].type == expected[i]);
+        assert(words[i].length == lengths[i]);
+    }
+
+    // A run of blanks is one token, however long
+    tokens = lex("a \t  b");
+    assert(tokens.size() == 3);
+    assert(tokens[1].type == TokenType::PlainText && tokens[1].length == 4);
+
+    // An escaped quote does not end a string, an escaped backslash does not
+    // escape the quote after it
+    tokens = lex("\"a\\\"b\" \"c\\\\\" d");
+    assert(tokens[0].type == TokenType::StringLiteral && tokens[0].length == 6);
+    assert(tokens[2].type == TokenType::StringLiteral && tokens[2].length == 5);
+    assert(tokens[4].type == TokenType::Identifier);
+
+    // Bytes outside ASCII are never part of an identifier
+    tokens = lex("caf\xc3\xa9");
+    assert(tokens.size() == 3);
+    assert(tokens[0].type == TokenType::Identifier && tokens[0].length == 3);
+    assert(tokens[1].type == TokenType::PlainText);
+
+    std::cout << "LexerTest passed.\n";
+    return 0;
+}
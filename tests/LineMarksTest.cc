@@ -0,0 +1,48 @@
+#include "LineMarks.h"
+#include "PieceTable.h"
+#include <cassert>
+#include <iostream>
+#include <string>
+
+// Visits the marks and runs edit on each, returning the text of every
+// line visited
+template <typename Edit>
+static std::string visit(PieceTable& buffer, std::vector<int> lines, Edit edit) {
+    LineMarks marks(buffer, std::move(lines));
+    buffer.addListener(&marks);
+    std::string seen;
+    for (int y; marks.next(y);) {
+        seen += buffer.line(y) + ";";
+        edit(y);
+    }
+    buffer.removeListener(&marks);
+    return seen;
+}
+
+int main() {
+    PieceTable buffer;
+    buffer.assign({"a0", "b1", "a2", "a3", "b4", "a5"});
+
+    // Deleting each marked line moves the rest up
+    assert(visit(buffer, {0, 2, 3, 5}, [&](int y) { buffer.eraseLines(y, 1); }) == "a0;a2;a3;a5;");
+    assert((buffer.lines() == std::vector<std::string>{"b1", "b4"}));
+
+    // Lines added above and below the mark
+    buffer.assign({"a0", "b1", "a2", "a3"});
+    assert(visit(buffer, {0, 2, 3}, [&](int y) { buffer.insertLines(y, {"x"}); }) == "a0;a2;a3;");
+    assert(visit(buffer, {1, 4}, [&](int y) { buffer.insertLines(y + 1, {"y", "z"}); }) == "a0;a2;");
+    assert((buffer.lines() == std::vector<std::string>{"x", "a0", "y", "z", "b1", "x", "a2", "y", "z", "x", "a3"}));
+
+    // A marked line deleted by the command on an earlier one is skipped,
+    // and joining lines drops the marks on the ones joined on
+    buffer.assign({"a0", "a1", "a2", "a3", "a4"});
+    assert(visit(buffer, {0, 1, 2, 3, 4}, [&](int y) { buffer.eraseLines(y + 1, 1); }) == "a0;a2;a4;");
+    buffer.assign({"a0", "a1", "a2", "a3"});
+    assert(visit(buffer, {0, 1, 2, 3}, [&](int y) {
+               buffer.eraseAt(buffer.lineStart(y) + buffer.lineLength(y), 1);
+           }) == "a0;a2;");
+    assert((buffer.lines() == std::vector<std::string>{"a0a1", "a2a3"}));
+
+    std::cout << "LineMarksTest passed." << std::endl;
+    return 0;
+}
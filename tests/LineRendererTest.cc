@@ -0,0 +1,39 @@
+#include "LineRenderer.h"
+#include <cassert>
+#include <iostream>
+
+int main() {
+    LineRenderer renderer;
+
+    // Neighbouring text with the same attributes shares one run
+    renderer.begin(12);
+    renderer.add("int", COLOR_PAIR(6));
+    renderer.add(" ", COLOR_PAIR(2));
+    renderer.add("x", COLOR_PAIR(2));
+    renderer.fill(COLOR_PAIR(5));
+    assert(renderer.text() == "int x       ");
+    assert(renderer.runs().size() == 3);
+    assert(renderer.runs()[0].attr == COLOR_PAIR(6) && renderer.runs()[0].length == 3);
+    assert(renderer.runs()[1].start == 3 && renderer.runs()[1].length == 2);
+    assert(renderer.runs()[2].start == 5 && renderer.runs()[2].length == 7);
+
+    // A selection in the middle of a run splits it in three
+    renderer.overlay(1, 2, A_REVERSE);
+    assert(renderer.runs().size() == 5);
+    assert(renderer.runs()[1].attr == A_REVERSE && renderer.runs()[1].start == 1);
+    assert(renderer.runs()[2].attr == COLOR_PAIR(6) && renderer.runs()[2].length == 1);
+
+    // Covering several runs merges them into one
+    renderer.overlay(0, 12, A_REVERSE);
+    assert(renderer.runs().size() == 1 && renderer.runs()[0].length == 12);
+
+    // Text is clipped at the edge and tabs take one cell
+    renderer.begin(4);
+    renderer.add("a\tbcdef", COLOR_PAIR(2));
+    renderer.fill(COLOR_PAIR(5));
+    assert(renderer.text() == "a bc");
+    assert(renderer.runs().size() == 1);
+
+    std::cout << "LineRendererTest passed.\n";
+    return 0;
+}
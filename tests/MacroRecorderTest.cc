@@ -0,0 +1,64 @@
+#include "MacroRecorder.h"
+#include <cassert>
+#include <iostream>
+#include <ncurses.h>
+
+// Records keys as Editor::readKey hands them over, with the mode each
+// was read in
+static void type(MacroRecorder& macros, const std::string& keys, bool inserting) {
+    for (char c : keys) {
+        macros.record(static_cast<unsigned char>(c), inserting);
+    }
+}
+
+int main() {
+    MacroRecorder macros;
+    assert(!macros.recording());
+    assert(!macros.start('%'));
+    assert(macros.ops('%') == nullptr);
+    assert(macros.ops('q')->empty());
+
+    // qqA!<Enter>x<Esc>jq: the typed text is one op, the q that ended it dropped
+    assert(macros.start('q'));
+    assert(macros.recordingRegister() == 'q');
+    type(macros, "A", false);
+    type(macros, "!", true);
+    macros.record(KEY_ENTER, true);
+    type(macros, "x", true);
+    type(macros, "\x1b", true);
+    type(macros, "jq", false);
+    macros.stop();
+    assert(!macros.recording());
+    const std::vector<MacroOp>& ops = *macros.ops('q');
+    assert(ops.size() == 3);
+    assert(ops[0].kind == MacroOp::Keys && ops[0].keys == std::vector<int>{'A'});
+    assert(ops[1].kind == MacroOp::Text && ops[1].text == "!\nx");
+    assert(ops[2].kind == MacroOp::Keys && (ops[2].keys == std::vector<int>{27, 'j'}));
+
+    // Backspace in Insert mode is a key, not text
+    assert(macros.start('a'));
+    type(macros, "i", false);
+    type(macros, "ab", true);
+    macros.record(KEY_BACKSPACE, true);
+    type(macros, "\x1bq", false);
+    macros.stop();
+    assert(macros.ops('a')->size() == 3);
+    assert(((*macros.ops('a'))[2].keys == std::vector<int>{KEY_BACKSPACE, 27}));
+
+    // qA appends, carrying on the keys register a ended with
+    assert(macros.start('A'));
+    assert(macros.recordingRegister() == 'a');
+    type(macros, "ddq", false);
+    macros.stop();
+    assert(macros.ops('a')->size() == 3);
+    assert(((*macros.ops('a'))[2].keys == std::vector<int>{KEY_BACKSPACE, 27, 'd', 'd'}));
+
+    // Recording again replaces it, and q straight away leaves it empty
+    assert(macros.start('a'));
+    type(macros, "q", false);
+    macros.stop();
+    assert(macros.ops('a')->empty());
+
+    std::cout << "MacroRecorderTest passed." << std::endl;
+    return 0;
+}
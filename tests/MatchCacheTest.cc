@@ -0,0 +1,108 @@
+#include "MatchCache.h"
+#include "MatchCounter.h"
+#include "PieceTable.h"
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <thread>
+
+static Regex compile(const std::string& pattern) {
+    Regex regex;
+    std::string error;
+    assert(regex.compile(pattern, error));
+    return regex;
+}
+
+// Line y's spans as "start-end start-end"
+static std::string spans(const MatchCache& cache, int y) {
+    std::string out;
+    for (const MatchSpan& span : cache.spans(y)) {
+        if (!out.empty()) {
+            out += ' ';
+        }
+        out += std::to_string(span.start) + "-" + std::to_string(span.end);
+    }
+    return out;
+}
+
+int main() {
+    PieceTable buffer;
+    std::string text;
+    for (int i = 0; i < 100; i++) {
+        text += i % 2 ? "foo bar foo\n" : "bar\n";
+    }
+    buffer.insertAt(0, text);
+    MatchCache cache(buffer);
+    buffer.addListener(&cache);
+    int from, to;
+
+    // Nothing to highlight without a pattern
+    assert(!cache.update(0, 9, from, to));
+    assert(spans(cache, 1).empty());
+
+    cache.setPattern(compile("foo"));
+    assert(cache.update(0, 9, from, to) && from == 1 && to == 9);
+    assert(spans(cache, 1) == "0-3 8-11");
+    assert(spans(cache, 2).empty());
+    assert(cache.linesSearched() == 10);
+    // Unchanged lines are not reported again
+    assert(!cache.update(0, 9, from, to));
+
+    // Scrolling searches only the lines that come into view, and back
+    // up over cached ones nothing at all
+    cache.update(5, 14, from, to);
+    assert(cache.linesSearched() == 15);
+    cache.update(0, 9, from, to);
+    assert(cache.linesSearched() == 15);
+
+    // An edit searches its own line again, and lines below it keep
+    // theirs under their new numbers
+    buffer.insert(2, 0, "foo");
+    assert(cache.update(0, 9, from, to) && from == 2 && to == 2);
+    assert(spans(cache, 2) == "0-3");
+    assert(cache.linesSearched() == 16);
+    buffer.insert(0, 0, "x\n");
+    assert(cache.update(0, 9, from, to));
+    assert(cache.linesSearched() == 18);
+    assert(spans(cache, 2) == "0-3 8-11");
+    buffer.eraseLines(0, 1);
+    cache.update(0, 9, from, to);
+    assert(cache.linesSearched() == 19);
+    assert(spans(cache, 1) == "0-3 8-11");
+
+    // A match over a line break goes on at the start of the next line,
+    // and an edit below it searches the lines above again
+    cache.setPattern(compile("foo\\nbar"));
+    cache.update(0, 4, from, to);
+    assert(spans(cache, 3) == "8-12");
+    assert(spans(cache, 4) == "0-3");
+    unsigned long searched = cache.linesSearched();
+    buffer.replaceLine(4, "baz");
+    cache.update(0, 4, from, to);
+    assert(cache.linesSearched() == searched + 5);
+    assert(spans(cache, 3).empty() && spans(cache, 4).empty());
+
+    // Turning highlighting off repaints the lines that had matches
+    cache.setPattern(compile("foo"));
+    cache.update(0, 4, from, to);
+    cache.setPattern(Regex());
+    assert(cache.update(0, 4, from, to) && from == 1 && to == 3);
+    assert(spans(cache, 1).empty());
+
+    // The count of every match, and which one starts where
+    MatchCounter counter;
+    counter.count(compile("foo"), buffer.snapshot(), buffer.version());
+    size_t index, total;
+    bool capped;
+    while (!counter.result(0, index, total, capped)) {
+        std::this_thread::yield();
+    }
+    assert(!counter.busy());
+    size_t second = buffer.offsetOf(1, 8);
+    assert(counter.result(second, index, total, capped));
+    assert(index == 2 && total == 101 && !capped);
+    assert(counter.result(1, index, total, capped) && index == 0);
+
+    std::cout << "MatchCacheTest passed." << std::endl;
+    return 0;
+}
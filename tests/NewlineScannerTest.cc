@@ -0,0 +1,57 @@
+#include "LineIndex.h"
+#include "NewlineScanner.h"
+#include <cassert>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+static std::vector<size_t> naive(const std::string& text, size_t base) {
+    std::vector<size_t> offsets;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '\n') {
+            offsets.push_back(base + i);
+        }
+    }
+    return offsets;
+}
+
+int main() {
+    std::mt19937 rng(5);
+    NewlineKernel best = bestNewlineKernel();
+
+    // Every kernel agrees with a plain loop, including ragged tails
+    for (int round = 0; round < 200; round++) {
+        std::string text(rng() % 300, 'x');
+        for (char& c : text) {
+            if (rng() % 7 == 0) {
+                c = '\n';
+            }
+        }
+        for (NewlineKernel kernel : {NewlineKernel::Scalar, NewlineKernel::Sse2, NewlineKernel::Avx2}) {
+            if (kernel > best) {
+                continue;
+            }
+            std::vector<size_t> offsets;
+            scanNewlinesWith(kernel, text.data(), text.size(), 100, offsets);
+            assert(offsets == naive(text, 100));
+        }
+    }
+
+    // Chunked, multi-threaded indexing gives the same offsets in order
+    std::string big;
+    while (big.size() < 20 * 1024 * 1024) {
+        big.append(1 + rng() % 200, 'y');
+        big += '\n';
+    }
+    std::vector<size_t> expected = naive(big, 0);
+    LineIndex index;
+    index.build(big.data(), big.size(), 3);
+    index.waitFor(10);
+    assert(index.ready() >= 10);
+    assert(index.at(9) == expected[9]);
+    assert(index.take() == expected);
+
+    std::cout << "NewlineScannerTest passed.\n";
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include "ParallelSearch.h"
+#include "PieceTable.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+
+static Regex compile(const std::string& pattern) {
+    Regex regex;
+    std::string error;
+    assert(regex.compile(pattern, error));
+    return regex;
+}
+
+// :s//n the slow way, a line at a time
+static MatchTally countLines(const Regex& pattern, const std::string& text, bool everyMatch) {
+    MatchTally tally;
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t end = std::min(text.find('\n', start), text.size());
+        std::string_view line(text.data() + start, end - start);
+        RegexMatch match;
+        size_t before = tally.matches;
+        for (size_t at = 0; at <= line.size() && pattern.search(line, at, line.size(), false, match);) {
+            tally.matches++;
+            at = everyMatch ? std::max(match.end, match.start + 1) : line.size() + 1;
+        }
+        tally.lines += tally.matches > before;
+        start = end + 1;
+    }
+    return tally;
+}
+
+int main() {
+    // Every task runs once, however uneven, and each worker index is in range
+    ThreadPool pool(4);
+    assert(pool.size() == 4);
+    for (size_t count : {0, 1, 3, 1000}) {
+        std::vector<std::atomic<int>> runs(count);
+        pool.run(count, [&](size_t i, unsigned worker) {
+            assert(worker < pool.size());
+            // The first tasks are far slower, so the rest get stolen
+            volatile size_t spin = i < 4 ? 200000 : 0;
+            while (spin > 0) {
+                spin = spin - 1;
+            }
+            runs[i]++;
+        });
+        for (auto& run : runs) {
+            assert(run == 1);
+        }
+    }
+
+    // Counting in megabyte pieces gives what counting line by line does
+    std::mt19937 rng(20);
+    std::string text;
+    for (int i = 0; i < 3000000; i++) {
+        text += "ab \n"[rng() % 4];
+    }
+    PieceTable buffer;
+    for (size_t at = 0; at < text.size(); at += 1000000) {
+        buffer.insertAt(at, text.substr(at, 1000000));
+    }
+    auto snapshot = buffer.snapshot();
+    ThreadPool single(1);
+    for (const char* source : {"ab", "a\\+b\\=", "^b", "a$", "b\\na"}) {
+        Regex pattern = compile(source);
+        for (bool everyMatch : {false, true}) {
+            MatchTally tally = countMatches(pattern, *snapshot, 0, text.size(), everyMatch, pool);
+            MatchTally alone = countMatches(pattern, *snapshot, 0, text.size(), everyMatch, single);
+            assert(tally.matches == alone.matches && tally.lines == alone.lines);
+            if (!pattern.spansLines()) {
+                MatchTally expected = countLines(pattern, text, everyMatch);
+                assert(tally.matches == expected.matches && tally.lines == expected.lines);
+            }
+        }
+        // :g and :v marks, numbered across the pieces, between them all lines
+        std::vector<int> marked = markLines(pattern, *snapshot, 0, text.size(), 0, false, pool);
+        std::vector<int> unmarked = markLines(pattern, *snapshot, 0, text.size(), 0, true, pool);
+        assert(marked == markLines(pattern, *snapshot, 0, text.size(), 0, false, single));
+        assert(marked.size() == countMatches(pattern, *snapshot, 0, text.size(), false, pool).lines);
+        assert(marked.size() + unmarked.size() == static_cast<size_t>(buffer.lineCount()));
+        std::vector<int> all(marked);
+        all.insert(all.end(), unmarked.begin(), unmarked.end());
+        std::sort(all.begin(), all.end());
+        for (size_t i = 0; i < all.size(); i++) {
+            assert(all[i] == static_cast<int>(i));
+        }
+        if (!marked.empty() && !pattern.spansLines()) {
+            RegexMatch match;
+            int y = marked[marked.size() / 2];
+            assert(pattern.search(*snapshot, buffer.lineStart(y), buffer.lineStart(y) + buffer.lineLength(y),
+                                  false, match));
+        }
+    }
+
+    // Globs and the hits of each file, in order
+    namespace fs = std::filesystem;
+    fs::path root = fs::temp_directory_path() / "parallel_search_test";
+    fs::remove_all(root);
+    fs::create_directories(root / "a" / "b");
+    fs::create_directories(root / ".git");
+    std::ofstream(root / "top.cc") << "int x;\n";
+    std::ofstream(root / "a" / "one.cc") << "x\nfoo foo\n";
+    std::ofstream(root / "a" / "b" / "two.cc") << "foo\n";
+    std::ofstream(root / "a" / "b" / "two.h") << "foo\n";
+    std::ofstream(root / ".git" / "hidden.cc") << "foo\n";
+    std::string base = root.string() + "/";
+
+    std::vector<std::string> files;
+    std::string error;
+    assert(expandGlobs({base + "**/*.cc"}, files, error));
+    assert((files == std::vector<std::string>{base + "a/b/two.cc", base + "a/one.cc", base + "top.cc"}));
+    files.clear();
+    assert(expandGlobs({base + "*/*.cc", base + "a/one.cc"}, files, error));
+    assert((files == std::vector<std::string>{base + "a/one.cc"}));
+    files.clear();
+    assert(!expandGlobs({base + "*.txt"}, files, error) && error == "E480: No match: " + base + "*.txt");
+
+    files = {base + "a/one.cc", base + "a/b/two.cc", base + "top.cc"};
+    std::vector<GrepHit> hits;
+    grepFiles(compile("foo"), files, true, pool, hits);
+    assert(hits.size() == 3);
+    assert(hits[0].file == base + "a/one.cc" && hits[0].line == 1 && hits[0].column == 0);
+    assert(hits[1].line == 1 && hits[1].column == 4 && hits[1].text == "foo foo");
+    assert(hits[2].file == base + "a/b/two.cc" && hits[2].line == 0);
+    hits.clear();
+    grepFiles(compile("foo"), files, false, pool, hits);
+    assert(hits.size() == 2);
+    fs::remove_all(root);
+
+    std::cout << "ParallelSearchTest passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include "MappedFile.h"
+#include "PieceTable.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Reference model: the same document held as one flat string
+static std::vector<std::string> splitLines(const std::string& text) {
+    std::vector<std::string> lines(1);
+    for (char c : text) {
+        if (c == '\n') {
+            lines.emplace_back();
+        } else {
+            lines.back() += c;
+        }
+    }
+    return lines;
+}
+
+static void checkMatches(const PieceTable& buffer, const std::string& text) {
+    assert(buffer.length() == text.size());
+    std::vector<std::string> expected = splitLines(text);
+    assert(buffer.lineCount() == (int)expected.size());
+    for (int y = 0; y < buffer.lineCount(); y++) {
+        assert(buffer.line(y) == expected[y]);
+        assert(buffer.lineLength(y) == (int)expected[y].size());
+    }
+    assert(buffer.lines() == expected);
+}
+
+int main() {
+    PieceTable buffer;
+    assert(buffer.lineCount() == 1);
+    assert(buffer.line(0).empty());
+
+    // Line helpers
+    buffer.assign({"first", "second", "third"});
+    buffer.insert(1, 3, "\n");
+    checkMatches(buffer, "first\nsec\nond\nthird");
+    buffer.eraseLines(1, 2);
+    checkMatches(buffer, "first\nthird");
+    buffer.insertLines(2, {"fourth"});
+    checkMatches(buffer, "first\nthird\nfourth");
+    buffer.eraseLines(1, 5);
+    checkMatches(buffer, "first");
+    buffer.replaceLine(0, "only");
+    checkMatches(buffer, "only");
+    buffer.eraseLines(0, 1);
+    checkMatches(buffer, "");
+    buffer.assign({"0", "1", "2", "3", "4", "5"});
+    buffer.eraseLines(std::vector<int>{0, 2, 3, 5});
+    checkMatches(buffer, "1\n4");
+
+    // Random edits against the flat string model
+    std::mt19937 rng(246);
+    std::string model;
+    buffer.reset(nullptr);
+    const std::string alphabet = "abc \n";
+    for (int step = 0; step < 20000; step++) {
+        if (model.empty() || rng() % 3 != 0) {
+            size_t offset = rng() % (model.size() + 1);
+            std::string text;
+            int count = 1 + rng() % 8;
+            for (int i = 0; i < count; i++) {
+                text += alphabet[rng() % alphabet.size()];
+            }
+            buffer.insertAt(offset, text);
+            model.insert(offset, text);
+        } else {
+            size_t offset = rng() % model.size();
+            size_t count = 1 + rng() % 12;
+            buffer.eraseAt(offset, count);
+            model.erase(offset, count);
+        }
+        if (step % 1000 == 0) {
+            checkMatches(buffer, model);
+        }
+    }
+    checkMatches(buffer, model);
+
+    for (size_t offset = 0; offset < model.size(); offset += 37) {
+        assert(buffer.byteAt(offset) == model[offset]);
+        assert(buffer.lineAt(offset) == std::count(model.begin(), model.begin() + offset, '\n'));
+        assert(buffer.substr(offset, 50) == model.substr(offset, 50));
+    }
+    assert(buffer.lineAt(model.size()) == buffer.lineCount() - 1);
+
+    // A file past the threshold is indexed in the background
+    std::string big;
+    for (int i = 0; big.size() <= PieceTable::BackgroundIndexThreshold; i++) {
+        big += "line " + std::to_string(i) + "\n";
+    }
+    std::ofstream("big_test.txt", std::ios::binary) << big;
+    auto mapped = std::make_shared<MappedFile>();
+    assert(mapped->open("big_test.txt"));
+    std::remove("big_test.txt");
+    buffer.reset(mapped);
+    buffer.waitForLines(10);
+    assert(buffer.lineCount() >= 10);
+    assert(buffer.line(3) == "line 3");
+    // The last line found so far ends at its own '\n', not at the end of the file
+    assert(buffer.lineLength(buffer.lineCount() - 1) < 16);
+    buffer.waitForLines(std::numeric_limits<int>::max());
+    assert(!buffer.isIndexing());
+    big.pop_back();
+    checkMatches(buffer, big);
+    buffer.insertAt(0, "x");
+    assert(buffer.line(0) == "xline 0");
+
+    // Editing before the scan is done waits for it
+    buffer.reset(mapped);
+    buffer.insertAt(buffer.length(), "\nend");
+    checkMatches(buffer, big + "\nend");
+
+    std::cout << "PieceTableTest passed.\n";
+    return 0;
+}
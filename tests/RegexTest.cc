@@ -0,0 +1,179 @@
+#include "PieceTable.h"
+#include "Regex.h"
+#include <cassert>
+#include <iostream>
+#include <random>
+#include <string>
+
+// Where pattern first matches in text, as "start-end", or "none"
+static std::string find(const std::string& pattern, std::string_view text, size_t from = 0) {
+    Regex regex;
+    std::string error;
+    assert(regex.compile(pattern, error));
+    RegexMatch match;
+    if (!regex.search(text, from, text.size(), false, match)) {
+        return "none";
+    }
+    return std::to_string(match.start) + "-" + std::to_string(match.end);
+}
+
+static std::string compileError(const std::string& pattern) {
+    Regex regex;
+    std::string error;
+    assert(!regex.compile(pattern, error));
+    return error;
+}
+
+static std::string randomPattern(std::mt19937& rng, int depth) {
+    static const char* atoms[] = {"a", "b", ".", "[ab]", "[^a]", "\\n", "\\_.", "^", "$", "\\<", "\\>", "\\w"};
+    std::string out;
+    int pieces = 1 + rng() % 4;
+    for (int i = 0; i < pieces; i++) {
+        if (depth < 2 && rng() % 5 == 0) {
+            out += "\\(" + randomPattern(rng, depth + 1) + "\\)";
+        } else {
+            out += atoms[rng() % (sizeof(atoms) / sizeof(atoms[0]))];
+        }
+        static const char* multis[] = {"", "", "", "*", "\\+", "\\=", "\\{1,2}", "\\{-}", "\\{2}"};
+        if (out.back() != '^' && out.back() != '$') {
+            out += multis[rng() % (sizeof(multis) / sizeof(multis[0]))];
+        }
+    }
+    if (depth < 2 && rng() % 4 == 0) {
+        out += "\\|" + randomPattern(rng, depth + 1);
+    }
+    return out;
+}
+
+int main() {
+    // Vim's syntax and leftmost-first preferences
+    assert(find("b", "aab") == "2-3");
+    assert(find("a*", "aab") == "0-2");
+    assert(find("a\\{-}b", "aab") == "0-3");
+    assert(find("a\\{-1,}", "aaa") == "0-1");
+    assert(find("x*", "aab") == "0-0");
+    assert(find("ab\\|a", "ab") == "0-2");
+    assert(find("a\\|ab", "ab") == "0-1");
+    assert(find("\\(ab\\)\\+c", "xababc") == "1-6");
+    assert(find("\\%(a\\|b\\)\\{3}", "xaabx") == "1-4");
+    assert(find("a\\{2,}", "a aaaa") == "2-6");
+    assert(find("a\\{,2}b", "aaab") == "1-4");
+    assert(find("[0-9]\\+", "abc 1234 x") == "4-8");
+    assert(find("[^a-c]", "abcd") == "3-4");
+    assert(find("[]x]", "a]") == "1-2");
+    assert(find("[a-]", "x-") == "1-2");
+    assert(find("[[:upper:]][[:digit:]]", "aB3") == "1-3");
+    assert(find("[", "a[") == "1-2");
+    assert(find("\\d\\s\\w", "x1 y") == "1-4");
+    assert(find("\\S\\+", "  word ") == "2-6");
+    assert(find("\\<is\\>", "this is") == "5-7");
+    assert(find("\\<th", "other this") == "6-8");
+    assert(find("s\\>", "sis as") == "2-3");
+    assert(find("^b", "ab\nb") == "3-4");
+    assert(find("a$", "ab\nba") == "4-5");
+    assert(find("a$b", "a$b") == "0-3");
+    assert(find("b^", "b^") == "0-2");
+    assert(find("^*", "a*\n*") == "3-4");
+    assert(find("o\\nt", "foo\ntwo") == "2-5");
+    assert(find("[^x]\\+", "ab\ncd") == "0-2");
+    assert(find("\\_s\\+", "a \n b") == "1-4");
+    assert(find("\\cHELLO", "say hello") == "4-9");
+    assert(find("HELLO", "say hello") == "none");
+    assert(find("with space", "a with space") == "2-12");
+    assert(find("a.c", "a\nc abc") == "4-7");
+    assert(find("b", "abab", 2) == "3-4");
+    assert(find("^b", "ab", 1) == "none");
+    assert(find("\\<b", "ab", 1) == "none");
+
+    assert(compileError("\\(a") == "E54: Unmatched \\(");
+    assert(compileError("a\\)") == "E55: Unmatched \\)");
+    assert(compileError("\\+a") == "E64: \\+ follows nothing");
+    assert(compileError("a**") == "E61: Nested multi");
+    assert(compileError("a\\{1") == "E554: Syntax error in \\{...}");
+    assert(compileError("[z-a]") == "E944: Reverse range in character class");
+    assert(compileError("") == "E35: No previous regular expression");
+
+    // Only patterns with a line break in them may match over one
+    for (const char* pattern : {"o\\nt", "\\_s", "a\\|\\_[x]"}) {
+        Regex regex;
+        std::string error;
+        assert(regex.compile(pattern, error) && regex.spansLines());
+    }
+    for (const char* pattern : {"[^x]", ".", "\\s$", "^a"}) {
+        Regex regex;
+        std::string error;
+        assert(regex.compile(pattern, error) && !regex.spansLines());
+    }
+
+    // Patterns that backtracking engines take exponential time over are
+    // linear here: a megabyte of a's with no b at the end
+    std::string as(1 << 20, 'a');
+    assert(find("\\(a*\\)*b", as) == "none");
+    assert(find("\\(a\\|aa\\)*b", as) == "none");
+    assert(find("\\(a\\|a\\)\\{1,200}c", as) == "none");
+
+    // The lazy DFA agrees with the NFA on random patterns, forward and
+    // backward, over text in one string and spread over pieces
+    std::mt19937 rng(17);
+    for (int round = 0; round < 3000; round++) {
+        std::string pattern = randomPattern(rng, 0);
+        Regex regex;
+        std::string error;
+        if (!regex.compile(pattern, error)) {
+            continue;
+        }
+        std::string text(rng() % 40, 'a');
+        for (char& c : text) {
+            c = "ab \n"[rng() % 4];
+        }
+        PieceTable buffer;
+        for (size_t at = 0; at < text.size();) {
+            size_t n = 1 + rng() % 5;
+            buffer.insertAt(at, text.substr(at, n));
+            at += n;
+        }
+        size_t first = rng() % (text.size() + 1);
+        size_t last = first + rng() % (text.size() + 1 - first);
+
+        RegexMatch expected, actual;
+        bool found = regex.searchNfa(text, first, last, expected);
+        assert(regex.search(text, first, last, false, actual) == found);
+        assert(!found || (actual.start == expected.start && actual.end == expected.end));
+        assert(regex.search(buffer, first, last, false, actual) == found);
+        assert(!found || (actual.start == expected.start && actual.end == expected.end));
+
+        // The last match in range is the last one a forward search finds
+        bool foundLast = false;
+        for (size_t from = first; from <= last && regex.searchNfa(text, from, last, actual);) {
+            expected = actual;
+            foundLast = true;
+            from = actual.start + 1;
+        }
+        assert(regex.search(text, first, last, true, actual) == foundLast);
+        assert(!foundLast || (actual.start == expected.start && actual.end == expected.end));
+        assert(regex.search(buffer, first, last, true, actual) == foundLast);
+        assert(!foundLast || (actual.start == expected.start && actual.end == expected.end));
+    }
+
+    // A pattern with more DFA states than the cache holds still finds
+    // its match, finishing on the NFA
+    std::string text;
+    for (int i = 0; i < 200000; i++) {
+        text += "ab"[rng() % 2];
+    }
+    text += "a" + std::string(20, 'b');
+    Regex big;
+    std::string error;
+    assert(big.compile("a[ab]\\{20}$", error));
+    RegexMatch match, nfa;
+    assert(big.search(text, 0, text.size(), false, match));
+    assert(big.searchNfa(text, 0, text.size(), nfa));
+    assert(match.start == nfa.start && match.end == nfa.end && match.end == text.size());
+
+    // Copies search with their own cache
+    Regex copy = big;
+    assert(copy.search(text, 0, text.size(), false, match) && match.start == nfa.start);
+
+    std::cout << "RegexTest passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include "Substitute.h"
+#include "PieceTable.h"
+#include "UndoJournal.h"
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <random>
+#include <string>
+
+static Regex compile(const std::string& pattern) {
+    Regex regex;
+    std::string error;
+    assert(regex.compile(pattern, error));
+    return regex;
+}
+
+static Replacement parse(const std::string& text, const std::string& previous = "") {
+    Replacement replacement;
+    std::string error;
+    assert(replacement.parse(text, previous, error));
+    return replacement;
+}
+
+// The buffer after :first,last s/pattern/replacement/[g]
+static std::string run(const std::string& text, const std::string& pattern, const std::string& replacement,
+                       int first, int last, bool everyMatch, size_t* substitutions = nullptr) {
+    PieceTable buffer;
+    buffer.insertAt(0, text);
+    SubstituteResult result = substituteLines(buffer, compile(pattern), parse(replacement), first, last,
+                                              everyMatch);
+    if (substitutions) {
+        *substitutions = result.substitutions;
+    }
+    return buffer.substr(0, buffer.length());
+}
+
+// :%s the slow way, a line at a time with std::string
+static std::string replaceLines(const std::string& text, const std::string& needle, const std::string& with,
+                                bool everyMatch) {
+    std::string out;
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t end = std::min(text.find('\n', start), text.size());
+        std::string line = text.substr(start, end - start);
+        for (size_t at = line.find(needle); at != std::string::npos;
+             at = everyMatch ? line.find(needle, at + with.size()) : std::string::npos) {
+            line.replace(at, needle.size(), with);
+        }
+        out += line;
+        if (end < text.size()) {
+            out += '\n';
+        }
+        start = end + 1;
+    }
+    return out;
+}
+
+int main() {
+    // The first match on each line, or every one with g
+    assert(run("a a\nb\na", "a", "x", 0, 2, false) == "x a\nb\nx");
+    assert(run("a a\nb\na", "a", "x", 0, 2, true) == "x x\nb\nx");
+    assert(run("a a\na\na", "a", "x", 1, 1, true) == "a a\nx\na");
+
+    // & and \0 are the match, \r splits the line, ~ is the last replacement
+    assert(run("foo bar", "o\\+", "<&>", 0, 0, false) == "f<oo> bar");
+    assert(run("foo bar", "bar", "\\0\\&\\0", 0, 0, false) == "foo bar&bar");
+    assert(run("a,b,c", ",", "\\r", 0, 0, true) == "a\nb\nc");
+    assert(parse("[~]", "x&").source() == "[x&]");
+    std::string error;
+    Replacement backReference;
+    assert(!backReference.parse("\\1", "", error) && error == "E65: Illegal back reference");
+
+    // Empty matches keep the text they sit in front of
+    assert(run("abc", "x*", "-", 0, 0, true) == "-a-b-c-");
+    assert(run("ab\ncd", "$", ";", 0, 1, false) == "ab;\ncd;");
+    assert(run("ab\ncd", "^", "# ", 0, 1, false) == "# ab\n# cd");
+
+    // Matches over a line break join lines, and are found in the old text
+    size_t substitutions = 0;
+    assert(run("a\nb\na\nb", "a\\nb", "ab", 0, 3, false, &substitutions) == "ab\nab");
+    assert(substitutions == 2);
+
+    // Against std::string on random text
+    std::mt19937 rng(21);
+    std::string text;
+    for (int i = 0; i < 20000; i++) {
+        text += "ab \n"[rng() % 4];
+    }
+    size_t secondEnd = text.find('\n', text.find('\n') + 1);
+    int lastLine = std::count(text.begin(), text.end(), '\n');
+    for (bool everyMatch : {false, true}) {
+        // Only the lines in range change
+        assert(run(text, "ab", "xyz", 0, 1, everyMatch) ==
+               replaceLines(text.substr(0, secondEnd), "ab", "xyz", everyMatch) + text.substr(secondEnd));
+        assert(run(text, "ab", "b", 0, lastLine, everyMatch) == replaceLines(text, "ab", "b", everyMatch));
+    }
+
+    // All the edits undo as one step
+    PieceTable buffer;
+    buffer.insertAt(0, text);
+    UndoJournal journal;
+    buffer.addListener(&journal);
+    journal.beginStep(0, 0);
+    SubstituteResult result = substituteLines(buffer, compile("a"), parse("AA"), 0, lastLine, true);
+    journal.commit(0, 0);
+    assert(result.lastLine == std::count(text.begin(), text.begin() + text.rfind('a'), '\n'));
+    int y = 0;
+    int x = 0;
+    assert(journal.undo(buffer, y, x));
+    assert(buffer.substr(0, buffer.length()) == text);
+
+    std::cout << "SubstituteTest passed." << std::endl;
+    return 0;
+}
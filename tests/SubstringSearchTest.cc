@@ -0,0 +1,82 @@
+#include "PieceTable.h"
+#include "SubstringSearch.h"
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <random>
+#include <string>
+
+int main() {
+    std::mt19937 rng(16);
+    ScanKernel best = bestScanKernel();
+
+    // Every kernel agrees with std::string_view on few-letter text, where
+    // partial matches are everywhere, for needles on both sides of
+    // MaxFilterLength
+    for (int round = 0; round < 3000; round++) {
+        std::string text(rng() % 300, 'a');
+        for (char& c : text) {
+            c = "aab\n"[rng() % 4];
+        }
+        size_t m = 1 + rng() % (SubstringSearch::MaxFilterLength + 8);
+        std::string needle(m, 'a');
+        if (!text.empty() && rng() % 2) {
+            // Often a piece of the text, so there is something to find
+            size_t at = rng() % text.size();
+            needle = text.substr(at, m);
+        } else {
+            for (char& c : needle) {
+                c = "aab\n"[rng() % 4];
+            }
+        }
+        std::string_view view = text;
+        size_t from = rng() % (text.size() + 2);
+        for (ScanKernel kernel : {ScanKernel::Scalar, ScanKernel::Sse2, ScanKernel::Avx2}) {
+            if (kernel > best) {
+                continue;
+            }
+            SubstringSearch search(needle, kernel);
+            assert(search.find(view, from) == view.find(needle, from));
+            assert(search.rfind(view, from) == view.rfind(needle, from));
+            assert(search.rfind(view) == view.rfind(needle));
+        }
+    }
+
+    // Buffer searches see through piece boundaries, in both directions
+    PieceTable buffer;
+    std::string model;
+    for (int i = 0; i < 400; i++) {
+        std::string text(1 + rng() % 6, 'x');
+        for (char& c : text) {
+            c = "xyz\n"[rng() % 4];
+        }
+        size_t at = rng() % (model.size() + 1);
+        buffer.insertAt(at, text);
+        model.insert(at, text);
+    }
+    std::string_view view = model;
+    for (int round = 0; round < 3000; round++) {
+        std::string needle = model.substr(rng() % model.size(), 1 + rng() % 9);
+        SubstringSearch search(needle);
+        size_t first = rng() % model.size();
+        size_t last = first + rng() % (model.size() - first);
+
+        size_t expected = view.find(needle, first);
+        expected = expected != std::string::npos && expected <= last ? expected : std::string::npos;
+        assert(search.find(buffer, first, last, false) == expected);
+
+        expected = view.rfind(needle, last);
+        expected = expected != std::string::npos && expected >= first ? expected : std::string::npos;
+        assert(search.find(buffer, first, last, true) == expected);
+    }
+
+    // A needle across a line break
+    buffer.assign({"one", "two"});
+    assert(SubstringSearch("e\nt").find(buffer, 0, buffer.length(), false) == 2);
+    assert(SubstringSearch("e\nt").find(buffer, 0, buffer.length(), true) == 2);
+    assert(SubstringSearch("three").find(buffer, 0, buffer.length(), false) == SubstringSearch::npos);
+    assert(SubstringSearch("").find(buffer, 0, buffer.length(), false) == SubstringSearch::npos);
+
+    std::cout << "SubstringSearchTest passed.\n";
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include "PieceTable.h"
+#include "UndoJournal.h"
+#include <cassert>
+#include <iostream>
+
+static std::string contents(const TextBuffer& buffer) {
+    return buffer.substr(0, buffer.length());
+}
+
+int main() {
+    PieceTable buffer;
+    UndoJournal journal;
+    buffer.assign({"hello", "world"});
+    buffer.addListener(&journal);
+    int y = 0, x = 0;
+
+    // Typing and backspacing in one step collapse into a single delta
+    journal.beginStep(0, 5);
+    buffer.insertAt(5, " t");
+    buffer.insertAt(7, "here");
+    buffer.eraseAt(10, 1);
+    journal.commit(0, 10);
+    assert(contents(buffer) == "hello ther\nworld");
+
+    // A separate step deleting the line break
+    journal.beginStep(0, 10);
+    buffer.eraseAt(10, 1);
+    journal.commit(0, 10);
+    assert(contents(buffer) == "hello therworld");
+
+    // Steps that change nothing are not recorded
+    journal.beginStep(0, 0);
+    journal.commit(0, 0);
+    unsigned long seq = journal.currentSeq();
+
+    assert(journal.undo(buffer, y, x));
+    assert(contents(buffer) == "hello ther\nworld");
+    assert(journal.undo(buffer, y, x));
+    assert(contents(buffer) == "hello\nworld");
+    assert(y == 0 && x == 5);
+    assert(!journal.undo(buffer, y, x));
+    assert(journal.currentSeq() == 0);
+
+    assert(journal.redo(buffer, y, x));
+    assert(journal.redo(buffer, y, x));
+    assert(!journal.redo(buffer, y, x));
+    assert(contents(buffer) == "hello therworld");
+    assert(journal.currentSeq() == seq);
+
+    // A new edit after undo starts a branch; redo follows the new one
+    assert(journal.undo(buffer, y, x));
+    journal.beginStep(1, 0);
+    buffer.insertAt(11, "big ");
+    journal.commit(1, 4);
+    assert(!journal.redo(buffer, y, x));
+    assert(contents(buffer) == "hello ther\nbig world");
+    assert(journal.leaves().size() == 2);
+
+    // The old branch is still reachable in time order
+    assert(journal.stepChronological(buffer, -1, y, x));
+    assert(contents(buffer) == "hello therworld");
+    assert(journal.currentSeq() == seq);
+    assert(journal.stepChronological(buffer, 1, y, x));
+    assert(contents(buffer) == "hello ther\nbig world");
+    assert(journal.gotoSeq(buffer, 0, y, x));
+    assert(contents(buffer) == "hello\nworld");
+    assert(!journal.stepChronological(buffer, -1, y, x));
+
+    // Time based moves land on the newest state old enough
+    PieceTable timed;
+    UndoJournal timeline;
+    timed.addListener(&timeline);
+    std::time_t start = 1000000;
+    for (int minute = 1; minute <= 5; minute++) {
+        timeline.beginStep(0, 0);
+        timed.insertAt(timed.length(), std::to_string(minute));
+        timeline.commit(0, 0, start + minute * 60);
+    }
+    assert(contents(timed) == "12345");
+    assert(timeline.stepTime(timed, -150, y, x));
+    assert(contents(timed) == "12");
+    assert(timeline.stepTime(timed, 60, y, x));
+    assert(contents(timed) == "123");
+    assert(timeline.stepTime(timed, 3600, y, x));
+    assert(contents(timed) == "12345");
+
+    std::cout << "UndoJournalTest passed.\n";
+    return 0;
+}